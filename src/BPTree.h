@@ -50,6 +50,7 @@ class BPTree {
 		unsigned int BP_MAX=100;
 		BPNode<T> *_root;
 		bool _isEmpty = true;
+		size_t _numEntries = 0;
 		BPNode<T> *searchReturn(T &query, BPNode<T> *cursor){
 
 #if DEBUG_BPTREE
@@ -496,6 +497,7 @@ for (size_t i = 1; i < (parent -> key).size(); i++){
 				(node -> key).push_back(de -> entry);
 				(node -> Pdata).push_back(de);
 				_isEmpty = false;
+				_numEntries++;
 			}
 			else{
 
@@ -527,6 +529,8 @@ for (size_t i = 1; i < (targetLeaf -> key).size(); i++){
 }
 #endif
 
+				_numEntries++;
+
 				//rebalance the tree from the leaf if we have to
 				if ( (targetLeaf -> key).size() > BP_MAX ){
 
@@ -549,6 +553,7 @@ std::cout << "Total data pointers: " << _allData.size() << std::endl;
 
 			//delete the entry and correct any underflow by recursing up the tree to the root
 			manageUnderflow(query, targetLeaf);
+			_numEntries--;
 		}
 		bool search(T &query, BPNode<T> *cursor){
 			//std::cout << "in search" << std::endl;
@@ -713,9 +718,24 @@ std::cout << "Total data pointers: " << _allData.size() << std::endl;
 				}
 			}
 		}
+		void collectEntries(BPNode<T> *cursor, std::vector<T> &values){
+			//every entry in the tree, in order
+
+			if (_isEmpty) return;
+
+			if (cursor -> isLeaf){
+				for (auto de = (cursor -> Pdata).begin(); de < (cursor -> Pdata).end(); de++) values.push_back((*de) -> entry);
+			}
+			else{
+				for (auto n = (cursor -> Ptree).begin(); n < (cursor -> Ptree).end(); n++) collectEntries(*n, values);
+			}
+		}
 		BPNode<T> *getRoot(void){
 			return _root;
 		}
+		size_t size(void){
+			return _numEntries;
+		}
 };
 
 #endif /* SRC_BPTREE_H_ */
@@ -0,0 +1,372 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+//Approximate Bayesian computation by sequential Monte Carlo (ABC-SMC).  The model is parsed once and each particle is a
+//set of values for the global variables given priors.  Each generation keeps simulating perturbed particles from the last
+//generation until enough of them land within the tolerance of the observed data, and the tolerance shrinks each generation.
+
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <omp.h>
+#include "abc.h"
+#include "simulator.h"
+#include "error_handling.h"
+
+
+void ABCOptions::addPrior( std::string spec ){
+//priors are given as name=uniform:lower:upper or name=loguniform:lower:upper
+
+	Prior p;
+	size_t equals = spec.find( '=' );
+	size_t colon = spec.find( ':' );
+	if ( equals == std::string::npos or colon == std::string::npos or colon < equals ) throw BadInference( spec + " should be of the form name=uniform:lower:upper." );
+	p.name = spec.substr( 0, equals );
+	std::string distribution = spec.substr( equals + 1, colon - equals - 1 );
+
+	for ( auto q = priors.begin(); q < priors.end(); q++ ){
+
+		if ( q -> name == p.name ) throw BadInference( p.name + " has more than one prior." );
+	}
+
+	if ( distribution == "uniform" ) p.logScale = false;
+	else if ( distribution == "loguniform" ) p.logScale = true;
+	else throw BadInference( distribution + " is not a supported prior.  Use uniform or loguniform." );
+
+	char trailing;
+	if ( sscanf( spec.substr( colon + 1 ).c_str(), "%lf:%lf%c", &p.lower, &p.upper, &trailing ) != 2 or p.upper <= p.lower ){
+
+		throw BadInference( spec + " should give bounds as lower:upper with upper > lower." );
+	}
+	if ( p.logScale and p.lower <= 0.0 ) throw BadInference( spec + " is a loguniform prior, so its bounds must be positive." );
+
+	priors.push_back( p );
+}
+
+
+void ObservedData::load( std::string filename, const std::vector< ObservableDefinition > &observables ){
+//the first line names the columns: time, then declared observables
+//lines starting with > or # after that are ignored, so a single simulation from an observables file can be used as data
+
+	std::ifstream dataFile( filename );
+	if ( not dataFile.is_open() ) throw BadInference( "could not open data file " + filename + "." );
+
+	std::string line;
+	unsigned int lineNumber = 0;
+	bool haveHeader = false;
+	while ( std::getline( dataFile, line ) ){
+
+		lineNumber++;
+		if ( line.find_first_not_of( " \t\r" ) == std::string::npos ) continue;
+
+		if ( not haveHeader ){
+
+			if ( line[0] == '#' ) line = line.substr( 1 );
+			std::stringstream ss( line );
+			std::string name;
+			ss >> name; //time column
+			while ( ss >> name ){
+
+				unsigned int i = 0;
+				while ( i < observables.size() and observables[i].name != name ) i++;
+				if ( i == observables.size() ) throw BadInference( name + " in " + filename + " is not an observable declared in the model." );
+				columns.push_back( i );
+				columnNames.push_back( name );
+			}
+			if ( columns.empty() ) throw BadInference( filename + " does not name any observables." );
+			haveHeader = true;
+			continue;
+		}
+		if ( line[0] == '>' or line[0] == '#' ) continue;
+
+		std::stringstream ss( line );
+		double time, v;
+		if ( not ( ss >> time ) ) throw BadInference( filename + " line " + std::to_string( lineNumber ) + " does not start with a time." );
+		if ( not times.empty() and time < times.back() ) throw BadInference( filename + " line " + std::to_string( lineNumber ) + " is earlier than the line before it." );
+		times.push_back( time );
+
+		for ( unsigned int c = 0; c < columns.size(); c++ ){
+
+			if ( not ( ss >> v ) ) throw BadInference( filename + " line " + std::to_string( lineNumber ) + " does not have a value for each observable." );
+			values.push_back( v );
+		}
+	}
+
+	if ( times.empty() ) throw BadInference( filename + " does not have any observations." );
+}
+
+
+static double quantileOf( std::vector< double > v, double q ){
+
+	std::sort( v.begin(), v.end() );
+	return v[ (size_t) ( q * ( v.size() - 1 ) ) ];
+}
+
+
+static double distanceTo( const std::vector< double > &summaries, const ObservedData &data, const std::vector< double > &scales ){
+//Euclidean distance between simulated and observed values, with each observable divided by its scale
+
+	double sum = 0.0;
+	for ( size_t i = 0; i < summaries.size(); i++ ){
+
+		double d = ( summaries[i] - data.values[i] ) / scales[ i % data.columns.size() ];
+		sum += d * d;
+	}
+	return std::sqrt( sum );
+}
+
+
+static std::vector< double > columnScales( const std::vector< std::vector< double > > &summaries, const ObservedData &data ){
+//median absolute deviation of each observable over the prior predictive simulations, so that observables with large counts
+//don't swamp the distance
+
+	std::vector< double > scales;
+	unsigned int numColumns = data.columns.size();
+	for ( unsigned int c = 0; c < numColumns; c++ ){
+
+		std::vector< double > column;
+		for ( auto s = summaries.begin(); s < summaries.end(); s++ ){
+
+			for ( size_t i = c; i < s -> size(); i += numColumns ) column.push_back( (*s)[i] );
+		}
+		double median = quantileOf( column, 0.5 );
+		for ( auto v = column.begin(); v < column.end(); v++ ) *v = std::abs( *v - median );
+		double mad = quantileOf( column, 0.5 );
+		scales.push_back( ( mad > 0.0 ) ? mad : 1.0 );
+	}
+	return scales;
+}
+
+
+static void updateWeights( std::vector< Particle > &population, const std::vector< Particle > &previous, const std::vector< double > &kernelSD, int threads ){
+//importance weights for particles drawn from the perturbation kernel: the prior density over the kernel density
+//the prior is flat inside its bounds on the scale we perturb on, so only the kernel density matters
+
+	#pragma omp parallel for schedule(static) num_threads( threads )
+	for ( unsigned int i = 0; i < population.size(); i++ ){
+
+		double kernelDensity = 0.0;
+		for ( auto p = previous.begin(); p < previous.end(); p++ ){
+
+			double logDensity = 0.0;
+			for ( unsigned int k = 0; k < kernelSD.size(); k++ ){
+
+				double z = ( population[i].scaled[k] - (p -> scaled)[k] ) / kernelSD[k];
+				logDensity -= 0.5 * z * z;
+			}
+			kernelDensity += ( p -> weight ) * std::exp( logDensity );
+		}
+		population[i].weight = 1.0 / kernelDensity;
+	}
+
+	double total = 0.0;
+	for ( auto p = population.begin(); p < population.end(); p++ ) total += p -> weight;
+	for ( auto p = population.begin(); p < population.end(); p++ ) p -> weight /= total;
+}
+
+
+static std::vector< double > kernelWidths( const std::vector< Particle > &population, const std::vector< Prior > &priors ){
+//each parameter is perturbed with a normal whose variance is twice the weighted variance of the last generation (Beaumont et al. 2009)
+
+	std::vector< double > widths;
+	for ( unsigned int k = 0; k < priors.size(); k++ ){
+
+		double mean = 0.0, variance = 0.0;
+		for ( auto p = population.begin(); p < population.end(); p++ ) mean += ( p -> weight ) * (p -> scaled)[k];
+		for ( auto p = population.begin(); p < population.end(); p++ ) variance += ( p -> weight ) * ( (p -> scaled)[k] - mean ) * ( (p -> scaled)[k] - mean );
+
+		//if the population has collapsed onto one value, keep perturbing by a small fraction of the prior's range
+		double sd = std::sqrt( 2.0 * variance );
+		double floor = 1e-6 * ( priors[k].scaledUpper() - priors[k].scaledLower() );
+		widths.push_back( std::max( sd, floor ) );
+	}
+	return widths;
+}
+
+
+static void writeGeneration( std::ofstream &outFile, unsigned int generation, double tolerance, unsigned long simulations, const std::vector< Particle > &population, const std::vector< Prior > &priors, const std::vector< bool > &isInt ){
+
+	outFile << ">=======\tgeneration\t" << generation << "\ttolerance\t" << tolerance << "\tsimulations\t" << simulations << std::endl;
+	for ( auto p = population.begin(); p < population.end(); p++ ){
+
+		outFile << p -> weight << '\t' << p -> distance;
+		for ( unsigned int k = 0; k < priors.size(); k++ ){
+
+			double v = priors[k].fromScale( (p -> scaled)[k] );
+			if ( isInt[k] ) outFile << '\t' << (int) std::round( v );
+			else outFile << '\t' << v;
+		}
+		outFile << std::endl;
+	}
+}
+
+
+void runABC( std::map< std::string, ProcessDefinition > &name2ProcessDef, std::vector< SystemLineTerm > &tokenisedSystemLine, GlobalVariables &globalVars, std::vector< ObservableDefinition > &observables, std::vector< StopCondition > &stopConditions, SimulationOptions &options, ABCOptions &abc ){
+
+	if ( abc.priors.empty() ) throw BadInference( "at least one global variable needs a prior (--prior)." );
+	if ( abc.particles < 2 ) throw BadInference( "at least two particles are needed." );
+
+	//integer globals stay integers so that they can still be used as clone counts in the system line
+	std::vector< bool > isInt;
+	for ( auto p = abc.priors.begin(); p < abc.priors.end(); p++ ){
+
+		if ( globalVars.values.count( p -> name ) == 0 ) throw BadInference( p -> name + " is not a global variable in the model." );
+		isInt.push_back( globalVars.values[ p -> name ].isInt() );
+	}
+
+	ObservedData data;
+	data.load( abc.dataFilename, observables );
+
+	//simulations only need to keep the summary statistics
+	SimulationOptions simOptions = options;
+	simOptions.inference = true;
+	simOptions.sampleInterval = 0.0;
+	OutputTables tables( name2ProcessDef, options.recordNames, options.ignoreNames );
+
+	std::ofstream outFile( options.outputFilename );
+	if ( not outFile.is_open() ) throw BadOutputPath();
+	outFile << "#weight\tdistance";
+	for ( auto p = abc.priors.begin(); p < abc.priors.end(); p++ ) outFile << '\t' << p -> name;
+	outFile << std::endl;
+
+	unsigned int N = abc.particles, numParams = abc.priors.size();
+	std::vector< Particle > population;
+	std::vector< double > scales( data.columns.size(), 1.0 );
+	double tolerance = std::numeric_limits< double >::infinity();
+	std::vector< PhaseProfile > threadProfiles( options.threads );
+
+	for ( unsigned int generation = 0; generation < abc.generations; generation++ ){
+
+		//the first generation is drawn from the priors and all of it is kept; after that, proposals are perturbed particles
+		std::vector< double > kernelSD, weights;
+		if ( generation > 0 ){
+
+			kernelSD = kernelWidths( population, abc.priors );
+			for ( auto p = population.begin(); p < population.end(); p++ ) weights.push_back( p -> weight );
+		}
+		unsigned long maxSimulations = ( generation == 0 ) ? N : (unsigned long) std::ceil( N / abc.minAcceptance );
+
+		std::vector< Particle > next;
+		std::vector< std::vector< double > > priorPredictive;
+		unsigned long simulations = 0;
+
+		#pragma omp parallel num_threads( options.threads ) shared( next, priorPredictive, simulations, threadProfiles )
+		{
+			std::random_device rd;
+			std::mt19937 rnd_gen( rd() );
+			std::uniform_real_distribution< double > uniDist( 0.0, 1.0 );
+			std::normal_distribution< double > normDist( 0.0, 1.0 );
+			std::discrete_distribution< size_t > pickParticle( weights.begin(), weights.end() );
+
+			while ( true ){
+
+				/*propose a particle that lies inside the priors' bounds */
+				Particle proposal;
+				proposal.scaled.assign( numParams, 0.0 );
+				bool inBounds = false;
+				while ( not inBounds ){
+
+					inBounds = true;
+					const Particle *parent = ( generation > 0 ) ? &population[ pickParticle( rnd_gen ) ] : NULL;
+					for ( unsigned int k = 0; k < numParams; k++ ){
+
+						const Prior &prior = abc.priors[k];
+						double v;
+						if ( parent ) v = (parent -> scaled)[k] + kernelSD[k] * normDist( rnd_gen );
+						else v = prior.scaledLower() + uniDist( rnd_gen ) * ( prior.scaledUpper() - prior.scaledLower() );
+						if ( v < prior.scaledLower() or v > prior.scaledUpper() ) inBounds = false;
+						proposal.scaled[k] = v;
+					}
+				}
+
+				bool done = false;
+				#pragma omp critical(abcPopulation)
+				{
+					if ( next.size() >= N or simulations >= maxSimulations ) done = true;
+					else simulations++;
+				}
+				if ( done ) break;
+
+				/*bind the proposed values and simulate */
+				GridPoint point;
+				point.globalVars = globalVars;
+				for ( unsigned int k = 0; k < numParams; k++ ){
+
+					double v = abc.priors[k].fromScale( proposal.scaled[k] );
+					Numerical n;
+					if ( isInt[k] ) n.setInt( (int) std::round( v ) );
+					else n.setDouble( v );
+					point.names.push_back( abc.priors[k].name );
+					point.values.push_back( n );
+				}
+
+				#pragma omp critical(abcBind)
+				bindGridPoint( point, name2ProcessDef, tokenisedSystemLine );
+
+				System systemLocal( point, name2ProcessDef, observables, stopConditions, simOptions, tables );
+				systemLocal.setObservedData( &data );
+				if ( options.profile ) systemLocal.setProfile( &threadProfiles[ omp_get_thread_num() ] );
+				systemLocal.simulate();
+
+				if ( generation == 0 ){
+
+					#pragma omp critical(abcPopulation)
+					{
+						next.push_back( proposal );
+						priorPredictive.push_back( systemLocal.summaries() );
+					}
+					continue;
+				}
+
+				proposal.distance = distanceTo( systemLocal.summaries(), data, scales );
+				if ( proposal.distance <= tolerance ){
+
+					#pragma omp critical(abcPopulation)
+					{
+						if ( next.size() < N ) next.push_back( proposal );
+					}
+				}
+			}
+		}
+
+		if ( next.size() < N ){
+
+			std::cout << "Stopping: fewer than " << abc.minAcceptance << " of simulations were accepted at tolerance " << tolerance << ".  The last complete generation is generation " << generation - 1 << "." << std::endl;
+			break;
+		}
+
+		if ( generation == 0 ){
+
+			//scale each observable by its spread under the prior, then start the schedule from the prior predictive distances
+			scales = columnScales( priorPredictive, data );
+			for ( unsigned int i = 0; i < N; i++ ){
+
+				next[i].distance = distanceTo( priorPredictive[i], data, scales );
+				next[i].weight = 1.0 / N;
+			}
+		}
+		else updateWeights( next, population, kernelSD, options.threads );
+
+		population.swap( next );
+		writeGeneration( outFile, generation, tolerance, simulations, population, abc.priors, isInt );
+
+		double acceptance = (double) N / simulations;
+		std::cout << "Generation " << generation << ": tolerance " << tolerance << ", accepted " << N << " of " << simulations << " simulations." << std::endl;
+
+		if ( tolerance <= abc.finalTolerance or ( generation > 0 and acceptance < abc.minAcceptance ) ) break;
+
+		std::vector< double > distances;
+		for ( auto p = population.begin(); p < population.end(); p++ ) distances.push_back( p -> distance );
+		tolerance = quantileOf( distances, abc.quantile );
+	}
+
+	if ( options.profile ) writeProfile( threadProfiles, options.profileFilename );
+}
@@ -0,0 +1,73 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef ABC_H
+#define ABC_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include "blockParser.h"
+
+struct SimulationOptions;
+
+class Prior{
+//uniform prior on a global variable, or uniform on its log if logScale is set
+//particles are perturbed on the scale the prior is uniform on, so the prior density is flat inside its bounds
+
+	public:
+		std::string name;
+		bool logScale = false;
+		double lower = 0.0, upper = 0.0;
+		double toScale( double v ) const { return logScale ? std::log( v ) : v; }
+		double fromScale( double v ) const { return logScale ? std::exp( v ) : v; }
+		double scaledLower( void ) const { return toScale( lower ); }
+		double scaledUpper( void ) const { return toScale( upper ); }
+};
+
+
+class ObservedData{
+//observed values of declared observables at fixed times, in the same layout as the observables file that bcs writes
+
+	public:
+		std::vector< double > times;
+		std::vector< unsigned int > columns; //index of the declared observable in each column
+		std::vector< std::string > columnNames;
+		std::vector< double > values; //row-major, one row per time
+		void load( std::string, const std::vector< ObservableDefinition > & );
+		size_t numStatistics( void ) const { return values.size(); }
+};
+
+
+struct ABCOptions{
+
+	std::string dataFilename; //ABC mode is on if this is set
+	std::vector< Prior > priors;
+	unsigned int particles = 1000;
+	unsigned int generations = 10;
+	double quantile = 0.5; //each tolerance is this quantile of the previous generation's distances
+	double finalTolerance = 0.0; //stop once the tolerance is at or below this
+	double minAcceptance = 0.01; //stop once fewer than this fraction of simulations are accepted
+	void addPrior( std::string );
+};
+
+
+class Particle{
+
+	public:
+		std::vector< double > scaled; //parameter values on the scale their prior is uniform on
+		double weight = 0.0;
+		double distance = 0.0;
+};
+
+
+/*function prototypes */
+void runABC( std::map< std::string, ProcessDefinition > &, std::vector< SystemLineTerm > &, GlobalVariables &, std::vector< ObservableDefinition > &, std::vector< StopCondition > &, SimulationOptions &, ABCOptions & );
+
+#endif
@@ -0,0 +1,225 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include "aggregate.h"
+
+
+/*RUNNING STATISTICS-------------------------------------------------------------------------------------------------------------------------------------------------*/
+void RunningStatistics::add( double v ){
+
+	if ( _n == 0 ){
+
+		_min = v;
+		_max = v;
+	}
+	else{
+
+		_min = std::min( _min, v );
+		_max = std::max( _max, v );
+	}
+
+	_n++;
+	double delta = v - _mean;
+	_mean += delta / _n;
+	_M2 += delta * ( v - _mean );
+}
+
+
+void RunningStatistics::merge( const RunningStatistics &rs ){
+
+	if ( rs._n == 0 ) return;
+	if ( _n == 0 ){
+
+		*this = rs;
+		return;
+	}
+
+	unsigned long n = _n + rs._n;
+	double delta = rs._mean - _mean;
+	_mean += delta * rs._n / n;
+	_M2 += rs._M2 + delta * delta * ( (double) _n * rs._n ) / n;
+	_min = std::min( _min, rs._min );
+	_max = std::max( _max, rs._max );
+	_n = n;
+}
+
+
+/*HISTOGRAM----------------------------------------------------------------------------------------------------------------------------------------------------------*/
+void FixedHistogram::add( double v ){
+
+	unsigned int bins = _counts.size() - 2;
+	if ( v < _lower ) _counts[0]++;
+	else if ( v >= _upper ) _counts[bins + 1]++;
+	else{
+
+		unsigned int bin = (unsigned int) ( ( v - _lower ) / ( _upper - _lower ) * bins );
+		if ( bin >= bins ) bin = bins - 1; //guard against rounding at the upper edge
+		_counts[bin + 1]++;
+	}
+}
+
+
+void FixedHistogram::merge( const FixedHistogram &fh ){
+
+	assert( fh._counts.size() == _counts.size() );
+	for ( unsigned int i = 0; i < _counts.size(); i++ ) _counts[i] += fh._counts[i];
+}
+
+
+/*QUANTILE SKETCH----------------------------------------------------------------------------------------------------------------------------------------------------*/
+void QuantileSketch::compact( void ){
+
+	for ( unsigned int h = 0; h < _levels.size(); h++ ){
+
+		if ( _levels[h].size() < _k ) continue;
+
+		std::vector< double > &level = _levels[h];
+		std::sort( level.begin(), level.end() );
+
+		//keep the last item behind if there's an odd number so that the total weight doesn't change
+		double leftOver = 0.0;
+		bool hasLeftOver = level.size() % 2 == 1;
+		if ( hasLeftOver ){
+
+			leftOver = level.back();
+			level.pop_back();
+		}
+
+		//alternate which half gets promoted so the sketch isn't biased in one direction
+		if ( h + 1 == _levels.size() ) _levels.push_back( std::vector< double >() );
+		unsigned int offset = _compactions % 2;
+		_compactions++;
+		for ( unsigned int i = offset; i < _levels[h].size(); i += 2 ) _levels[h + 1].push_back( _levels[h][i] );
+
+		_levels[h].clear();
+		if ( hasLeftOver ) _levels[h].push_back( leftOver );
+	}
+}
+
+
+void QuantileSketch::add( double v ){
+
+	if ( _levels.empty() ) _levels.push_back( std::vector< double >() );
+	_levels[0].push_back( v );
+	if ( _levels[0].size() >= _k ) compact();
+}
+
+
+void QuantileSketch::merge( const QuantileSketch &qs ){
+
+	if ( _levels.size() < qs._levels.size() ) _levels.resize( qs._levels.size() );
+	for ( unsigned int h = 0; h < qs._levels.size(); h++ ){
+
+		_levels[h].insert( _levels[h].end(), qs._levels[h].begin(), qs._levels[h].end() );
+	}
+	compact();
+}
+
+
+double QuantileSketch::quantile( double q ) const{
+
+	std::vector< std::pair< double, double > > weighted;
+	double totalWeight = 0.0;
+	for ( unsigned int h = 0; h < _levels.size(); h++ ){
+
+		double weight = std::ldexp( 1.0, h );
+		for ( auto v = _levels[h].begin(); v < _levels[h].end(); v++ ){
+
+			weighted.push_back( std::make_pair( *v, weight ) );
+			totalWeight += weight;
+		}
+	}
+	if ( weighted.empty() ) return std::nan("");
+
+	std::sort( weighted.begin(), weighted.end() );
+	double target = q * totalWeight, runningWeight = 0.0;
+	for ( auto w = weighted.begin(); w < weighted.end(); w++ ){
+
+		runningWeight += w -> second;
+		if ( runningWeight >= target ) return w -> first;
+	}
+	return weighted.back().first;
+}
+
+
+/*ENSEMBLE AGGREGATOR------------------------------------------------------------------------------------------------------------------------------------------------*/
+void EnsembleAggregator::extendTo( size_t gridPoints ){
+
+	while ( _grid.size() < gridPoints ){
+
+		std::vector< ObservableAccumulator > accumulators( _numObservables );
+		if ( _histogramOptions.use ){
+
+			for ( auto a = accumulators.begin(); a < accumulators.end(); a++ ){
+
+				a -> histogram = FixedHistogram( _histogramOptions.lower, _histogramOptions.upper, _histogramOptions.bins );
+			}
+		}
+		_grid.push_back( accumulators );
+	}
+}
+
+
+void EnsembleAggregator::add( size_t gridIndex, unsigned int observable, double value ){
+
+	extendTo( gridIndex + 1 );
+	_grid[gridIndex][observable].add( value );
+}
+
+
+void EnsembleAggregator::merge( const EnsembleAggregator &ea ){
+
+	extendTo( ea._grid.size() );
+	for ( unsigned int g = 0; g < ea._grid.size(); g++ ){
+
+		for ( unsigned int o = 0; o < _numObservables; o++ ) _grid[g][o].merge( ea._grid[g][o] );
+	}
+}
+
+
+void EnsembleAggregator::writeHeader( std::ostream &out ) const{
+
+	out << "#time\tobservable\tn\tmean\tvariance\tmin\tq05\tq25\tq50\tq75\tq95\tmax";
+	if ( _histogramOptions.use ) out << "\thistogram";
+	out << std::endl;
+}
+
+
+void EnsembleAggregator::write( std::ostream &out, const std::vector< std::string > &observableNames, double sampleInterval ) const{
+//tab-delimited summary with one line for each observable at each point on the sampling grid
+
+	for ( unsigned int g = 0; g < _grid.size(); g++ ){
+
+		for ( unsigned int o = 0; o < _numObservables; o++ ){
+
+			const ObservableAccumulator &oa = _grid[g][o];
+			if ( oa.stats.count() == 0 ) continue;
+
+			out << g * sampleInterval << '\t' << observableNames[o] << '\t' << oa.stats.count() << '\t' << oa.stats.mean() << '\t' << oa.stats.variance();
+			out << '\t' << oa.stats.min();
+			double quantiles[] = { 0.05, 0.25, 0.5, 0.75, 0.95 };
+			for ( unsigned int q = 0; q < 5; q++ ) out << '\t' << oa.sketch.quantile( quantiles[q] );
+			out << '\t' << oa.stats.max();
+
+			if ( _histogramOptions.use ){
+
+				out << '\t';
+				const std::vector< unsigned long > &counts = oa.histogram.counts();
+				for ( unsigned int i = 0; i < counts.size(); i++ ){
+
+					if ( i > 0 ) out << ',';
+					out << counts[i];
+				}
+			}
+			out << std::endl;
+		}
+	}
+}
@@ -0,0 +1,116 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+
+class RunningStatistics{
+//Welford's online mean and variance, with Chan et al.'s update so that two accumulators can be merged
+
+	private:
+		unsigned long _n = 0;
+		double _mean = 0.0, _M2 = 0.0, _min = 0.0, _max = 0.0;
+
+	public:
+		void add( double );
+		void merge( const RunningStatistics & );
+		unsigned long count( void ) const { return _n; }
+		double mean( void ) const { return _mean; }
+		double variance( void ) const { return ( _n > 1 ) ? _M2 / ( _n - 1 ) : 0.0; }
+		double min( void ) const { return _min; }
+		double max( void ) const { return _max; }
+};
+
+
+class FixedHistogram{
+//equal-width bins on [lower, upper), plus one bin each for values below and above the range
+
+	private:
+		double _lower = 0.0, _upper = 0.0;
+		std::vector< unsigned long > _counts;
+
+	public:
+		FixedHistogram(){}
+		FixedHistogram( double lower, double upper, unsigned int bins ) : _lower(lower), _upper(upper), _counts(bins + 2, 0) {}
+		void add( double );
+		void merge( const FixedHistogram & );
+		bool empty( void ) const { return _counts.size() == 0; }
+		const std::vector< unsigned long > &counts( void ) const { return _counts; }
+};
+
+
+class QuantileSketch{
+//mergeable quantile sketch that keeps at most _k items per level: when a level fills up, it is sorted and every
+//other item is promoted to the next level with twice the weight, so memory grows with the log of the number of values
+
+	private:
+		unsigned int _k;
+		unsigned long _compactions = 0;
+		std::vector< std::vector< double > > _levels;
+		void compact( void );
+
+	public:
+		QuantileSketch( unsigned int k = 128 ) : _k(k) {}
+		void add( double );
+		void merge( const QuantileSketch & );
+		double quantile( double ) const;
+};
+
+
+class ObservableAccumulator{
+
+	public:
+		RunningStatistics stats;
+		FixedHistogram histogram;
+		QuantileSketch sketch;
+		void add( double v ){
+
+			stats.add( v );
+			sketch.add( v );
+			if ( not histogram.empty() ) histogram.add( v );
+		}
+		void merge( const ObservableAccumulator &oa ){
+
+			stats.merge( oa.stats );
+			sketch.merge( oa.sketch );
+			if ( not histogram.empty() ) histogram.merge( oa.histogram );
+		}
+};
+
+
+struct HistogramOptions{
+
+	bool use = false;
+	double lower = 0.0, upper = 0.0;
+	unsigned int bins = 0;
+};
+
+
+class EnsembleAggregator{
+//accumulators for each observable at each point on the sampling grid
+//each thread keeps its own, and they are merged once all simulations are done
+
+	private:
+		unsigned int _numObservables;
+		HistogramOptions _histogramOptions;
+		std::vector< std::vector< ObservableAccumulator > > _grid; //indexed by [grid point][observable]
+		void extendTo( size_t );
+
+	public:
+		EnsembleAggregator( unsigned int numObservables, HistogramOptions ho ) : _numObservables(numObservables), _histogramOptions(ho) {}
+		void add( size_t, unsigned int, double );
+		void merge( const EnsembleAggregator & );
+		void writeHeader( std::ostream & ) const;
+		void write( std::ostream &, const std::vector< std::string > &, double ) const;
+};
+
+#endif
@@ -0,0 +1,262 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "batch.h"
+#include "evaluate_trees.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BATCH_AVX2 1
+#include <immintrin.h>
+#endif
+
+
+struct ColumnKernels{
+//column operations, a = a op b or a = op a, for one instruction set
+
+	void (*add)( double *, const double *, size_t );
+	void (*subtract)( double *, const double *, size_t );
+	void (*multiply)( double *, const double *, size_t );
+	void (*divide)( double *, const double *, size_t );
+	void (*min)( double *, const double *, size_t );
+	void (*max)( double *, const double *, size_t );
+	void (*negate)( double *, size_t );
+	void (*abs)( double *, size_t );
+	void (*sqrt)( double *, size_t );
+	void (*truncate)( double *, size_t );
+};
+
+
+/*GENERIC----------------------------------------------------------------------------------------------------------------------------------*/
+static void addGeneric( double *a, const double *b, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = a[i] + b[i]; }
+static void subtractGeneric( double *a, const double *b, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = a[i] - b[i]; }
+static void multiplyGeneric( double *a, const double *b, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = a[i] * b[i]; }
+static void divideGeneric( double *a, const double *b, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = a[i] / b[i]; }
+static void minGeneric( double *a, const double *b, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = std::min( a[i], b[i] ); }
+static void maxGeneric( double *a, const double *b, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = std::max( a[i], b[i] ); }
+static void negateGeneric( double *a, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = -a[i]; }
+static void absGeneric( double *a, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = std::abs( a[i] ); }
+static void sqrtGeneric( double *a, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = std::sqrt( a[i] ); }
+static void truncateGeneric( double *a, size_t n ){ for ( size_t i = 0; i < n; i++ ) a[i] = std::trunc( a[i] ); }
+
+static const ColumnKernels genericKernels = { addGeneric, subtractGeneric, multiplyGeneric, divideGeneric, minGeneric, maxGeneric,
+                                              negateGeneric, absGeneric, sqrtGeneric, truncateGeneric };
+
+
+/*AVX2-------------------------------------------------------------------------------------------------------------------------------------*/
+#ifdef BATCH_AVX2
+
+//four lanes at a time, then the generic loop for whatever is left over
+#define AVX2_BINARY( NAME, EXPRESSION ) \
+__attribute__((target("avx2"))) static void NAME##Avx2( double *a, const double *b, size_t n ){ \
+	size_t i = 0; \
+	for ( ; i + 4 <= n; i += 4 ){ \
+		__m256d x = _mm256_loadu_pd( a + i ), y = _mm256_loadu_pd( b + i ); \
+		_mm256_storeu_pd( a + i, EXPRESSION ); \
+	} \
+	NAME##Generic( a + i, b + i, n - i ); \
+}
+
+#define AVX2_UNARY( NAME, EXPRESSION ) \
+__attribute__((target("avx2"))) static void NAME##Avx2( double *a, size_t n ){ \
+	size_t i = 0; \
+	const __m256d sign = _mm256_set1_pd( -0.0 ); \
+	(void) sign; \
+	for ( ; i + 4 <= n; i += 4 ){ \
+		__m256d x = _mm256_loadu_pd( a + i ); \
+		_mm256_storeu_pd( a + i, EXPRESSION ); \
+	} \
+	NAME##Generic( a + i, n - i ); \
+}
+
+//min and max take their operands in the order that gives the same answer as std::min and std::max when they're equal or NaN
+AVX2_BINARY( add, _mm256_add_pd( x, y ) )
+AVX2_BINARY( subtract, _mm256_sub_pd( x, y ) )
+AVX2_BINARY( multiply, _mm256_mul_pd( x, y ) )
+AVX2_BINARY( divide, _mm256_div_pd( x, y ) )
+AVX2_BINARY( min, _mm256_min_pd( y, x ) )
+AVX2_BINARY( max, _mm256_max_pd( y, x ) )
+AVX2_UNARY( negate, _mm256_xor_pd( x, sign ) )
+AVX2_UNARY( abs, _mm256_andnot_pd( sign, x ) )
+AVX2_UNARY( sqrt, _mm256_sqrt_pd( x ) )
+AVX2_UNARY( truncate, _mm256_round_pd( x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC ) )
+
+static const ColumnKernels avx2Kernels = { addAvx2, subtractAvx2, multiplyAvx2, divideAvx2, minAvx2, maxAvx2,
+                                           negateAvx2, absAvx2, sqrtAvx2, truncateAvx2 };
+#endif
+
+
+static const ColumnKernels &columnKernels( void ){
+//the instruction set is picked once, from what the processor running the simulation supports
+
+#ifdef BATCH_AVX2
+	static const ColumnKernels &kernels = __builtin_cpu_supports( "avx2" ) ? avx2Kernels : genericKernels;
+	return kernels;
+#else
+	return genericKernels;
+#endif
+}
+
+
+/*COMPILE AND RUN--------------------------------------------------------------------------------------------------------------------------*/
+bool BatchProgram::compile( const std::vector< Token * > &rpn, const std::vector< std::string > &boundNames, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables ){
+//returns false for anything the interpreter should evaluate instead, including undefined variables so that it can report them
+
+	_code.clear();
+	_maxDepth = 0;
+	std::vector< bool > isInt; //type of each value on the stack, which doesn't depend on the values of the binding variables
+
+	for ( auto t = rpn.begin(); t < rpn.end(); t++ ){
+
+		std::string kind = (*t) -> identify();
+		std::string op = (*t) -> value();
+		BatchInstruction ins = { BATCH_CONSTANT, 0.0, 0 };
+
+		if ( kind == "IntLiteral" or kind == "DoubleLiteral" or kind == "Variable" ){
+
+			//binding variables take precedence over everything else, and the last one with a name is the one that's bound
+			auto bound = std::find( boundNames.rbegin(), boundNames.rend(), op );
+			if ( kind == "Variable" and bound != boundNames.rend() ){
+
+				ins.op = BATCH_BOUND;
+				ins.bound = boundNames.rend() - bound - 1;
+				isInt.push_back( true );
+			}
+			else{
+
+				if ( kind == "Variable" and not variableIsDefined( *t, param2value, globalVariables, localVariables ) ) return false;
+				Numerical n = substituteVariable( *t, param2value, globalVariables, localVariables );
+				ins.constant = n.doubleCast();
+				isInt.push_back( n.isInt() );
+			}
+			_code.push_back( ins );
+			_maxDepth = std::max( _maxDepth, (unsigned int) isInt.size() );
+		}
+		else if ( op == "neg" or op == "abs" or op == "sqrt" ){
+
+			if ( isInt.empty() ) return false;
+			ins.op = ( op == "neg" ) ? BATCH_NEGATE : ( ( op == "abs" ) ? BATCH_ABS : BATCH_SQRT );
+			_code.push_back( ins );
+
+			if ( isInt.back() ){
+
+				if ( op == "sqrt" ) _code.push_back( { BATCH_TRUNCATE, 0.0, 0 } );
+				_code.push_back( { BATCH_INT_CHECK, 0.0, 0 } );
+			}
+		}
+		else if ( op == "+" or op == "-" or op == "*" or op == "/" or op == "^" or op == "min" or op == "max" ){
+
+			if ( isInt.size() < 2 ) return false;
+			bool intResult = isInt[ isInt.size() - 1 ] and isInt[ isInt.size() - 2 ];
+			isInt.pop_back();
+			isInt.back() = intResult;
+
+			if ( op == "+" ) ins.op = BATCH_ADD;
+			else if ( op == "-" ) ins.op = BATCH_SUBTRACT;
+			else if ( op == "*" ) ins.op = BATCH_MULTIPLY;
+			else if ( op == "/" ) ins.op = intResult ? BATCH_INT_DIVIDE : BATCH_DIVIDE;
+			else if ( op == "^" ) ins.op = BATCH_POWER;
+			else if ( op == "min" ) ins.op = BATCH_MIN;
+			else ins.op = BATCH_MAX;
+			_code.push_back( ins );
+
+			if ( intResult and op != "min" and op != "max" ){
+
+				if ( op == "/" or op == "^" ) _code.push_back( { BATCH_TRUNCATE, 0.0, 0 } );
+				_code.push_back( { BATCH_INT_CHECK, 0.0, 0 } );
+			}
+		}
+		else return false;
+	}
+
+	return isInt.size() == 1;
+}
+
+
+bool BatchProgram::run( const std::vector< std::vector< int > > &bindings, std::vector< double > &out ) const {
+//evaluates the program for each set of binding variable values, and returns false if the interpreter should evaluate them instead
+
+	const ColumnKernels &k = columnKernels();
+	size_t n = bindings.size();
+	std::vector< double > stack( _maxDepth * n );
+	size_t depth = 0;
+
+	for ( auto ins = _code.begin(); ins < _code.end(); ins++ ){
+
+		//a is the operand of a unary operation or the left operand of a binary one, and is overwritten with the result
+		double *top = &stack[0] + depth * n;
+		bool binary = ins -> op >= BATCH_ADD and ins -> op <= BATCH_MAX;
+		size_t operands = binary ? 2 : 1;
+		double *a = ( depth >= operands ) ? top - operands * n : top;
+		double *b = a + n;
+
+		switch ( ins -> op ){
+
+			case BATCH_CONSTANT:
+				std::fill( top, top + n, ins -> constant );
+				depth++;
+				break;
+			case BATCH_BOUND:
+				for ( size_t i = 0; i < n; i++ ){
+
+					if ( ins -> bound >= bindings[i].size() ) return false;
+					top[i] = bindings[i][ ins -> bound ];
+				}
+				depth++;
+				break;
+			case BATCH_ADD: k.add( a, b, n ); depth--; break;
+			case BATCH_SUBTRACT: k.subtract( a, b, n ); depth--; break;
+			case BATCH_MULTIPLY: k.multiply( a, b, n ); depth--; break;
+			case BATCH_DIVIDE: k.divide( a, b, n ); depth--; break;
+			case BATCH_INT_DIVIDE:
+				for ( size_t i = 0; i < n; i++ ) if ( b[i] == 0.0 ) return false;
+				k.divide( a, b, n );
+				depth--;
+				break;
+			case BATCH_POWER:
+				for ( size_t i = 0; i < n; i++ ) a[i] = std::pow( a[i], b[i] );
+				depth--;
+				break;
+			case BATCH_MIN: k.min( a, b, n ); depth--; break;
+			case BATCH_MAX: k.max( a, b, n ); depth--; break;
+			case BATCH_NEGATE: k.negate( a, n ); break;
+			case BATCH_ABS: k.abs( a, n ); break;
+			case BATCH_SQRT: k.sqrt( a, n ); break;
+			case BATCH_TRUNCATE: k.truncate( a, n ); break;
+			case BATCH_INT_CHECK:
+				//ints that would overflow, and NaNs that would be cast to ints, are left to the interpreter
+				for ( size_t i = 0; i < n; i++ ){
+
+					if ( not ( a[i] >= std::numeric_limits< int >::min() and a[i] <= std::numeric_limits< int >::max() ) ) return false;
+				}
+				break;
+		}
+	}
+
+	out.assign( stack.begin(), stack.begin() + n );
+	return true;
+}
+
+
+bool evalRateBatch( Block *b, const std::vector< std::string > &boundNames, const std::vector< std::vector< int > > &bindings, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables, std::vector< double > &rates ){
+//the rate of a block for each set of values of its binding variables
+//returns false if the rates should be evaluated one at a time instead, and in that case rates is left alone
+
+	if ( b -> hasConstantRate() ){
+
+		rates.assign( bindings.size(), b -> getConstantRate().doubleCast() );
+		return true;
+	}
+	if ( bindings.size() < BATCH_MIN_LANES ) return false;
+
+	BatchProgram program;
+	if ( not program.compile( b -> getRate(), boundNames, param2value, globalVariables, localVariables ) ) return false;
+	return program.run( bindings, rates );
+}
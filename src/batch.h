@@ -0,0 +1,51 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "blockParser.h"
+
+#define BATCH_MIN_LANES 8 //receives that match fewer values than this evaluate their rate one value at a time
+
+
+/*operations on whole columns of values, one value per lane */
+enum BatchOp { BATCH_CONSTANT, BATCH_BOUND, BATCH_ADD, BATCH_SUBTRACT, BATCH_MULTIPLY, BATCH_DIVIDE, BATCH_INT_DIVIDE,
+               BATCH_POWER, BATCH_MIN, BATCH_MAX, BATCH_NEGATE, BATCH_ABS, BATCH_SQRT, BATCH_TRUNCATE, BATCH_INT_CHECK };
+
+
+struct BatchInstruction{
+
+	BatchOp op;
+	double constant; //value for BATCH_CONSTANT
+	unsigned int bound; //which binding variable for BATCH_BOUND
+};
+
+
+class BatchProgram{
+//a rate expression compiled for one set of parameter and local variable values, evaluated over many values of its binding variables at once
+//values are held as doubles, and subexpressions that the interpreter would evaluate as ints are truncated and range checked so that
+//every lane gets the value evalRPN_numerical would give it - anything that can't be matched exactly makes run return false
+
+	private:
+		std::vector< BatchInstruction > _code;
+		unsigned int _maxDepth = 0;
+
+	public:
+		bool compile( const std::vector< Token * > &, const std::vector< std::string > &, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > & );
+		bool run( const std::vector< std::vector< int > > &, std::vector< double > & ) const;
+};
+
+
+/*function prototypes */
+bool evalRateBatch( Block *, const std::vector< std::string > &, const std::vector< std::vector< int > > &, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &, std::vector< double > & );
+
+#endif
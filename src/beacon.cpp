@@ -10,11 +10,12 @@
 
 #include "beacon.h"
 #include "common.h"
+#include "batch.h"
 #include <algorithm>
 #include <limits>
 
 
-void getBoundsCombinations(std::vector< std::vector< std::pair<int, int> > > &input,
+void getBoundsCombinations(std::vector< IntervalSet > &input,
 		unsigned int dim,
 		std::vector<int> lbCarryOver,
 		std::vector<int> ubCarryOver,
@@ -48,10 +49,11 @@ void getBoundsCombinations(std::vector< std::vector< std::pair<int, int> > > &in
 }
 
 
-BeaconChannel::BeaconChannel( std::vector< std::string > name, GlobalVariables &globalVars ){
+BeaconChannel::BeaconChannel( std::vector< std::string > name, GlobalVariables &globalVars, ExpressionMemo *memo ){
 
 	_channelName = name;
 	_globalVars = globalVars;
+	_memo = memo;
 }
 
 
@@ -74,7 +76,7 @@ std::cout << std::endl;
 			//build the candidate
 			std::shared_ptr<Candidate> cand( new Candidate( mrb, currentParameters, sp -> localVariables, sp, parallelProcesses) );
 			cand -> beaconChannelName = _channelName;
-			Numerical rate = evalRPN_numerical( b -> getRate(), currentParameters, _globalVars, sp -> localVariables );
+			Numerical rate = _memo -> rate( b, currentParameters, _globalVars, sp -> localVariables );
 			if ( rate.doubleCast() <= 0 ) throw BadRate( b -> getToken() );
 			cand -> rate = rate.doubleCast();
 
@@ -83,15 +85,14 @@ std::cout << std::endl;
 			if (mrb -> usesSets()){
 
 				//get the bounds for each set expression
-				std::vector< std::vector< std::pair<int, int> > > bounds;
+				std::vector< IntervalSet > bounds;
 				for ( unsigned int i = 0; i < setExpressions.size(); i++ ){
 
 					if (setExpressions[i][0] -> identify() == "Wildcard"){
-						bounds.push_back({{std::numeric_limits<int>::min(),std::numeric_limits<int>::max()}});
+						bounds.push_back( IntervalSet( std::numeric_limits<int>::min(), std::numeric_limits<int>::max() ) );
 					}
 					else{
-						std::vector< std::pair<int, int > > b = evalRPN_set( setExpressions[i], currentParameters, _globalVars, sp -> localVariables );
-						bounds.push_back(b);
+						bounds.push_back( evalRPN_set( setExpressions[i], currentParameters, _globalVars, sp -> localVariables ) );
 					}
 				}
 
@@ -142,15 +143,14 @@ std::cout << "   >>Can receive? " << canReceive << std::endl;
 			if (mrb -> usesSets()){
 
 				//get the bounds for each set expression
-				std::vector< std::vector< std::pair<int, int> > > boundsToFind;
+				std::vector< IntervalSet > boundsToFind;
 				for ( unsigned int i = 0; i < setExpressions.size(); i++ ){
 
 					if (setExpressions[i][0] -> identify() == "Wildcard"){
-						boundsToFind.push_back({{std::numeric_limits<int>::min(),std::numeric_limits<int>::max()}});
+						boundsToFind.push_back( IntervalSet( std::numeric_limits<int>::min(), std::numeric_limits<int>::max() ) );
 					}
 					else{
-						std::vector< std::pair<int, int > > b = evalRPN_set( setExpressions[i], currentParameters, _globalVars, sp -> localVariables );
-						boundsToFind.push_back(b);
+						boundsToFind.push_back( evalRPN_set( setExpressions[i], currentParameters, _globalVars, sp -> localVariables ) );
 					}
 				}
 
@@ -173,14 +173,18 @@ std::cout << "   >>Can receive? " << canReceive << std::endl;
 				matchingParameters = _database.findAll_trivial( valueToFind );
 			}
 
-			Numerical rate;
+			double rate = 0.0;
 
 			//if we don't have binding variables where the rate can depend on what we receive, then we only have to call evalRPN_numerical once
 			if ( not mrb -> bindsVariable() ){
 
-				rate = evalRPN_numerical( mrb -> getRate(), currentParameters, _globalVars, sp -> localVariables );
+				rate = _memo -> rate( mrb, currentParameters, _globalVars, sp -> localVariables ).doubleCast();
 			}
 
+			//otherwise, evaluate the rate for all the values we can receive together if we can
+			std::vector< double > rates;
+			bool batched = mrb -> bindsVariable() and evalRateBatch( mrb, mrb -> getBindingVariable(), matchingParameters, currentParameters, _globalVars, sp -> localVariables, rates );
+
 			//build a candidate for each possible beacon receive on this parameter set
 			for ( auto mp = matchingParameters.begin(); mp < matchingParameters.end(); mp++ ){
 
@@ -197,19 +201,20 @@ std::cout << "   >>Can receive? " << canReceive << std::endl;
 						newRangeEval.push_back(n);
 						augmentedLocalVars[ bindingVarNames[i] ] = n;
 					}
-					rate = evalRPN_numerical( mrb -> getRate(), currentParameters, _globalVars, augmentedLocalVars );
+					if ( batched ) rate = rates[ mp - matchingParameters.begin() ];
+					else rate = _memo -> rate( mrb, currentParameters, _globalVars, augmentedLocalVars ).doubleCast();
 				}
 
-				if ( rate.doubleCast() <= 0 ) throw BadRate( b -> getToken() );
+				if ( rate <= 0 ) throw BadRate( b -> getToken() );
 				std::shared_ptr<Candidate> cand( new Candidate(mrb, currentParameters, augmentedLocalVars, sp, parallelProcesses) );
 				cand -> receiveBounds_lb = lb;
 				cand -> receiveBounds_ub = ub;
 				cand -> beaconChannelName = _channelName;
-				cand -> rate = rate.doubleCast();
+				cand -> rate = rate;
 				cand -> sendReceiveParameters = *mp;
 				_activeBeaconReceiveCands[sp].push_back( cand );
 				candidatesLeft += sp -> clones;
-				rateSum += rate.doubleCast() * (sp -> clones);
+				rateSum += rate * (sp -> clones);
 			}
 
 			//if the mrb can't receive and isn't already in the potential receives, add it to the potential receives
@@ -246,7 +251,7 @@ std::cout << t -> value() << std::endl;
 
 		assert( b -> identify() == "MessageSend" );
 		MessageSendBlock *msb = dynamic_cast< MessageSendBlock * >( b );
-		Numerical rate = evalRPN_numerical( msb -> getRate(), currentParameters, _globalVars, sp -> localVariables );
+		Numerical rate = _memo -> rate( msb, currentParameters, _globalVars, sp -> localVariables );
 		if ( rate.doubleCast() <= 0 ) throw BadRate( b -> getToken() );
 
 		std::shared_ptr< Candidate > cand( new Candidate( msb, currentParameters, sp -> localVariables, sp, parallelProcesses) );
@@ -384,7 +389,7 @@ for (auto a = _sendCands.begin(); a != _sendCands.end(); a++) std::cout << "   >
 			if (mrb -> isCheck() and not canReceive){
 
 				_activeBeaconReceiveCands[sp].push_back(*cand);
-				Numerical rate = evalRPN_numerical( mrb -> getRate(), sp -> parameterValues, _globalVars, sp -> localVariables );
+				Numerical rate = _memo -> rate( mrb, sp -> parameterValues, _globalVars, sp -> localVariables );
 				if ( rate.doubleCast() <= 0 ) throw BadRate( mrb -> getToken() );
 				candidatesLeft += sp -> clones;
 				rateSum += rate.doubleCast() * (sp -> clones);
@@ -400,6 +405,10 @@ for (auto a = _sendCands.begin(); a != _sendCands.end(); a++) std::cout << "   >
 					matchingParameters = _database.findAll_trivial( (*cand) -> sendReceiveParameters );
 				}
 
+				//evaluate the rate for all the values we can receive together if we can
+				std::vector< double > rates;
+				bool batched = mrb -> bindsVariable() and evalRateBatch( mrb, mrb -> getBindingVariable(), matchingParameters, sp -> parameterValues, _globalVars, sp -> localVariables, rates );
+
 				//build a candidate for each possible beacon receive on this parameter set
 				for ( auto mp = matchingParameters.begin(); mp < matchingParameters.end(); mp++ ){
 
@@ -418,17 +427,17 @@ for (auto a = _sendCands.begin(); a != _sendCands.end(); a++) std::cout << "   >
 						}
 					}
 
-					Numerical rate = evalRPN_numerical( mrb -> getRate(), sp -> parameterValues, _globalVars, augmentedLocalVars );
-					if ( rate.doubleCast() <= 0 ) throw BadRate( mrb -> getToken() );
+					double rate = batched ? rates[ mp - matchingParameters.begin() ] : _memo -> rate( mrb, sp -> parameterValues, _globalVars, augmentedLocalVars ).doubleCast();
+					if ( rate <= 0 ) throw BadRate( mrb -> getToken() );
 					std::shared_ptr<Candidate> newCand( new Candidate(mrb, sp -> parameterValues, augmentedLocalVars, sp, (*cand) -> parallelProcesses) );
 					newCand -> receiveBounds_lb = (*cand) -> receiveBounds_lb;
 					newCand -> receiveBounds_ub = (*cand) -> receiveBounds_ub;
 					newCand -> beaconChannelName = _channelName;
-					newCand -> rate = rate.doubleCast();
+					newCand -> rate = rate;
 					newCand -> sendReceiveParameters = *mp;
 					_activeBeaconReceiveCands[sp].push_back( newCand );
 					candidatesLeft += sp -> clones;
-					rateSum += rate.doubleCast() * (sp -> clones);
+					rateSum += rate * (sp -> clones);
 				}
 				if (matchingParameters.size() > 0) cand = (candPair -> second).erase(cand);
 				else cand++;
@@ -548,3 +557,30 @@ void BeaconChannel::cleanCloneFromChannel( SystemProcess *sp ){
 	auto sLoc = _sendCands.find( sp );
 	if (sLoc != _sendCands.end()) _sendCands.erase( sLoc );
 }
+
+
+void BeaconChannel::restoreDatabase( std::vector< std::vector< int > > &entries ){
+//refills the database when a system is restored from a checkpoint, before any candidates are added to this channel
+
+	for ( auto e = entries.begin(); e < entries.end(); e++ ) _database.push( *e );
+}
+
+
+static size_t countCandidates( const std::map< SystemProcess *, std::list< std::shared_ptr<Candidate> > > &pool ){
+
+	size_t total = 0;
+	for ( auto p = pool.begin(); p != pool.end(); p++ ) total += (p -> second).size();
+	return total;
+}
+
+
+size_t BeaconChannel::potentialReceives( void ) const{
+
+	return countCandidates( _potentialBeaconReceiveCands );
+}
+
+
+size_t BeaconChannel::activeReceives( void ) const{
+
+	return countCandidates( _activeBeaconReceiveCands );
+}
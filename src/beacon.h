@@ -18,6 +18,7 @@
 #include <sstream>
 #include <iterator>
 #include "evaluate_trees.h"
+#include "memo.h"
 #include "BPTree.h"
 
 
@@ -107,6 +108,21 @@ class communicationDatabase{
 				return out;
 			}
 		}
+		std::vector< std::vector< int > > entries( void ){
+
+			std::vector< std::vector< int > > out;
+			std::vector< int > unary;
+			_UnaryTree.collectEntries(_UnaryTree.getRoot(), unary);
+			for (auto u = unary.begin(); u < unary.end(); u++) out.push_back({*u});
+			for (auto t = _arity2Tree.begin(); t != _arity2Tree.end(); t++) (t -> second).collectEntries((t -> second).getRoot(), out);
+			return out;
+		}
+		size_t size( void ){
+
+			size_t total = _UnaryTree.size();
+			for (auto t = _arity2Tree.begin(); t != _arity2Tree.end(); t++) total += (t -> second).size();
+			return total;
+		}
 		std::vector< std::vector< int > > findAll_trivial( std::vector< int > &query ){
 
 			//std::cout << "in findAll_trivial" << std::endl;
@@ -141,12 +157,13 @@ class BeaconChannel{
 		std::vector< std::string > _channelName;
 		communicationDatabase _database;
 		GlobalVariables _globalVars;
+		ExpressionMemo *_memo; //owned by the system, shared by all of its channels
 		std::map< SystemProcess *, std::list< std::shared_ptr<Candidate> > > _potentialBeaconReceiveCands;
 		std::map< SystemProcess *, std::list< std::shared_ptr<Candidate> > > _activeBeaconReceiveCands;
 		std::map< SystemProcess *, std::list< std::shared_ptr<Candidate> > > _sendCands;
 
 	public:
-		BeaconChannel( std::vector< std::string >, GlobalVariables & );
+		BeaconChannel( std::vector< std::string >, GlobalVariables &, ExpressionMemo * );
 		BeaconChannel( const BeaconChannel & );
 		std::vector< std::string > getChannelName(void);
 		void updateBeaconCandidates(int &, double &);
@@ -155,6 +172,11 @@ class BeaconChannel{
 		void addCandidate( Block *, SystemProcess *, std::list< SystemProcess > , ParameterValues &, int &, double & );
 		bool matchClone( SystemProcess *, SystemProcess *);
 		void cleanCloneFromChannel( SystemProcess * );
+		std::vector< std::vector< int > > databaseEntries( void ){ return _database.entries(); }
+		void restoreDatabase( std::vector< std::vector< int > > & );
+		size_t databaseSize( void ){ return _database.size(); }
+		size_t potentialReceives( void ) const;
+		size_t activeReceives( void ) const;
 };
 
 
@@ -0,0 +1,477 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+
+#include <string>
+#include <tuple>
+#include <utility>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "../lexer.h"
+#include "../parser.h"
+#include "../simulator.h"
+#include "../model.h"
+#include "../fold.h"
+#include "../memo.h"
+
+static const char *bench_help=
+"bcs benchmark executable.\n"
+"Runs fixed-seed workloads from the examples directory and synthetic scaling models, and writes one tab-delimited line per workload.\n"
+"To run bcs_bench, do:\n"
+"  ./bench [arguments]\n"
+"Optional arguments are:\n"
+"  -o,--output               write the results to this file (default: stdout),\n"
+"  --examples                path to the examples directory (default: examples),\n"
+"  --only                    comma-separated names of the workloads to run (default: all),\n"
+"  --scale                   multiply the number of transitions in each workload by this factor (default: 1),\n"
+"  --seed                    seed for the first simulation of each workload (default: 1),\n"
+"  --repeats                 run each workload this many times and keep the fastest (default: 1),\n"
+"  --compare                 compare throughput and peak memory against a baseline file written by an earlier run,\n"
+"  --threshold               fraction by which a workload can be slower or use more memory than the baseline (default: 0.15),\n"
+"  --list                    list the workloads and exit,\n"
+"  -h,--help                 show useage information.\n";
+
+
+struct Workload{
+
+	std::string name;
+	std::string filename; //relative to the examples directory, or empty for a synthetic model
+	std::string source; //model text for synthetic workloads
+	int simulations;
+	int maxTransitions;
+};
+
+
+struct Arguments {
+
+	std::string outputFilename;
+	std::string examplesDir = "examples";
+	std::vector< std::string > only;
+	double scale = 1.0;
+	unsigned long seed = 1;
+	int repeats = 1;
+	std::string baselineFilename;
+	double threshold = 0.15;
+	bool list = false;
+};
+
+
+struct BenchResult{
+
+	std::string name;
+	double transitionsPerSecond = 0.0;
+	long peakRSS = 0;
+};
+
+
+static std::string syntheticClones( unsigned int n ){
+//n identical processes that drift apart, so the engine has to split and condense clones
+
+	std::stringstream ss;
+	ss << "P[i] = [i < 9] -> {step, 1.0}.P[i+1] + [i == 9] -> {reset, 1.0}.P[0];" << std::endl;
+	ss << n << "*P[0];" << std::endl;
+	return ss.str();
+}
+
+
+static std::string syntheticChannels( unsigned int n ){
+//n beacon channels, each switched on and off by its own process and watched by another
+
+	std::stringstream ss;
+	ss << "On[c] = {c![1], 1.0}.Off[c];" << std::endl;
+	ss << "Off[c] = {c#[1], 1.0}.On[c];" << std::endl;
+	ss << "Watch[c] = {c?[1](x), 1.0}.Watch[c];" << std::endl;
+	for ( unsigned int c = 0; c < n; c++ ){
+
+		if ( c > 0 ) ss << " || ";
+		ss << "On[" << c << "] || Watch[" << c << "]";
+	}
+	ss << ";" << std::endl;
+	return ss.str();
+}
+
+
+static std::string syntheticArity( unsigned int n ){
+//beacons with n values: a sender fills the database, a killer empties it, and receivers search it with a range in the first value
+
+	std::string ones, vars;
+	for ( unsigned int i = 1; i < n; i++ ){
+
+		ones += ",1";
+		vars += ",x" + std::to_string( i );
+	}
+
+	std::stringstream ss;
+	ss << "S[i] = [i < 100] -> {b![i" << ones << "], 1.0}.S[i+1] + [i == 100] -> {clear, 1.0}.K[0];" << std::endl;
+	ss << "K[i] = [i < 100] -> {b#[i" << ones << "], 1.0}.K[i+1] + [i == 100] -> {restart, 1.0}.S[0];" << std::endl;
+	ss << "R[j] = {b?[0..99" << ones << "](x0" << vars << "), 1.0}.R[j];" << std::endl;
+	ss << "S[0]";
+	for ( unsigned int j = 0; j < 10; j++ ) ss << " || R[" << j << "]";
+	ss << ";" << std::endl;
+	return ss.str();
+}
+
+
+static std::string syntheticRangeReceive( unsigned int n ){
+//n beacons that receivers match with a range, each match getting a rate that depends on the value it binds
+
+	std::stringstream ss;
+	ss << "S[i] = [i < " << n << "] -> {b![i], 1.0}.S[i+1];" << std::endl;
+	ss << "R[j] = {b?[0.." << n - 1 << "](x), 1.0/(abs(j-x)+1)}.{move, 1.0}.R[j+1];" << std::endl;
+	ss << "S[0]";
+	for ( unsigned int j = 0; j < 10; j++ ) ss << " || R[" << j * n / 10 << "]";
+	ss << ";" << std::endl;
+	return ss.str();
+}
+
+
+static std::vector< Workload > workloads( void ){
+
+	std::vector< Workload > w;
+	w.push_back( { "abc", "ABC/ABC.bc", "", 1, 50000 } );
+	w.push_back( { "replication", "DNA_Replication/RFB.bc", "", 20, 1000000 } );
+	w.push_back( { "kinesin", "Kinesin/kinesin_crowding.bc", "", 1, 50000 } );
+	w.push_back( { "methylation", "DNA_methylation_dmg/methylation_dmg.bc", "", 1, 20000 } );
+	w.push_back( { "diffusion", "LanguageOverview/1D_DiffusionReaction.bc", "", 1, 100000 } );
+	w.push_back( { "clones_1000", "", syntheticClones( 1000 ), 1, 100000 } );
+	w.push_back( { "channels_100", "", syntheticChannels( 100 ), 1, 50000 } );
+	w.push_back( { "arity_8", "", syntheticArity( 8 ), 1, 10000 } );
+	w.push_back( { "range_200", "", syntheticRangeReceive( 200 ), 1, 20000 } );
+	return w;
+}
+
+
+Arguments parseBenchArguments( int argc, char** argv ){
+
+	Arguments args;
+
+	for ( int i = 1; i < argc; ){
+
+		std::string flag( argv[ i ] );
+
+		if ( flag == "-h" or flag == "--help" ){
+
+			std::cout << bench_help << std::endl;
+			exit(EXIT_SUCCESS);
+		}
+		else if ( flag == "--list" ){
+
+			args.list = true;
+			i+=1;
+			continue;
+		}
+
+		if ( i + 1 >= argc ){
+
+			std::cout << "Exiting with error.  No value given for " << flag << "." << std::endl << bench_help << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		std::string strArg( argv[ i + 1 ] );
+
+		if ( flag == "-o" or flag == "--output" ) args.outputFilename = strArg;
+		else if ( flag == "--examples" ) args.examplesDir = strArg;
+		else if ( flag == "--scale" ) args.scale = atof( strArg.c_str() );
+		else if ( flag == "--seed" ) args.seed = std::stoul( strArg );
+		else if ( flag == "--repeats" ) args.repeats = atoi( strArg.c_str() );
+		else if ( flag == "--compare" ) args.baselineFilename = strArg;
+		else if ( flag == "--threshold" ) args.threshold = atof( strArg.c_str() );
+		else if ( flag == "--only" ){
+
+			std::stringstream ss( strArg );
+			std::string name;
+			while ( std::getline( ss, name, ',' ) ) args.only.push_back( name );
+		}
+		else{
+
+			std::cout << "Exiting with error.  Unknown flag specified." << std::endl << bench_help << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		i+=2;
+	}
+
+	if ( args.scale <= 0.0 ){
+
+		std::cout << "Exiting with error.  Scale must be positive." << std::endl << bench_help << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if ( args.repeats < 1 ){
+
+		std::cout << "Exiting with error.  Repeats must be a positive integer." << std::endl << bench_help << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if ( args.threshold < 0.0 ){
+
+		std::cout << "Exiting with error.  Threshold can't be negative." << std::endl << bench_help << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return args;
+}
+
+
+static std::string writeScratchModel( const std::string &source ){
+//synthetic workloads are parsed from a file in the temporary directory, so nothing is left in the directory bench is run from
+
+	const char *tmp = getenv( "TMPDIR" );
+	std::string path = std::string( ( tmp and *tmp ) ? tmp : "/tmp" ) + "/bcs_bench_XXXXXX";
+	std::vector< char > name( path.begin(), path.end() );
+	name.push_back( '\0' );
+
+	int fd = mkstemp( &name[0] );
+	if ( fd < 0 ) throw BadOutputPath();
+	bool written = write( fd, source.data(), source.size() ) == (ssize_t) source.size();
+	close( fd );
+	if ( not written ){
+
+		std::remove( &name[0] );
+		throw BadOutputPath();
+	}
+	return std::string( &name[0] );
+}
+
+
+static std::string runWorkload( Workload &w, Arguments &args ){
+//parses and simulates one workload on one thread, and returns its line of results
+//output is formatted into memory as it would be for a normal run, but never written to disk
+
+	std::string filename;
+	if ( w.filename.empty() ) filename = writeScratchModel( w.source );
+	else filename = args.examplesDir + "/" + w.filename;
+
+	std::chrono::time_point<std::chrono::steady_clock> parseStart = std::chrono::steady_clock::now();
+	CompiledModel model;
+	try{
+
+		model = parseModel( filename );
+	}
+	catch ( ... ){
+
+		if ( w.filename.empty() ) std::remove( filename.c_str() );
+		throw;
+	}
+	if ( w.filename.empty() ) std::remove( filename.c_str() );
+	foldConstants( model, std::set< std::string >() );
+	findExpressionReads( model );
+	std::vector< GridPoint > grid = SweepGrid().build( model.processDefinitions, model.systemLine, model.system, model.globalVars );
+	std::chrono::duration<double> parseTime = std::chrono::steady_clock::now() - parseStart;
+
+	SimulationOptions options;
+	options.maxTransitions = std::max( 1, (int) ( w.maxTransitions * args.scale ) );
+	OutputTables tables( model.processDefinitions, options.recordNames, options.ignoreNames );
+
+	PhaseProfile profile;
+	std::chrono::time_point<std::chrono::steady_clock> simulationStart = std::chrono::steady_clock::now();
+	for ( int s = 0; s < w.simulations; s++ ){
+
+		System systemLocal( grid[0], model.processDefinitions, model.observables, model.stopConditions, options, tables );
+		systemLocal.seed( args.seed + s );
+		systemLocal.setProfile( &profile );
+		systemLocal.simulate();
+	}
+	std::chrono::duration<double> simulationTime = std::chrono::steady_clock::now() - simulationStart;
+
+	struct rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+#ifdef __APPLE__
+	long peakRSS = usage.ru_maxrss / 1024; //bytes on OSX
+#else
+	long peakRSS = usage.ru_maxrss; //kilobytes on Linux
+#endif
+
+	std::stringstream row;
+	row << w.name << '\t' << profile.simulations << '\t' << profile.transitions << '\t' << parseTime.count() << '\t' << simulationTime.count();
+	row << '\t' << profile.transitions / simulationTime.count() << '\t' << peakRSS;
+	for ( unsigned int p = 0; p < NUM_PHASES; p++ ) row << '\t' << profile.seconds[p];
+	row << std::endl;
+	return row.str();
+}
+
+
+static bool runInChild( Workload &w, Arguments &args, std::string &row ){
+//each workload runs in its own process so that its peak memory isn't hidden by the workloads before it
+
+	int fd[2];
+	if ( pipe( fd ) != 0 ){
+
+		std::cerr << "Exiting with error.  Could not open a pipe." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::cout.flush();
+	pid_t pid = fork();
+	if ( pid == 0 ){
+
+		close( fd[0] );
+		int status = 0;
+		try{
+
+			std::string result = runWorkload( w, args );
+			if ( write( fd[1], result.data(), result.size() ) != (ssize_t) result.size() ) status = 1;
+		}
+		catch ( std::exception &e ){
+
+			std::cerr << w.name << ": " << e.what() << std::endl;
+			status = 1;
+		}
+		close( fd[1] );
+		_exit( status );
+	}
+
+	close( fd[1] );
+	row.clear();
+	char buffer[4096];
+	ssize_t n;
+	while ( ( n = read( fd[0], buffer, sizeof( buffer ) ) ) > 0 ) row.append( buffer, n );
+	close( fd[0] );
+
+	int status;
+	waitpid( pid, &status, 0 );
+	return WIFEXITED( status ) and WEXITSTATUS( status ) == 0 and not row.empty();
+}
+
+
+static bool parseRow( const std::string &row, BenchResult &result ){
+//reads the workload name, throughput, and peak memory out of a line of results
+
+	std::vector< std::string > fields;
+	std::stringstream ss( row );
+	std::string field;
+	while ( std::getline( ss, field, '\t' ) ) fields.push_back( field );
+	if ( fields.size() < 7 or fields[0].empty() or fields[0][0] == '#' ) return false;
+
+	try{
+
+		result.name = fields[0];
+		result.transitionsPerSecond = std::stod( fields[5] );
+		result.peakRSS = std::stol( fields[6] );
+	}
+	catch ( ... ){
+
+		return false;
+	}
+	return true;
+}
+
+
+static bool compareToBaseline( std::vector< BenchResult > &results, Arguments &args ){
+//a workload regresses if its throughput drops, or its peak memory grows, by more than the threshold
+
+	std::ifstream baselineFile( args.baselineFilename );
+	if ( not baselineFile.is_open() ){
+
+		std::cerr << "Exiting with error.  Could not open baseline file " << args.baselineFilename << "." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::map< std::string, BenchResult > baseline;
+	std::string line;
+	while ( std::getline( baselineFile, line ) ){
+
+		BenchResult br;
+		if ( parseRow( line, br ) ) baseline[br.name] = br;
+	}
+
+	bool regressed = false;
+	std::cout << "#workload\tbaselineTransitionsPerSecond\ttransitionsPerSecond\tchange\tbaselinePeakRSS_kB\tpeakRSS_kB\tchange\tstatus" << std::endl;
+	for ( auto r = results.begin(); r < results.end(); r++ ){
+
+		if ( baseline.count( r -> name ) == 0 ){
+
+			std::cout << r -> name << "\t.\t" << r -> transitionsPerSecond << "\t.\t.\t" << r -> peakRSS << "\t.\tno baseline" << std::endl;
+			continue;
+		}
+
+		BenchResult &b = baseline[ r -> name ];
+		double speedChange = r -> transitionsPerSecond / b.transitionsPerSecond - 1.0;
+		double memoryChange = (double) r -> peakRSS / b.peakRSS - 1.0;
+		std::string status = "ok";
+		if ( speedChange < -args.threshold ) status = "SLOWER";
+		if ( memoryChange > args.threshold ) status = ( status == "ok" ) ? "MORE MEMORY" : status + ", MORE MEMORY";
+		if ( status != "ok" ) regressed = true;
+
+		std::cout << r -> name << '\t' << b.transitionsPerSecond << '\t' << r -> transitionsPerSecond << '\t' << std::showpos << std::fixed << std::setprecision(1) << 100.0 * speedChange << "%" << std::noshowpos << std::defaultfloat << std::setprecision(6);
+		std::cout << '\t' << b.peakRSS << '\t' << r -> peakRSS << '\t' << std::showpos << std::fixed << std::setprecision(1) << 100.0 * memoryChange << "%" << std::noshowpos << std::defaultfloat << std::setprecision(6);
+		std::cout << '\t' << status << std::endl;
+	}
+
+	if ( regressed ) std::cout << "Performance regressed by more than " << 100.0 * args.threshold << "% against " << args.baselineFilename << "." << std::endl;
+	else std::cout << "No workload regressed by more than " << 100.0 * args.threshold << "% against " << args.baselineFilename << "." << std::endl;
+	return not regressed;
+}
+
+
+int main( int argc, char** argv ){
+
+	Arguments args = parseBenchArguments( argc, argv );
+	std::vector< Workload > all = workloads();
+
+	if ( args.list ){
+
+		for ( auto w = all.begin(); w < all.end(); w++ ) std::cout << w -> name << '\t' << ( ( w -> filename.empty() ) ? "synthetic" : w -> filename ) << std::endl;
+		return 0;
+	}
+
+	std::ofstream outFile;
+	if ( not args.outputFilename.empty() ){
+
+		outFile.open( args.outputFilename );
+		if ( not outFile.is_open() ) throw BadOutputPath();
+	}
+	std::ostream &out = ( args.outputFilename.empty() ) ? std::cout : outFile;
+
+	out << "#workload\tsimulations\ttransitions\tparseSeconds\tsimulationSeconds\ttransitionsPerSecond\tpeakRSS_kB";
+	for ( unsigned int p = 0; p < NUM_PHASES; p++ ) out << '\t' << phaseName( p );
+	out << std::endl;
+
+	int failures = 0;
+	std::vector< BenchResult > results;
+	for ( auto w = all.begin(); w < all.end(); w++ ){
+
+		if ( not args.only.empty() and std::find( args.only.begin(), args.only.end(), w -> name ) == args.only.end() ) continue;
+
+		//noise only ever makes a run slower, so the fastest of the repeats is the best estimate
+		std::string best;
+		BenchResult bestResult;
+		for ( int r = 0; r < args.repeats; r++ ){
+
+			std::string row;
+			BenchResult result;
+			if ( not runInChild( *w, args, row ) or not parseRow( row, result ) ){
+
+				best.clear();
+				break;
+			}
+			if ( best.empty() or result.transitionsPerSecond > bestResult.transitionsPerSecond ){
+
+				best = row;
+				bestResult = result;
+			}
+		}
+
+		if ( best.empty() ){
+
+			std::cerr << "Workload " << w -> name << " failed." << std::endl;
+			failures++;
+			continue;
+		}
+		out << best;
+		out.flush();
+		results.push_back( bestResult );
+	}
+
+	if ( not args.baselineFilename.empty() and not compareToBaseline( results, args ) ) return EXIT_FAILURE;
+	return ( failures > 0 ) ? EXIT_FAILURE : 0;
+}
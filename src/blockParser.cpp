@@ -43,7 +43,7 @@ bool operator!= (const SystemProcess &sp1, const SystemProcess &sp2){
 }
 */
 
-void printBlockTree( Tree<Block> pt, Block *b ){
+void printBlockTree( Tree<Block> &pt, Block *b ){
 /*for testing/debugging - prints out the parse tree */
 
 	/*if this token has children */
@@ -536,6 +536,44 @@ for ( auto exp = _parameterExpressions.begin(); exp < _parameterExpressions.end(
 }
 
 
+void ActionBlock::visitExpressions( ExpressionVisitor visit ){
+
+	visit( _RPNrate, NUMERICAL_EXPRESSION );
+}
+
+
+void GateBlock::visitExpressions( ExpressionVisitor visit ){
+
+	visit( _RPNexpression, CONDITION_EXPRESSION );
+}
+
+
+void MessageReceiveBlock::visitExpressions( ExpressionVisitor visit ){
+//set expressions are evaluated as sets rather than numbers, so they're only visited if the receive doesn't use sets
+
+	visit( _RPNrate, NUMERICAL_EXPRESSION );
+	for ( auto exp = _channelNames.begin(); exp < _channelNames.end(); exp++ ) visit( *exp, CHANNEL_EXPRESSION );
+	if ( not _usesSets ){
+
+		for ( auto exp = _RPNexpressions.begin(); exp < _RPNexpressions.end(); exp++ ) visit( *exp, NUMERICAL_EXPRESSION );
+	}
+}
+
+
+void MessageSendBlock::visitExpressions( ExpressionVisitor visit ){
+
+	visit( _RPNrate, NUMERICAL_EXPRESSION );
+	for ( auto exp = _channelNames.begin(); exp < _channelNames.end(); exp++ ) visit( *exp, CHANNEL_EXPRESSION );
+	for ( auto exp = _RPNexpressions.begin(); exp < _RPNexpressions.end(); exp++ ) visit( *exp, NUMERICAL_EXPRESSION );
+}
+
+
+void ProcessBlock::visitExpressions( ExpressionVisitor visit ){
+
+	for ( auto exp = _parameterExpressions.begin(); exp < _parameterExpressions.end(); exp++ ) visit( *exp, NUMERICAL_EXPRESSION );
+}
+
+
 /*SECOND PASS PARSING FUNCTIONS--------------------------------------------------------------------------------------------------------------------------------------*/
 Block *tokenToBlock( Token *t,
 		             std::string processName,
@@ -578,61 +616,73 @@ Block *tokenToBlock( Token *t,
 }
 
 
-void secondParseSystemLine( std::vector< Token * > &tokenisedSL, std::list< SystemProcess > &system, std::map< std::string, ProcessDefinition > &processName2Definition, GlobalVariables &globalVars ){
+void secondParseSystemLine( std::vector< SystemLineTerm > &systemLine, std::list< SystemProcess > &system, std::map< std::string, ProcessDefinition > &processName2Definition, GlobalVariables &globalVars ){
+//evaluates the system line under globalVars
+//the parameters of each process were lexed by the first pass, so this can be called again for each grid point without re-lexing
 
-	/*last entry in the system line should be a process */
-	if ( (*(tokenisedSL.end() - 1)) -> identify() != "Process" ){
+	/*make sure all processes have a corresponding definition */
+	for ( auto term = systemLine.begin(); term < systemLine.end(); term++ ){
 
-		throw SyntaxError( *(tokenisedSL.end() - 1), "Thrown by block parser: Trailing token in system line must be a process.");
-	}
+		int multiplier = 1;
+		if ( term -> multiplier != NULL ){
 
-	/*make sure all operators are ||, that each process is separated by ||, and that all processes have a corresponding definition */
-	int multiplier = 1;
-	for ( auto t = tokenisedSL.begin(); t < tokenisedSL.end(); t++ ){
+			Token *t = term -> multiplier;
+			std::string str_multiplier = t -> value();
+			
+			if ( t -> identify() == "Variable" ){
 
-		if( (*t) -> identify() == "Process" ){
+				if ( globalVars.values.count(str_multiplier) == 0 ) throw UndefinedVariable( t );
+				Numerical multiplier_n = globalVars.values.at(str_multiplier);
+				if (multiplier_n.isDouble()) throw SyntaxError( t, "Thrown by block parser: System process multiplier must be an int, not a float.");
+				multiplier = multiplier_n.getInt();
+			}
+			else{
 
-			SystemProcess sp;
+				multiplier = std::stoi(str_multiplier);
+			}
 
-			/*get the name of the process */
-			std::string wholeProcess = (*t) -> value();
-			std::string processName = wholeProcess.substr( 0, wholeProcess.find('[') );
+			if ( multiplier <= 0 ) throw SyntaxError(t, "Thrown by block parser: System process multiplier must be greater than zero.");
+		}
 
-			/*set the readhead at the process tree's root */
-			if ( processName2Definition.count( processName ) == 0 ) throw UndefinedVariable( *t );
-			
-			sp.parseTree = (processName2Definition[processName]).parseTree;
-			
-			/*get the initial conditions of the parameters */
-			std::string betweenBrackets = wholeProcess.substr( wholeProcess.find("[") + 1, wholeProcess.find("]") - wholeProcess.find("[") - 1 );
-			std::vector< Token * > tokenisedParams = scanLine( betweenBrackets, (*t) -> getLine(), (*t) -> getColumn() );
+		SystemProcess sp;
+		const std::string &processName = term -> processName;
 
-			std::vector< std::string > parameterVar = (processName2Definition[processName]).parameters;
+		/*set the readhead at the process tree's root */
+		auto definition = processName2Definition.find( processName );
+		if ( definition == processName2Definition.end() ) throw UndefinedVariable( term -> process );
+		
+		sp.parseTree = (definition -> second).parseTree;
+		
+		/*get the initial conditions of the parameters */
+		std::vector< std::string > &parameterVar = (definition -> second).parameters;
 
-			if (tokenisedParams.size() == 0){ //if we don't have any process parameters, check this matches the definition and move on
+		if ( term -> parameters.size() == 0 ){ //if we don't have any process parameters, check this matches the definition and move on
 
-				if (parameterVar.size() != 0){
-					throw SyntaxError( *t, "Thrown by block parser: Number of parameters specified do not match the process definition." );
-				}
+			if (parameterVar.size() != 0){
+				throw SyntaxError( term -> process, "Thrown by block parser: Number of parameters specified do not match the process definition." );
 			}
-			else{ //if you do have parameters, check they match the definition and update the system process accordingly
-
-				std::vector< std::vector< Token * > > split_tokenisedParam = splitOnCommas( tokenisedParams );
-				if (parameterVar.size() != split_tokenisedParam.size()) throw SyntaxError( *t, "Thrown by block parser: Number of parameters specified do not match the process definition." );
-				ParameterValues pValues;
-				for ( unsigned int i = 0; i < split_tokenisedParam.size(); i++ ){
-
-					std::vector< Token * > parsedIntlExp = shuntingYard( split_tokenisedParam[i] );
-					ParameterValues ParameterValues_dummy;
-					std::map< std::string, Numerical > localVariables_dummy;
-					Numerical intlValue = evalRPN_numerical(parsedIntlExp, ParameterValues_dummy, globalVars, localVariables_dummy);
-					pValues.updateValue(parameterVar[i], intlValue);
-				}
-				sp.parameterValues = pValues;
+		}
+		else{ //if you do have parameters, check they match the definition and update the system process accordingly
+
+			std::vector< std::vector< Token * > > split_tokenisedParam = splitOnCommas( term -> parameters );
+			if (parameterVar.size() != split_tokenisedParam.size()) throw SyntaxError( term -> process, "Thrown by block parser: Number of parameters specified do not match the process definition." );
+			ParameterValues pValues;
+			ParameterValues ParameterValues_dummy;
+			std::map< std::string, Numerical > localVariables_dummy;
+			for ( unsigned int i = 0; i < split_tokenisedParam.size(); i++ ){
+
+				/*generated models mostly give each parameter as a single literal or variable, which is already in reverse Polish notation */
+				std::vector< Token * > &intlExp = split_tokenisedParam[i];
+				bool singleOperand = intlExp.size() == 1 and ( intlExp[0] -> identify() == "IntLiteral" or intlExp[0] -> identify() == "DoubleLiteral" or intlExp[0] -> identify() == "Variable" );
+				std::vector< Token * > parsedIntlExp = singleOperand ? intlExp : shuntingYard( intlExp );
+				Numerical intlValue = evalRPN_numerical(parsedIntlExp, ParameterValues_dummy, globalVars, localVariables_dummy);
+				pValues.updateValue(parameterVar[i], intlValue);
 			}
-			
-			sp.clones = multiplier;
-			system.push_back(sp);
+			sp.parameterValues = pValues;
+		}
+		
+		sp.clones = multiplier;
+		system.push_back(sp);
 
 #if DEBUG
 std::cout << "---------------" << std::endl;
@@ -647,27 +697,6 @@ for (auto param = sp.parameterValues.values.begin(); param != sp.parameterValues
 	if ( (param -> second).isInt() ) std::cout << param -> first << " " << (param -> second).getInt() << " int" << std::endl;
 }
 #endif
-			multiplier = 1;
-		}
-		else if ( (*t) -> identify() == "Variable" or (*t) -> identify() == "IntLiteral" ){
-
-			std::string str_multiplier = (*t) -> value();
-			
-			if ( (*t) -> identify() == "Variable" ){
-
-				if ( globalVars.values.count(str_multiplier) == 0 ) throw UndefinedVariable( *t );
-				Numerical multiplier_n = globalVars.values.at(str_multiplier);
-				if (multiplier_n.isDouble()) throw SyntaxError( *t, "Thrown by block parser: System process multiplier must be an int, not a float.");
-				multiplier = multiplier_n.getInt();
-			}
-			else{
-
-				multiplier = std::stoi(str_multiplier);
-			}
-
-
-			if ( multiplier <= 0 ) throw SyntaxError(*t, "Thrown by block parser: System process multiplier must be greater than zero.");
-		}
 	}
 }
 
@@ -733,8 +762,136 @@ void checkProcessDefinition( Block *b, Tree<Block> &bt, std::map< std::string, P
 }
 
 
-std::pair< std::map< std::string, ProcessDefinition >, std::list< SystemProcess > > secondPassParse( std::vector< Tree<Token> > processDefPTs,
-		                                                                                             std::vector< Token* > tokenisedSystemLine,
+unsigned int numberBlocks( std::map< std::string, ProcessDefinition > &processName2Definition ){
+//assigns each block in each process definition a unique index in [0, number of blocks)
+//returns the number of blocks numbered
+
+	unsigned int blockID = 0;
+	for ( auto pd = processName2Definition.begin(); pd != processName2Definition.end(); pd++ ){
+
+		std::vector< Block * > nodes = (pd -> second).parseTree.getNodes();
+		for ( auto b = nodes.begin(); b < nodes.end(); b++ ){
+
+			(*b) -> setID( blockID );
+			blockID++;
+		}
+	}
+	return blockID;
+}
+
+
+std::vector< ObservableDefinition > parseObservables( std::vector< std::vector< Token * > > &declarationLines,
+                                                    std::map< std::string, ProcessDefinition > &processName2Definition,
+                                                    GlobalVariables &globalVars ){
+//builds observables from declarations of the form observe name = [condition] -> P[a,b,...]
+//the names in P's brackets bind to P's parameters in order and can be used in the (optional) condition
+
+	std::vector< ObservableDefinition > observables;
+	std::set< std::string > namesUsed;
+
+	for ( auto line = declarationLines.begin(); line < declarationLines.end(); line++ ){
+
+		if ( (*line)[0] -> value() != "observe" ) continue;
+
+		ObservableDefinition od;
+		Token *nameToken = (*line)[1];
+		Token *processToken = line -> back();
+		od.name = nameToken -> value();
+		if ( namesUsed.count( od.name ) > 0 ) throw SyntaxError( nameToken, "Thrown by block parser: Observable names must be unique." );
+		namesUsed.insert( od.name );
+
+		/*the observed process must be defined */
+		std::string pTokenValue = processToken -> value();
+		od.processName = pTokenValue.substr( 0, pTokenValue.find('[') );
+		if ( processName2Definition.count( od.processName ) == 0 ) throw SyntaxError( processToken, "Thrown by block parser: Observed process has not been defined." );
+
+		/*binding names, one for each parameter of the process */
+		std::string betweenBrackets = pTokenValue.substr( pTokenValue.find("[") + 1, pTokenValue.find("]") - pTokenValue.find("[") - 1 );
+		std::vector< Token * > tokenisedBinding = scanLine( betweenBrackets, processToken -> getLine(), processToken -> getColumn() );
+		int flip = 0;
+		for ( auto t = tokenisedBinding.begin(); t < tokenisedBinding.end(); t++ ){
+
+			if ( (*t) -> identify() == "Variable" and flip == 0 ) (od.bindingNames).push_back( (*t) -> value() );
+			else if ( (*t) -> identify() != "Comma" or flip == 0 ) throw SyntaxError( *t, "Thrown by block parser: Observed process parameters must be variable names separated by commas." );
+			flip++; flip %= 2;
+		}
+		if ( tokenisedBinding.size() > 0 and flip == 0 ) throw SyntaxError( tokenisedBinding.back(), "Thrown by block parser: Parameter list must trail with a variable." );
+		if ( od.bindingNames.size() != processName2Definition[ od.processName ].parameters.size() ){
+
+			throw SyntaxError( processToken, "Thrown by block parser: Number of parameters specified do not match the process definition." );
+		}
+
+		/*the condition can use the binding names and global variables */
+		if ( (*line)[3] -> identify() == "Gate" ){
+
+			GateBlock gb( (*line)[3], od.processName, od.bindingNames, globalVars.getNames() );
+			od.RPNcondition = gb.getConditionExpression();
+		}
+
+		observables.push_back( od );
+	}
+	return observables;
+}
+
+
+std::vector< StopCondition > parseStopConditions( std::vector< std::vector< Token * > > &declarationLines,
+                                                 std::vector< ObservableDefinition > &observables,
+                                                 std::map< std::string, ProcessDefinition > &processName2Definition,
+                                                 GlobalVariables &globalVars ){
+//builds stop conditions from declarations of the form stop when <condition>
+//the condition can use declared observables, the number of times an action has fired (by the action's name), and global variables
+
+	std::set< std::string > actionNames;
+	for ( auto pd = processName2Definition.begin(); pd != processName2Definition.end(); pd++ ){
+
+		std::vector< Block * > nodes = (pd -> second).parseTree.getNodes();
+		for ( auto b = nodes.begin(); b < nodes.end(); b++ ){
+
+			if ( (*b) -> identify() == "Action" ) actionNames.insert( static_cast< ActionBlock * >( *b ) -> actionName );
+		}
+	}
+	std::vector< std::string > globalNames = globalVars.getNames();
+
+	std::vector< StopCondition > stopConditions;
+	for ( auto line = declarationLines.begin(); line < declarationLines.end(); line++ ){
+
+		if ( (*line)[0] -> value() != "stop" ) continue;
+
+		StopCondition sc;
+		std::vector< Token * > condition( line -> begin() + 2, line -> end() );
+		for ( auto t = condition.begin(); t < condition.end(); t++ ){
+
+			if ( (*t) -> identify() != "Variable" ) continue;
+			std::string variableName = (*t) -> value();
+
+			int observableIdx = -1;
+			for ( unsigned int i = 0; i < observables.size(); i++ ){
+
+				if ( observables[i].name == variableName ) observableIdx = i;
+			}
+			bool isAction = actionNames.count( variableName ) > 0;
+
+			if ( observableIdx != -1 and isAction ) throw SyntaxError( *t, "Thrown by block parser: Name in stop condition is both an observable and an action." );
+			else if ( observableIdx != -1 ){
+
+				if ( std::find( sc.observables.begin(), sc.observables.end(), observableIdx ) == sc.observables.end() ) sc.observables.push_back( observableIdx );
+			}
+			else if ( isAction ){
+
+				if ( std::find( sc.actionNames.begin(), sc.actionNames.end(), variableName ) == sc.actionNames.end() ) sc.actionNames.push_back( variableName );
+			}
+			else if ( std::find( globalNames.begin(), globalNames.end(), variableName ) == globalNames.end() ) throw UndefinedVariable( *t );
+		}
+
+		sc.RPNcondition = shuntingYard( condition );
+		stopConditions.push_back( sc );
+	}
+	return stopConditions;
+}
+
+
+std::pair< std::map< std::string, ProcessDefinition >, std::list< SystemProcess > > secondPassParse( std::vector< Tree<Token> > &processDefPTs,
+		                                                                                             std::vector< SystemLineTerm > &tokenisedSystemLine,
 																									 GlobalVariables &globalVars ){
 //main function for second pass parsing.  sets the root of the new block tree, calls
 //secondParseProcessDef to fill out the tree, then substitutes all variables 
@@ -797,6 +954,9 @@ printBlockTree( pd.parseTree, (pd.parseTree).getRoot() );
 		checkProcessDefinition( (pd -> second).parseTree.getRoot(), (pd -> second).parseTree, processName2Definition );
 	}
 
+	//give every block a dense index so that per-block tables can be built after parsing
+	numberBlocks( processName2Definition );
+
 	/*second round parse of system line */
 	std::list< SystemProcess > system;
 	secondParseSystemLine( tokenisedSystemLine, system, processName2Definition, globalVars );
@@ -804,5 +964,5 @@ printBlockTree( pd.parseTree, (pd.parseTree).getRoot() );
 #if defined DEBUG
 exit(EXIT_SUCCESS);
 #endif
-	return std::make_pair(processName2Definition, system );
+	return std::make_pair( std::move( processName2Definition ), std::move( system ) );
 }
@@ -15,20 +15,61 @@
 #include <string>
 #include <tuple>
 #include <iostream>
+#include <functional>
+#include <exception>
 #include "parser.h"
 #include "lexer.h"
+#include "intervals.h"
+#include "typed.h"
+
+class ModelWriter;
+class ModelReader;
+
+/*how an expression in a block is evaluated - channel names are kept as they are when they're a single variable that isn't a parameter */
+enum ExpressionKind { NUMERICAL_EXPRESSION, CONDITION_EXPRESSION, CHANNEL_EXPRESSION };
+typedef std::function< void( std::vector< Token * > &, ExpressionKind ) > ExpressionVisitor;
 
 class Block{
 
 	protected:
-		Token * inputToken;
+		Token * inputToken = NULL;
+		unsigned int _blockID = 0;
+		bool _constantRate = false;
+		Numerical _rateValue;
+		int _memoSlot = -1;
+		std::vector< std::string > _memoReads;
+		std::vector< TypedProgram > _typedPrograms;
 		Block( Token * t, std::string &name, std::vector<std::string> paramNames, std::vector<std::string> globalNames ){inputToken = t;}
+		Block(){}
 
 	public:
+		virtual void writeState( ModelWriter & ) const;
+		virtual void readState( ModelReader & );
+		unsigned int getID( void ) const { return _blockID; }
+		void setID( unsigned int id ){ _blockID = id; }
 		virtual Token * getToken(void) const = 0;
 		virtual std::string identify( void ) const = 0;
 		virtual std::vector< Token * > getRate( void ) const = 0;
 		virtual std::string getOwningProcess( void ) const = 0;
+		virtual void visitExpressions( ExpressionVisitor ){}
+		bool hasConstantRate( void ) const { return _constantRate; }
+		Numerical getConstantRate( void ) const { return _rateValue; }
+		void setConstantRate( Numerical n ){
+
+			_rateValue = n;
+			_constantRate = true;
+		}
+		bool isMemoised( void ) const { return _memoSlot >= 0; }
+		unsigned int getMemoSlot( void ) const { return _memoSlot; }
+		const std::vector< std::string > &getMemoReads( void ) const { return _memoReads; }
+		void setMemoReads( unsigned int slot, std::vector< std::string > &reads ){
+
+			_memoSlot = slot;
+			_memoReads = reads;
+		}
+		bool isTyped( void ) const { return not _typedPrograms.empty(); }
+		const TypedProgram &getTypedProgram( unsigned int intReads ) const { return _typedPrograms[ intReads ]; }
+		void setTypedPrograms( std::vector< TypedProgram > &programs ){ _typedPrograms = programs; }
 };
 
 class ActionBlock: public Block {
@@ -40,6 +81,10 @@ class ActionBlock: public Block {
 
 	public:
 		ActionBlock( Token *, std::string, std::vector<std::string>, std::vector<std::string> );
+		ActionBlock(){}
+		void writeState( ModelWriter & ) const;
+		void readState( ModelReader & );
+		void visitExpressions( ExpressionVisitor );
 		ActionBlock( const ActionBlock &ab ) : Block(ab){
 
 			actionName = ab.actionName;
@@ -61,6 +106,9 @@ class ChoiceBlock: public Block {
 	public:
 		Token * getToken(void) const {return _underlyingToken;}
 		ChoiceBlock( Token *, std::string, std::vector<std::string>, std::vector<std::string> );
+		ChoiceBlock(){}
+		void writeState( ModelWriter & ) const;
+		void readState( ModelReader & );
 		ChoiceBlock( const ChoiceBlock &cb ) : Block(cb) {}
 		std::string identify( void ) const { return "Choice"; }
 		std::vector< Token * > getRate( void ) const { assert( false ); }
@@ -76,6 +124,9 @@ class ParallelBlock: public Block {
 	public:
 		Token * getToken(void) const {return _underlyingToken;}
 		ParallelBlock( Token *, std::string, std::vector<std::string>, std::vector<std::string> );
+		ParallelBlock(){}
+		void writeState( ModelWriter & ) const;
+		void readState( ModelReader & );
 		ParallelBlock( const ParallelBlock &cb ) : Block(cb) {}
 		std::string identify( void ) const { return "Parallel"; }
 		std::vector< Token * > getRate( void ) const { assert( false ); }
@@ -91,6 +142,10 @@ class GateBlock: public Block {
 	public:
 		Token * getToken(void) const {return _underlyingToken;}
 		GateBlock( Token *, std::string, std::vector<std::string>, std::vector<std::string> );
+		GateBlock(){}
+		void writeState( ModelWriter & ) const;
+		void readState( ModelReader & );
+		void visitExpressions( ExpressionVisitor );
 		GateBlock( const GateBlock &gb ) : Block(gb){
 
 			_RPNexpression = gb.getConditionExpression();
@@ -114,6 +169,10 @@ class MessageReceiveBlock: public Block {
 
 	public:
 		MessageReceiveBlock( Token *, std::string, std::vector<std::string>, std::vector<std::string> );
+		MessageReceiveBlock(){}
+		void writeState( ModelWriter & ) const;
+		void readState( ModelReader & );
+		void visitExpressions( ExpressionVisitor );
 		MessageReceiveBlock( const MessageReceiveBlock &mb ) : Block(mb){
 
 			_handshake = mb.isHandshake();
@@ -148,6 +207,10 @@ class MessageSendBlock: public Block {
 		std::vector< Token * > _RPNrate;
 	public:
 		MessageSendBlock( Token *, std::string, std::vector<std::string>, std::vector<std::string> );
+		MessageSendBlock(){}
+		void writeState( ModelWriter & ) const;
+		void readState( ModelReader & );
+		void visitExpressions( ExpressionVisitor );
 		MessageSendBlock( const MessageSendBlock &mb ) : Block(mb){
 
 			_handshake = mb.isHandshake();
@@ -174,6 +237,10 @@ class ProcessBlock: public Block {
 		Token *_underlyingToken;
 	public:
 		ProcessBlock( Token *, std::string, std::vector<std::string>, std::vector<std::string> );
+		ProcessBlock(){}
+		void writeState( ModelWriter & ) const;
+		void readState( ModelReader & );
+		void visitExpressions( ExpressionVisitor );
 		ProcessBlock( const ProcessBlock &pb ) : Block(pb) {
 
 			_processName = pb.getProcessName();
@@ -195,6 +262,24 @@ class ProcessDefinition{
 		std::vector< std::string > parameters;
 };
 
+class ObservableDefinition{
+//counts live instances of a process, optionally only those whose parameter values satisfy a condition
+
+	public:
+		std::string name, processName;
+		std::vector< std::string > bindingNames; //bound to the process's parameter values in order
+		std::vector< Token * > RPNcondition; //empty if every instance of the process is counted
+};
+
+class StopCondition{
+//a simulation stops as soon as this condition holds
+
+	public:
+		std::vector< Token * > RPNcondition;
+		std::vector< unsigned int > observables; //indices of the declared observables used in the condition
+		std::vector< std::string > actionNames; //actions whose firing counts are used in the condition
+};
+
 class SystemProcess;
 class Candidate;
 
@@ -268,6 +353,9 @@ class Candidate{
 		std::vector< int > sendReceiveParameters;
 		std::vector< std::vector< int > > receiveBounds_lb;
 		std::vector< std::vector< int > > receiveBounds_ub;
+		std::vector< IntervalSet > receiveSets; //for handshake receives, the values each parameter can take
+		std::exception_ptr receiveSetError; //for handshake receives, the error from working out receiveSets[receiveSetErrorAt], raised when a send is checked against it
+		unsigned int receiveSetErrorAt = 0;
 		std::list< SystemProcess > parallelProcesses;
 		std::vector< std::string > beaconChannelName;
 		Candidate( Block *b, ParameterValues pv, std::map< std::string, Numerical > lv, SystemProcess *si, std::list< SystemProcess > pp ){
@@ -298,7 +386,11 @@ class Candidate{
 
 
 /*function prototypes */
-std::pair< std::map< std::string, ProcessDefinition >, std::list< SystemProcess > > secondPassParse( std::vector< Tree<Token> >, std::vector< Token* >, GlobalVariables & );
-void printBlockTree( Tree<Block>, Block * );
+std::pair< std::map< std::string, ProcessDefinition >, std::list< SystemProcess > > secondPassParse( std::vector< Tree<Token> > &, std::vector< SystemLineTerm > &, GlobalVariables & );
+unsigned int numberBlocks( std::map< std::string, ProcessDefinition > & );
+void secondParseSystemLine( std::vector< SystemLineTerm > &, std::list< SystemProcess > &, std::map< std::string, ProcessDefinition > &, GlobalVariables & );
+std::vector< ObservableDefinition > parseObservables( std::vector< std::vector< Token * > > &, std::map< std::string, ProcessDefinition > &, GlobalVariables & );
+std::vector< StopCondition > parseStopConditions( std::vector< std::vector< Token * > > &, std::vector< ObservableDefinition > &, std::map< std::string, ProcessDefinition > &, GlobalVariables & );
+void printBlockTree( Tree<Block> &, Block * );
 
 #endif
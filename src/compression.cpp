@@ -0,0 +1,217 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+//LZ4-style block codec so that compressed output doesn't need any third party libraries.
+//Each block is self-contained (no dictionary is shared between blocks) so a reader can
+//decompress blocks in any order or in parallel.
+
+#include <cstring>
+#include <vector>
+#include "compression.h"
+#include "error_handling.h"
+
+#define MIN_MATCH 4
+#define LAST_LITERALS 5 //the last bytes of a block are always literals
+#define MATCH_LIMIT 12 //no match may start this close to the end of a block
+#define MAX_OFFSET 65535
+#define HASH_LOG 16
+
+
+static inline uint32_t read32( const char *p ){
+
+	uint32_t v;
+	memcpy( &v, p, sizeof(v) );
+	return v;
+}
+
+
+static inline unsigned int hashSequence( uint32_t sequence ){
+
+	return ( sequence * 2654435761U ) >> ( 32 - HASH_LOG );
+}
+
+
+static void writeLength( std::string &out, size_t length ){
+//lengths that don't fit in a token nibble spill over into 255-valued bytes
+
+	while ( length >= 255 ){
+
+		out.push_back( (char) 255 );
+		length -= 255;
+	}
+	out.push_back( (char) length );
+}
+
+
+static void writeSequence( std::string &out, const char *literals, size_t literalLength, size_t offset, size_t matchLength ){
+//a sequence is a token, the literals, then (unless this is the last sequence) a two byte offset and the match length
+
+	unsigned char token = ( literalLength >= 15 ? 15 : literalLength ) << 4;
+	if ( offset > 0 ) token |= ( matchLength - MIN_MATCH >= 15 ? 15 : matchLength - MIN_MATCH );
+	out.push_back( (char) token );
+
+	if ( literalLength >= 15 ) writeLength( out, literalLength - 15 );
+	out.append( literals, literalLength );
+
+	if ( offset > 0 ){
+
+		out.push_back( (char) (offset & 0xFF) );
+		out.push_back( (char) (offset >> 8) );
+		if ( matchLength - MIN_MATCH >= 15 ) writeLength( out, matchLength - MIN_MATCH - 15 );
+	}
+}
+
+
+void lz4CompressBlock( const char *in, size_t n, std::string &out ){
+//greedy single-pass compressor with a hash table of the last position each 4-byte sequence was seen
+
+	std::vector< int64_t > lastSeen( 1 << HASH_LOG, -1 );
+	size_t anchor = 0, i = 0;
+
+	if ( n > MATCH_LIMIT ){
+
+		size_t matchLimit = n - MATCH_LIMIT;
+		while ( i < matchLimit ){
+
+			uint32_t sequence = read32( in + i );
+			unsigned int h = hashSequence( sequence );
+			int64_t candidate = lastSeen[h];
+			lastSeen[h] = i;
+
+			if ( candidate < 0 or (int64_t) i - candidate > MAX_OFFSET or read32( in + candidate ) != sequence ){
+
+				i++;
+				continue;
+			}
+
+			//extend the match as far as we can while leaving the trailing literals
+			size_t matchLength = MIN_MATCH;
+			while ( i + matchLength < n - LAST_LITERALS and in[candidate + matchLength] == in[i + matchLength] ) matchLength++;
+
+			writeSequence( out, in + anchor, i - anchor, i - candidate, matchLength );
+			i += matchLength;
+			anchor = i;
+		}
+	}
+
+	//whatever is left over goes out as literals
+	writeSequence( out, in + anchor, n - anchor, 0, 0 );
+}
+
+
+void lz4DecompressBlock( const char *in, size_t n, size_t rawSize, std::string &out ){
+
+	size_t start = out.size();
+	size_t i = 0;
+	out.reserve( start + rawSize );
+
+	while ( i < n ){
+
+		unsigned char token = in[i++];
+
+		//literals
+		size_t literalLength = token >> 4;
+		if ( literalLength == 15 ){
+
+			unsigned char b;
+			do{
+				if ( i >= n ) throw BadTrajectoryFile();
+				b = in[i++];
+				literalLength += b;
+			} while ( b == 255 );
+		}
+		if ( i + literalLength > n ) throw BadTrajectoryFile();
+		out.append( in + i, literalLength );
+		i += literalLength;
+
+		if ( i == n ) break; //last sequence has no match
+
+		//match
+		if ( i + 2 > n ) throw BadTrajectoryFile();
+		size_t offset = (unsigned char) in[i] | ( ((unsigned char) in[i+1]) << 8 );
+		i += 2;
+		size_t matchLength = (token & 0x0F);
+		if ( matchLength == 15 ){
+
+			unsigned char b;
+			do{
+				if ( i >= n ) throw BadTrajectoryFile();
+				b = in[i++];
+				matchLength += b;
+			} while ( b == 255 );
+		}
+		matchLength += MIN_MATCH;
+
+		if ( offset == 0 or offset > out.size() - start ) throw BadTrajectoryFile();
+
+		//matches can overlap the bytes they produce, so copy byte by byte
+		size_t from = out.size() - offset;
+		for ( size_t j = 0; j < matchLength; j++ ) out.push_back( out[from + j] );
+	}
+
+	if ( out.size() - start != rawSize ) throw BadTrajectoryFile();
+}
+
+
+/*FRAMING------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+static void write32( std::string &out, uint32_t v ){
+
+	for ( unsigned int i = 0; i < 4; i++ ) out.push_back( (char) ((v >> (8*i)) & 0xFF) );
+}
+
+
+static uint32_t readLE32( const std::string &in, size_t pos ){
+
+	uint32_t v = 0;
+	for ( unsigned int i = 0; i < 4; i++ ) v |= ( (uint32_t) (unsigned char) in[pos + i] ) << (8*i);
+	return v;
+}
+
+
+void writeCompressedHeader( std::string &out ){
+
+	out += COMPRESSED_MAGIC;
+	out.push_back( (char) COMPRESSED_FORMAT_VERSION );
+}
+
+
+void appendCompressedBlock( std::string &out, const char *in, size_t n ){
+//block layout: uncompressed size, stored size, then the stored bytes
+//if compression doesn't help, the block is stored as-is and the two sizes are equal
+
+	std::string compressed;
+	lz4CompressBlock( in, n, compressed );
+
+	write32( out, n );
+	if ( compressed.size() < n ){
+
+		write32( out, compressed.size() );
+		out += compressed;
+	}
+	else{
+
+		write32( out, n );
+		out.append( in, n );
+	}
+}
+
+
+bool readCompressedBlock( const std::string &in, size_t &pos, std::string &out ){
+//appends the decompressed contents of the block at pos to out; returns false if the block isn't all in the buffer yet
+
+	if ( pos + 8 > in.size() ) return false;
+	uint32_t rawSize = readLE32( in, pos );
+	uint32_t storedSize = readLE32( in, pos + 4 );
+	if ( pos + 8 + storedSize > in.size() ) return false;
+
+	if ( storedSize == rawSize ) out.append( in, pos + 8, storedSize );
+	else lz4DecompressBlock( in.data() + pos + 8, storedSize, rawSize, out );
+
+	pos += 8 + storedSize;
+	return true;
+}
@@ -0,0 +1,26 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+#include <cstdint>
+
+#define COMPRESSED_MAGIC "BCSZ"
+#define COMPRESSED_FORMAT_VERSION 1
+#define COMPRESSION_BLOCK_SIZE (1 << 20) //target uncompressed size of each independently decompressible block
+
+/*function prototypes */
+void lz4CompressBlock( const char *, size_t, std::string & );
+void lz4DecompressBlock( const char *, size_t, size_t, std::string & );
+void writeCompressedHeader( std::string & );
+void appendCompressedBlock( std::string &, const char *, size_t );
+bool readCompressedBlock( const std::string &, size_t &, std::string & );
+
+#endif
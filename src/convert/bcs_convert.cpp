@@ -0,0 +1,101 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include "../output.h"
+#include "../error_handling.h"
+#include "../common.h"
+
+
+static const char *convert_help=
+"bcs-convert converts binary and/or compressed bcs simulation output back into the text format.\n"
+"To run bcs-convert, do:\n"
+"  ./bcs-convert [arguments] simulationOutput.simulation.bcs\n"
+"Optional arguments are:\n"
+"  -o,--output               output file name (default: stdout),\n"
+"  -h,--help                 show useage information,\n"
+"  -v,--version              show version.\n";
+
+
+struct Arguments {
+
+	std::string targetFilename;
+	std::string outputFilename;
+};
+
+
+Arguments parseConvertArguments( int argc, char** argv ){
+
+	if( argc < 2 ){
+
+		std::cout << "Exiting with error.  No simulation output file specified." << std::endl << convert_help;
+		exit(EXIT_FAILURE);
+	}
+
+	Arguments args;
+
+	/*parse the command line arguments */
+	for ( int i = 1; i < argc; ){
+
+		std::string flag( argv[ i ] );
+
+		if ( flag == "-o" or flag == "--output" ){
+
+			std::string strArg( argv[ i + 1 ] );
+			args.outputFilename = strArg;
+			i+=2;	
+		}
+		else if ( flag == "-h" or flag == "--help" ){
+
+			std::cout << convert_help;
+			exit(EXIT_SUCCESS);
+		}
+		else if ( flag == "-v" or flag == "--version" ){
+
+			std::cout << "Version: " << VERSION << std::endl;
+			exit(EXIT_SUCCESS);
+		}
+		else{
+
+			if ( flag.substr(0,1) == "-" ){
+
+				std::cout << "Exiting with error.  Unknown flag specified." << std::endl << convert_help;
+				exit(EXIT_FAILURE);
+			}
+
+			args.targetFilename = flag;
+			i+=1;
+		}
+	}
+
+	return args;
+}
+
+
+int main( int argc, char** argv ){
+
+	Arguments args = parseConvertArguments( argc, argv );
+
+	std::ifstream inFile( args.targetFilename, std::ios::binary );
+	if ( not inFile.is_open() ) throw BadSourcePath();
+
+	if ( args.outputFilename.empty() ){
+
+		convertTrajectory( inFile, std::cout );
+	}
+	else{
+
+		std::ofstream outFile( args.outputFilename );
+		if ( not outFile.is_open() ) throw BadOutputPath();
+		convertTrajectory( inFile, outFile );
+	}
+
+	return 0;
+}
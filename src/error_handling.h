@@ -12,6 +12,7 @@
 #include <exception>
 #include <string.h>
 #include <string> 
+#include "lexer.h"
 
 struct BadSourcePath : public std::exception {
 	const char * what () const throw () {
@@ -212,4 +213,54 @@ struct SystemLineMissing : public std::exception {
 	}
 };
 
+struct BadTrajectoryFile : public std::exception {
+	const char * what () const throw () {
+		return "Trajectory file is not a valid or complete bcs binary output.";
+	}
+};
+
+struct BadSweep : public std::exception {
+	std::string specifics;
+	BadSweep( std::string s ){
+
+		specifics = "Bad parameter sweep: " + s;
+	}
+	const char * what () const throw () {
+		return specifics.c_str();
+	}
+};
+
+struct BadInference : public std::exception {
+	std::string specifics;
+	BadInference( std::string s ){
+
+		specifics = "Bad ABC inference: " + s;
+	}
+	const char * what () const throw () {
+		return specifics.c_str();
+	}
+};
+
+struct BadModelFile : public std::exception {
+	std::string specifics;
+	BadModelFile( std::string s ){
+
+		specifics = "Could not read compiled model: " + s;
+	}
+	const char * what () const throw () {
+		return specifics.c_str();
+	}
+};
+
+struct BadCheckpoint : public std::exception {
+	std::string specifics;
+	BadCheckpoint( std::string s ){
+
+		specifics = "Could not resume from checkpoint: " + s;
+	}
+	const char * what () const throw () {
+		return specifics.c_str();
+	}
+};
+
 #endif
@@ -11,6 +11,7 @@
 //#define DEBUG_SETS 1
 
 #include "evaluate_trees.h"
+#include "kernels.h"
 #include <cmath>
 #include <stack>
 #include <math.h>
@@ -485,7 +486,11 @@ bool variableIsDefined( Token *t, ParameterValues &param2value, GlobalVariables
 }
 
 
-Numerical evalRPN_numerical( std::vector< Token * > inputRPN, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables){
+Numerical evalRPN_numerical( const std::vector< Token * > &inputRPN, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables){
+
+	//use native code for this expression if it was linked in with bcs --emit-cpp
+	const ExpressionKernel *kernel = findKernel( inputRPN );
+	if ( kernel and kernel -> numerical ) return kernel -> numerical( inputRPN, param2value, globalVariables, localVariables );
 
 	//quick exit for simple cases
 	if (inputRPN.size() == 1){
@@ -618,7 +623,18 @@ Numerical evalRPN_numerical( std::vector< Token * > inputRPN, ParameterValues &p
 }
 
 
-bool evalRPN_condition( std::vector< Token * > inputRPN, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables){
+Numerical evalRate( Block *b, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables){
+//rates that foldConstants reduced to a single value are used as they are
+
+	if ( b -> hasConstantRate() ) return b -> getConstantRate();
+	return evalRPN_numerical( b -> getRate(), param2value, globalVariables, localVariables );
+}
+
+
+bool evalRPN_condition( const std::vector< Token * > &inputRPN, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables){
+
+	const ExpressionKernel *kernel = findKernel( inputRPN );
+	if ( kernel and kernel -> condition ) return kernel -> condition( inputRPN, param2value, globalVariables, localVariables );
 
 	std::stack<RPNoperand *> evalStack;	
 
@@ -828,182 +844,52 @@ bool evalRPN_condition( std::vector< Token * > inputRPN, ParameterValues &param2
 }
 
 
-std::vector< std::pair< int, int > > unionBounds( std::pair<int, int> B1, std::pair<int, int> B2 ){
+struct SetStackValue{
+//an operand while a set expression is evaluated - intermediates are kept by value on the stack rather than allocated one by one
 
-	if ( B2.first <= B1.second and B1.second <= B2.second){
+	bool isSet;
+	Numerical number;
+	IntervalSet set;
+	std::string identify( void ) const { return isSet ? "Set" : "Numerical"; }
+};
 
-		if ( B2.first <= B1.first and B1.first <= B2.second ) return {B2};
-		else return {std::make_pair(B1.first, B2.second)};
-	}
-	else if ( B1.first <= B2.second and B2.second <= B1.second){
 
-		if ( B1.first <= B2.first and B2.first <= B1.second ) return {B1};
-		else return {std::make_pair(B2.first, B1.second)};
-	}
-	else if ( B1.second + 1 == B2.first ) return {std::make_pair(B1.first, B2.second)};
-	else if ( B2.second + 1 == B1.first ) return {std::make_pair(B2.first, B1.second)};
-	else return {B1,B2};
-}
-
-
-std::vector< std::pair< int, int > > condenseToDisjoint( std::vector< std::pair<int, int> > S1 ){
-
-#if DEBUG_SETS
-std::cout << "Condensing to disjoint..." << std::endl;
-std::cout << "Before condensing:" << std::endl;
-for ( auto p = S1.begin(); p < S1.end(); p++ ) std::cout << p -> first << " " << p -> second << std::endl;
-#endif
-
-	bool condensed;
-	std::vector< std::pair< int, int > > out;
-
-	if (S1.size() == 0) return out;
-
-	do{
-		condensed = false;
-		out.clear();
-		for (unsigned int i = 0; i < S1.size() - 1; i++){
-
-			for (unsigned int j = i+1; j < S1.size(); j++){
-
-				std::vector< std::pair< int, int > > u = unionBounds( S1[i], S1[j] );
-
-				if (u.size() == 1){
-					
-					if ( std::find(out.begin(),out.end(),u[0]) == out.end() ) out.push_back(u[0]);
-					condensed = true;
-				}
-				else{
-
-					if ( std::find(out.begin(),out.end(),u[0]) == out.end() ) out.push_back(u[0]);
-					if ( std::find(out.begin(),out.end(),u[0]) == out.end() ) out.push_back(u[1]);
-				}
-			}
-		}
-		if (condensed) S1 = out;
+static void popOperands( std::vector< SetStackValue > &evalStack, Token *t, SetStackValue &operand1, SetStackValue &operand2 ){
 
-	} while(condensed);
-
-#if DEBUG_SETS
-std::cout << "After condensing:" << std::endl;
-for ( auto p = S1.begin(); p < S1.end(); p++ ) std::cout << p -> first << " " << p -> second << std::endl;
-#endif
-
-	return S1;
+	if ( evalStack.size() <= 1 ) throw SyntaxError(t, "Insufficient arguments.");
+	operand2 = evalStack.back();
+	evalStack.pop_back();
+	operand1 = evalStack.back();
+	evalStack.pop_back();
 }
 
 
-std::vector< std::pair< int, int > > intersectBounds( std::pair<int, int> B1, std::pair<int, int> B2 ){
-
-#if DEBUG_SETS
-std::cout << "Intersect bounds..." << std::endl;
-#endif
-
-	if ( B2.first <= B1.second and B1.second <= B2.second){
-
-		if ( B2.first <= B1.first and B1.first <= B2.second ) return {B1};
-		else return {std::make_pair(B2.first, B1.second)};
-	}
-	else if ( B1.first <= B2.second and B2.second <= B1.second){
+static int setInt( Token *t, Numerical n ){
+//ints are the only numbers that can appear in a set expression
 
-		if ( B1.first <= B2.first and B2.first <= B1.second ) return {B2};
-		else return {std::make_pair(B1.first, B2.second)};
-	}
-	else return {};
+	if (n.isDouble()) throw WrongType(t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
+	return n.getInt();
 }
 
 
-std::vector< std::pair<int, int> > setIntersection( std::vector< std::pair<int, int> > S1, std::vector< std::pair<int, int> > S2 ){
-
-#if DEBUG_SETS
-std::cout << "Set intersection..." << std::endl;
-#endif
-
-	std::vector< std::pair< int, int > > out;
-	
-	for ( unsigned int i = 0; i < S1.size(); i++ ){
-
-		for ( unsigned int j = 0; j < S2.size(); j++ ){
-
-			std::vector< std::pair< int, int > > intersection = intersectBounds( S1[i], S2[j] );
-			out.insert(out.end(), intersection.begin(), intersection.end());
-		}
-	}
+static IntervalSet asSet( Token *t, SetStackValue &operand ){
 
-	//merge bounds so that they're disjoint
-	return condenseToDisjoint(out);
+	if ( operand.isSet ) return operand.set;
+	int i = setInt( t, operand.number );
+	return IntervalSet( i, i );
 }
 
 
-std::vector< std::pair< int, int > > differenceBounds( std::pair<int, int> B1, std::pair<int, int> B2 ){
-
-#if DEBUG_SETS
-std::cout << "Difference bounds..." << std::endl;
-std::cout << "B1:" << std::endl;
-std::cout << B1.first << " " << B1.second << std::endl;
-std::cout << "B2:" << std::endl;
-std::cout << B2.first << " " << B2.second << std::endl;
-#endif
-
-	if ( B2.first == B1.second and B1.second == B2.second) return {};
-	else if ( B2.first <= B1.second and B1.second <= B2.second){
-
-		if ( B2.first <= B1.first and B1.first <= B2.second ) return {};
-		else return {std::make_pair(B1.first, B2.first-1)};
-	}
-	else if ( B1.first <= B2.second and B2.second <= B1.second){
-
-		if ( B1.first < B2.first and B2.first < B1.second ){ //fully contained
-
-			return {std::make_pair(B1.first, B2.first-1), std::make_pair(B2.second+1, B1.second)};
-		}
-		else if ( B1.first < B2.first and B2.first == B1.second ){ //right side aligns
-
-			return {std::make_pair(B1.first, B2.first-1)};
-		}
-		else if ( B1.first == B2.first and B2.first < B1.second ){ //left side aligns
-
-			return {std::make_pair(B2.second+1, B1.second)};
-		}
-		else return {std::make_pair(B2.second+1, B1.second)};
-	}
-	else return {B1};
-}
-
-
-std::vector< std::pair<int, int> > setDifference( std::vector< std::pair<int, int> > S1, std::vector< std::pair<int, int> > S2 ){
-
-#if DEBUG_SETS
-std::cout << "Set difference..." << std::endl;
-#endif
-
-	std::vector< std::pair< int, int > > out;
-	
-	for ( unsigned int i = 0; i < S1.size(); i++ ){
-
-		for ( unsigned int j = 0; j < S2.size(); j++ ){
-
-			std::vector< std::pair< int, int > > difference = differenceBounds( S1[i], S2[j] );
-			out.insert(out.end(), difference.begin(), difference.end());
-		}
-	}
-
-	//merge bounds so that they're disjoint
-	return condenseToDisjoint(out);
-}
-
-
-std::vector< std::pair<int, int> > evalRPN_set( std::vector< Token * > &inputRPN, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables){
+IntervalSet evalRPN_set( std::vector< Token * > &inputRPN, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables){
 
 #if DEBUG_SETS
 std::cout << "Expression is: ";
 for (auto test = inputRPN.begin(); test < inputRPN.end(); test++) std::cout << (*test) -> value();
 std::cout << std::endl;
-//std::cout << "Parameters are:" << std::endl;
-//param2value.printValues();
 #endif
 
-	std::stack<RPNoperand *> evalStack;
+	std::vector< SetStackValue > evalStack;
+	SetStackValue operand1, operand2;
 
 	for ( auto t = inputRPN.begin(); t < inputRPN.end(); t++ ){
 
@@ -1012,173 +898,63 @@ std::cout << std::endl;
 			if ( (*t) -> value() == "abs" or (*t) -> value() == "sqrt" or (*t) ->value() == "neg" ){ //unary
 
 				if ( evalStack.size() < 1 ) throw SyntaxError(*t, "Insufficient arguments.");
-				RPNoperand *operand = evalStack.top();
-				evalStack.pop();
-				if (operand -> identify() != "Numerical") throw WrongType(*t,operand -> identify());
-				NumericalOperand *numptr = static_cast<NumericalOperand *>(operand);
-				Numerical op_n = numptr -> getValue();
-				if (op_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-
-				Numerical result;
-				if ( (*t) -> value() == "abs" ){
-
-					if (op_n.isInt()) result.setInt(std::abs(op_n.getInt()));
-					else result.setDouble(std::abs(op_n.getDouble()));
-				}
-				else if ( (*t) -> value() == "sqrt" ){
-
-					if (op_n.isInt()) result.setInt(sqrt(op_n.getInt()));
-					else result.setDouble(sqrt(op_n.getDouble()));
-				}
-				else if ( (*t) -> value() == "neg" ){
-
-					if (op_n.isInt()) result.setInt(-op_n.getInt());
-					else result.setDouble(-op_n.getDouble());
-				}
-				else throw SyntaxError(*t, "Unrecognised operator for function evaluation.");
+				SetStackValue &operand = evalStack.back();
+				if ( operand.isSet ) throw WrongType(*t,operand.identify());
+				setInt( *t, operand.number );
 
-				evalStack.push( new NumericalOperand(result) );
-				delete operand;
+				if ( (*t) -> value() == "abs" ) operand.number = kAbs( operand.number );
+				else if ( (*t) -> value() == "sqrt" ) operand.number = kSqrt( operand.number );
+				else operand.number = kNegate( operand.number );
 			}
 			else if ( (*t) -> value() == "min" or (*t) -> value() == "max" or (*t) -> value() == "+" or (*t) -> value() == "-" or (*t) -> value() == "*" or (*t) -> value() == "/" or (*t) -> value() == "^"){
 
 				//get the operands and make sure they're of correct type for the operator
-				if ( evalStack.size() <= 1 ) throw SyntaxError(*t, "Insufficient arguments.");
-				RPNoperand *operand2 = evalStack.top();
-				evalStack.pop();
-				RPNoperand *operand1 = evalStack.top();
-				evalStack.pop();
-				if (operand1 -> identify() != "Numerical") throw WrongType(*t,operand1 -> identify());
-				if (operand2 -> identify() != "Numerical") throw WrongType(*t,operand2 -> identify());
-				Numerical op1_n,op2_n;
-				NumericalOperand *numptr = static_cast<NumericalOperand *>(operand1);
-				op1_n = numptr -> getValue();
-				numptr = static_cast<NumericalOperand *>(operand2);
-				op2_n = numptr -> getValue();
-				if (op1_n.isDouble() or op2_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-
-				//upcast
-				bool upcast = false;
-				if (op1_n.isDouble() or op2_n.isDouble()) upcast = true;
-
-				Numerical result;
-				if ( (*t) -> value() == "+" ){
-
-					if (upcast) result.setDouble( op1_n.doubleCast() + op2_n.doubleCast() );
-					else result.setInt( op1_n.getInt() + op2_n.getInt() );
-				}
-				else if ( (*t) -> value() == "-" ){
-
-					if (upcast) result.setDouble( op1_n.doubleCast() - op2_n.doubleCast() );
-					else result.setInt( op1_n.getInt() - op2_n.getInt() );
-				}
-				else if ( (*t) -> value() == "/" ){
-
-					if (upcast) result.setDouble( op1_n.doubleCast() / op2_n.doubleCast() );
-					else result.setInt( op1_n.getInt() / op2_n.getInt() );
-				}
-				else if ( (*t) -> value() == "*" ){
-					if (upcast) result.setDouble( op1_n.doubleCast() * op2_n.doubleCast() );
-					else result.setInt( op1_n.getInt() * op2_n.getInt() );
-				}
-				else if ( (*t) -> value() == "^" ){
-
-					if (upcast) result.setDouble( pow(op1_n.doubleCast(), op2_n.doubleCast()) );
-					else result.setInt( pow(op1_n.getInt(), op2_n.getInt()) );
-				}
-				else if ( (*t) -> value() == "min" ){
-
-					if (upcast) result.setDouble( std::min(op1_n.doubleCast(), op2_n.doubleCast()) );
-					else result.setInt( std::min(op1_n.getInt(), op2_n.getInt()) );
-				}
-				else if ( (*t) -> value() == "max" ){
-
-					if (upcast) result.setDouble( std::max(op1_n.doubleCast(), op2_n.doubleCast()) );
-					else result.setInt( std::max(op1_n.getInt(), op2_n.getInt()) );
-				}
-				else throw SyntaxError(*t, "Unrecognised operator for arithmetic evaluation.");
-
-				evalStack.push( new NumericalOperand(result) );
-				delete operand1; delete operand2;
+				popOperands( evalStack, *t, operand1, operand2 );
+				if (operand1.isSet) throw WrongType(*t,operand1.identify());
+				if (operand2.isSet) throw WrongType(*t,operand2.identify());
+				setInt( *t, operand1.number );
+				setInt( *t, operand2.number );
+
+				SetStackValue result;
+				result.isSet = false;
+				if ( (*t) -> value() == "+" ) result.number = kAdd( operand1.number, operand2.number );
+				else if ( (*t) -> value() == "-" ) result.number = kSubtract( operand1.number, operand2.number );
+				else if ( (*t) -> value() == "/" ) result.number = kDivide( operand1.number, operand2.number );
+				else if ( (*t) -> value() == "*" ) result.number = kMultiply( operand1.number, operand2.number );
+				else if ( (*t) -> value() == "^" ) result.number = kPower( operand1.number, operand2.number );
+				else if ( (*t) -> value() == "min" ) result.number = kMin( operand1.number, operand2.number );
+				else result.number = kMax( operand1.number, operand2.number );
+				evalStack.push_back( result );
 			}
 			else if ( (*t) -> value() == ".." ){
 
 				//get the operands and make sure they're of correct type for the operator
-				if ( evalStack.size() <= 1 ) throw SyntaxError(*t, "Insufficient arguments.");
-				RPNoperand *operand2 = evalStack.top();
-				evalStack.pop();
-				RPNoperand *operand1 = evalStack.top();
-				evalStack.pop();
-				if (operand1 -> identify() != "Numerical") throw WrongType(*t,operand1 -> identify());
-				if (operand2 -> identify() != "Numerical") throw WrongType(*t,operand2 -> identify());
-				Numerical op1_n,op2_n;
-				NumericalOperand *numptr = static_cast<NumericalOperand *>(operand1);
-				op1_n = numptr -> getValue();
-				numptr = static_cast<NumericalOperand *>(operand2);
-				op2_n = numptr -> getValue();
-				if (op1_n.isDouble() or op2_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-
-				if (op1_n.getInt() > op2_n.getInt() ) throw SyntaxError(*t,"Thrown by expression evaluation (sets).  Range upper bound must be greater than or equal to range lower bound.");
-
-				evalStack.push( new SetOperand({std::make_pair(op1_n.getInt(), op2_n.getInt())}) );
-				delete operand1; delete operand2;
+				popOperands( evalStack, *t, operand1, operand2 );
+				if (operand1.isSet) throw WrongType(*t,operand1.identify());
+				if (operand2.isSet) throw WrongType(*t,operand2.identify());
+				int lb = setInt( *t, operand1.number );
+				int ub = setInt( *t, operand2.number );
+
+				if (lb > ub ) throw SyntaxError(*t,"Thrown by expression evaluation (sets).  Range upper bound must be greater than or equal to range lower bound.");
+
+				SetStackValue result;
+				result.isSet = true;
+				result.set = IntervalSet( lb, ub );
+				evalStack.push_back( result );
 			}
 			else if ( (*t) -> value() == "U" or (*t) -> value() == "I" or (*t) -> value() == "\\" ){
 
-				//get the operands and make sure they're of correct type for the operator
-				if ( evalStack.size() <= 1 ) throw SyntaxError(*t, "Insufficient arguments.");
-				RPNoperand *operand2 = evalStack.top();
-				evalStack.pop();
-				RPNoperand *operand1 = evalStack.top();
-				evalStack.pop();
-				if (operand1 -> identify() != "Numerical" and operand1 -> identify() != "Set") throw WrongType(*t,operand1 -> identify());
-				if (operand2 -> identify() != "Numerical" and operand2 -> identify() != "Set") throw WrongType(*t,operand2 -> identify());
-				std::vector<std::pair<int, int>> op1_s, op2_s;
-				
 				//get everything in set format
-				if (operand1 -> identify() == "Numerical"){
-
-					NumericalOperand *numptr = static_cast<NumericalOperand *>(operand1);
-					Numerical op1_n = numptr -> getValue();
-					if (op1_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-					op1_s = {std::make_pair(op1_n.getInt(), op1_n.getInt())};
-				}
-				else{
-
-					SetOperand *setptr = static_cast<SetOperand *>(operand1);
-					op1_s = setptr -> getValue();
-				}
-
-				if (operand2 -> identify() == "Numerical"){
-
-					NumericalOperand *numptr = static_cast<NumericalOperand *>(operand2);
-					Numerical op2_n = numptr -> getValue();
-					if (op2_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-					op2_s = {std::make_pair(op2_n.getInt(), op2_n.getInt())};
-				}
-				else{
-
-					SetOperand *setptr = static_cast<SetOperand *>(operand2);
-					op2_s = setptr -> getValue();
-				}
-
-				std::vector<std::pair<int, int>> result;
-				if ( (*t) -> value() == "U" ){
-					op1_s.insert(op1_s.end(), op2_s.begin(), op2_s.end() );
-					result = condenseToDisjoint( op1_s );
-				}
-				else if ( (*t) -> value() == "I" ){
-
-					result = setIntersection( op1_s, op2_s );
-				}
-				else if ( (*t) -> value() == "\\" ){
-
-					result = setDifference( op1_s, op2_s );
-				}
-				else throw SyntaxError(*t, "Unrecognised operator for set evaluation.");
-
-				evalStack.push( new SetOperand(result) );
-				delete operand1; delete operand2;
+				popOperands( evalStack, *t, operand1, operand2 );
+				IntervalSet op1_s = asSet( *t, operand1 );
+				IntervalSet op2_s = asSet( *t, operand2 );
+
+				SetStackValue result;
+				result.isSet = true;
+				if ( (*t) -> value() == "U" ) result.set = op1_s.unite( op2_s );
+				else if ( (*t) -> value() == "I" ) result.set = op1_s.intersect( op2_s );
+				else result.set = op1_s.subtract( op2_s );
+				evalStack.push_back( result );
 			}
 		}
 		else if ( isOperand(*t) ){
@@ -1189,267 +965,22 @@ std::cout << std::endl;
 				throw WrongType(*t, "Operands must be doubles, ints, or variables.");
 			}			
 
-			Numerical result = substituteVariable( *t, param2value, globalVariables, localVariables );
-			evalStack.push( new NumericalOperand(result) );
+			SetStackValue operand;
+			operand.isSet = false;
+			operand.number = substituteVariable( *t, param2value, globalVariables, localVariables );
+			evalStack.push_back( operand );
 		}
 	}
 
-	if ( evalStack.top() -> identify() != "Set" and evalStack.top() -> identify() != "Numerical" ) throw SyntaxError( inputRPN[0], "Message receive expression must evaluate to a bool or an int" );
-
-	std::vector<std::pair<int, int>> result;
-	if ( evalStack.top() -> identify() == "Numerical" ){
-
-		NumericalOperand *numptr = static_cast<NumericalOperand *>(evalStack.top());
-		Numerical op1_n = numptr -> getValue();
-		if (op1_n.isDouble()) throw WrongType(inputRPN[0], "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-		result = {std::make_pair(op1_n.getInt(), op1_n.getInt())};
-	}
-	else{
-
-		SetOperand *setptr = static_cast<SetOperand *>(evalStack.top());
-		result = setptr -> getValue();
-	}
-	delete evalStack.top();
+	if ( evalStack.empty() ) throw SyntaxError( inputRPN[0], "Message receive expression must evaluate to a bool or an int" );
+	IntervalSet result = asSet( inputRPN[0], evalStack.back() );
 
 #if DEBUG_SETS
 std::cout << "Set is: " << std::endl;
-for ( auto itr = result.begin(); itr < result.end(); itr++ ){
+for ( size_t i = 0; i < result.size(); i++ ){
 
-	std::cout << itr -> first << " " << itr -> second << std::endl;
+	std::cout << result[i].first << " " << result[i].second << std::endl;
 }
 #endif
 	return result;
 }
-
-
-bool evalRPN_setTest( int &toTest, std::vector< Token * > &inputRPN, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables){
-
-#if DEBUG_SETS
-std::cout << "Testing: " << toTest << std::endl;
-std::cout << "Expression is: ";
-for (auto test = inputRPN.begin(); test < inputRPN.end(); test++) std::cout << (*test) -> value();
-std::cout << std::endl;
-//std::cout << "Parameters are:" << std::endl;
-//param2value.printValues();
-#endif
-
-	std::stack<RPNoperand *> evalStack;
-
-	for ( auto t = inputRPN.begin(); t < inputRPN.end(); t++ ){
-
-		if ( isOperator(*t) or (*t) -> identify() == "Function"){
-
-			if ( (*t) -> value() == "abs" or (*t) -> value() == "sqrt" or (*t) ->value() == "neg" ){ //unary
-
-				if ( evalStack.size() < 1 ) throw SyntaxError(*t, "Insufficient arguments.");
-				RPNoperand *operand = evalStack.top();
-				evalStack.pop();
-				if (operand -> identify() != "Numerical") throw WrongType(*t,operand -> identify());
-				NumericalOperand *numptr = static_cast<NumericalOperand *>(operand);
-				Numerical op_n = numptr -> getValue();
-				if (op_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-
-				Numerical result;
-				if ( (*t) -> value() == "abs" ){
-
-					if (op_n.isInt()) result.setInt(std::abs(op_n.getInt()));
-					else result.setDouble(std::abs(op_n.getDouble()));
-				}
-				else if ( (*t) -> value() == "sqrt" ){
-
-					if (op_n.isInt()) result.setInt(sqrt(op_n.getInt()));
-					else result.setDouble(sqrt(op_n.getDouble()));
-				}
-				else if ( (*t) -> value() == "neg" ){
-
-					if (op_n.isInt()) result.setInt(-op_n.getInt());
-					else result.setDouble(-op_n.getDouble());
-				}
-				else throw SyntaxError(*t, "Unrecognised operator for function evaluation.");
-
-				evalStack.push( new NumericalOperand(result) );
-				delete operand;
-			}
-			else if ( (*t) -> value() == "min" or (*t) -> value() == "max" or (*t) -> value() == "+" or (*t) -> value() == "-" or (*t) -> value() == "*" or (*t) -> value() == "/" or (*t) -> value() == "^"){
-
-				//get the operands and make sure they're of correct type for the operator
-				if ( evalStack.size() <= 1 ) throw SyntaxError(*t, "Insufficient arguments.");
-				RPNoperand *operand2 = evalStack.top();
-				evalStack.pop();
-				RPNoperand *operand1 = evalStack.top();
-				evalStack.pop();
-				if (operand1 -> identify() != "Numerical") throw WrongType(*t,operand1 -> identify());
-				if (operand2 -> identify() != "Numerical") throw WrongType(*t,operand2 -> identify());
-				Numerical op1_n,op2_n;
-				NumericalOperand *numptr = static_cast<NumericalOperand *>(operand1);
-				op1_n = numptr -> getValue();
-				numptr = static_cast<NumericalOperand *>(operand2);
-				op2_n = numptr -> getValue();
-				if (op1_n.isDouble() or op2_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-
-				//upcast
-				bool upcast = false;
-				if (op1_n.isDouble() or op2_n.isDouble()) upcast = true;
-
-				Numerical result;
-				if ( (*t) -> value() == "+" ){
-
-					if (upcast) result.setDouble( op1_n.doubleCast() + op2_n.doubleCast() );
-					else result.setInt( op1_n.getInt() + op2_n.getInt() );
-				}
-				else if ( (*t) -> value() == "-" ){
-
-					if (upcast) result.setDouble( op1_n.doubleCast() - op2_n.doubleCast() );
-					else result.setInt( op1_n.getInt() - op2_n.getInt() );
-				}
-				else if ( (*t) -> value() == "/" ){
-
-					if (upcast) result.setDouble( op1_n.doubleCast() / op2_n.doubleCast() );
-					else result.setInt( op1_n.getInt() / op2_n.getInt() );
-				}
-				else if ( (*t) -> value() == "*" ){
-					if (upcast) result.setDouble( op1_n.doubleCast() * op2_n.doubleCast() );
-					else result.setInt( op1_n.getInt() * op2_n.getInt() );
-				}
-				else if ( (*t) -> value() == "^" ){
-
-					if (upcast) result.setDouble( pow(op1_n.doubleCast(), op2_n.doubleCast()) );
-					else result.setInt( pow(op1_n.getInt(), op2_n.getInt()) );
-				}
-				else if ( (*t) -> value() == "min" ){
-
-					if (upcast) result.setDouble( std::min(op1_n.doubleCast(), op2_n.doubleCast()) );
-					else result.setInt( std::min(op1_n.getInt(), op2_n.getInt()) );
-				}
-				else if ( (*t) -> value() == "max" ){
-
-					if (upcast) result.setDouble( std::max(op1_n.doubleCast(), op2_n.doubleCast()) );
-					else result.setInt( std::max(op1_n.getInt(), op2_n.getInt()) );
-				}
-				else throw SyntaxError(*t, "Unrecognised operator for arithmetic evaluation.");
-
-				evalStack.push( new NumericalOperand(result) );
-				delete operand1; delete operand2;
-			}
-			else if ( (*t) -> value() == ".." ){
-
-				//get the operands and make sure they're of correct type for the operator
-				if ( evalStack.size() <= 1 ) throw SyntaxError(*t, "Insufficient arguments.");
-				RPNoperand *operand2 = evalStack.top();
-				evalStack.pop();
-				RPNoperand *operand1 = evalStack.top();
-				evalStack.pop();
-				if (operand1 -> identify() != "Numerical") throw WrongType(*t,operand1 -> identify());
-				if (operand2 -> identify() != "Numerical") throw WrongType(*t,operand2 -> identify());
-				Numerical op1_n,op2_n;
-				NumericalOperand *numptr = static_cast<NumericalOperand *>(operand1);
-				op1_n = numptr -> getValue();
-				numptr = static_cast<NumericalOperand *>(operand2);
-				op2_n = numptr -> getValue();
-				if (op1_n.isDouble() or op2_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-
-				bool result;
-				if (op1_n.getInt() > op2_n.getInt() ) throw SyntaxError(*t,"Thrown by expression evaluation (sets).  Range upper bound is greater than range lower bound.");
-				if (op1_n.getInt() <= toTest and toTest <= op2_n.getInt()) result = true;
-				else result = false;
-
-				evalStack.push( new BoolOperand(result) );
-				delete operand1; delete operand2;
-			}
-			else if ( (*t) -> value() == "U" or (*t) -> value() == "I" or (*t) -> value() == "\\" ){
-
-				//get the operands and make sure they're of correct type for the operator
-				if ( evalStack.size() <= 1 ) throw SyntaxError(*t, "Insufficient arguments.");
-				RPNoperand *operand2 = evalStack.top();
-				evalStack.pop();
-				RPNoperand *operand1 = evalStack.top();
-				evalStack.pop();
-				if (operand1 -> identify() != "Numerical" and operand1 -> identify() != "Bool") throw WrongType(*t,operand1 -> identify());
-				if (operand2 -> identify() != "Numerical" and operand2 -> identify() != "Bool") throw WrongType(*t,operand2 -> identify());
-				Numerical op1_n,op2_n;
-				NumericalOperand *numptr = static_cast<NumericalOperand *>(operand1);
-				op1_n = numptr -> getValue();
-				numptr = static_cast<NumericalOperand *>(operand2);
-				op2_n = numptr -> getValue();
-				
-				//get everything in bool format
-				bool op1_s;
-				if (operand1 -> identify() == "Numerical"){
-
-					NumericalOperand *numptr = static_cast<NumericalOperand *>(operand1);
-					Numerical op1_n = numptr -> getValue();
-					if (op1_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-					op1_s = op1_n.getInt() == toTest;
-				}
-				else{
-
-					BoolOperand *boolptr = static_cast<BoolOperand *>(operand1);
-					op1_s = boolptr -> getValue();
-				}
-
-				bool op2_s;
-				if (operand2 -> identify() == "Numerical"){
-
-					NumericalOperand *numptr = static_cast<NumericalOperand *>(operand2);
-					Numerical op2_n = numptr -> getValue();
-					if (op2_n.isDouble()) throw WrongType(*t, "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-					op2_s = op2_n.getInt() == toTest;
-				}
-				else{
-
-					BoolOperand *boolptr = static_cast<BoolOperand *>(operand2);
-					op2_s = boolptr -> getValue();
-				}
-
-				bool result;
-				if ( (*t) -> value() == "U" ){
-					result = op1_s or op2_s;
-				}
-				else if ( (*t) -> value() == "I" ){
-					result = op1_s and op2_s;
-				}
-				else if ( (*t) -> value() == "\\" ){
-					result = op1_s and not op2_s;
-				}
-				else throw SyntaxError(*t, "Unrecognised operator for set evaluation.");
-
-				evalStack.push( new BoolOperand(result) );
-				delete operand1; delete operand2;
-			}
-		}
-		else if ( isOperand(*t) ){
-
-			//check types
-			if ((*t) -> identify() != "DoubleLiteral" and (*t) -> identify() != "IntLiteral" and (*t) -> identify() != "Variable"){
-
-				throw WrongType(*t, "Operands must be doubles, ints, or variables.");
-			}			
-
-			Numerical result = substituteVariable( *t, param2value, globalVariables, localVariables );
-			evalStack.push( new NumericalOperand(result) );
-		}
-	}
-
-	if ( evalStack.top() -> identify() != "Bool" and evalStack.top() -> identify() != "Numerical" ) throw SyntaxError( inputRPN[0], "Message receive expression must evaluate to a bool or an int" );
-
-	bool result;
-	if ( evalStack.top() -> identify() == "Numerical" ){
-
-		NumericalOperand *numptr = static_cast<NumericalOperand *>(evalStack.top());
-		Numerical op1_n = numptr -> getValue();
-		if (op1_n.isDouble()) throw WrongType(inputRPN[0], "Parameter expressions in message receive must evaluate to ints, not doubles (either through explicit or implicit casting).");
-		result = op1_n.doubleCast() == toTest;
-	}
-	else{
-
-		BoolOperand *boolptr = static_cast<BoolOperand *>(evalStack.top());
-		result = boolptr -> getValue();
-	}
-	delete evalStack.top();
-
-#if DEBUG_SETS
-	std::cout << "Bool is: " << result << std::endl;
-#endif
-	return result;
-}
-
@@ -10,6 +10,7 @@
 #define EVALUATE_TREES_H
 
 #include "blockParser.h"
+#include "intervals.h"
 #include <set>
 
 
@@ -69,23 +70,10 @@ class BoolOperand: public RPNoperand {
 		bool getValue(void){return _underlyingBool;}
 };
 
-class SetOperand: public RPNoperand {
-
-	private:
-		std::vector<std::pair<int, int>> _underlyingSet;
-
-	public:
-		SetOperand( std::vector<std::pair<int, int>> in ){_underlyingSet = in;}
- 		~SetOperand(){}
-		std::string identify( void ) const { return "Set"; }
-		std::vector<std::pair<int, int>> getValue(void){return _underlyingSet;}
-};
-
-
-Numerical evalRPN_numerical( std::vector< Token * >, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &);
-bool evalRPN_condition( std::vector< Token * >, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &);
-std::vector< std::pair<int, int> > evalRPN_set( std::vector< Token * > &, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &);
-bool evalRPN_setTest( int &, std::vector< Token * > &, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &);
+Numerical evalRPN_numerical( const std::vector< Token * > &, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &);
+Numerical evalRate( Block *, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > & );
+bool evalRPN_condition( const std::vector< Token * > &, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &);
+IntervalSet evalRPN_set( std::vector< Token * > &, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &);
 std::vector< Token * > shuntingYard( std::vector< Token * > &inputExp );
 Numerical substituteVariable( Token *, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > & );
 bool variableIsDefined( Token *, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &);
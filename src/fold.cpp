@@ -0,0 +1,170 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <sstream>
+#include <iomanip>
+#include "fold.h"
+#include "kernels.h"
+
+
+struct FoldOperand{
+//an operand on the stack while an RPN expression is folded: the tokens that compute it, and its value if that's known now
+
+	std::vector< Token * > tokens;
+	bool isConstant = false;
+	Numerical value;
+};
+
+
+static Token *literalToken( Numerical n, Token *position ){
+//a literal for a folded value, placed where the expression it replaces started so that errors still point there
+
+	if ( n.isInt() ) return new Token( "IntLiteral", std::to_string( n.getInt() ), position -> getLine(), position -> getColumn() );
+
+	std::stringstream ss;
+	ss << std::setprecision( 17 ) << n.getDouble();
+	return new Token( "DoubleLiteral", ss.str(), position -> getLine(), position -> getColumn() );
+}
+
+
+static bool foldable( Numerical n ){
+
+	return n.isInt() or std::isfinite( n.getDouble() );
+}
+
+
+std::vector< Token * > foldExpression( const std::vector< Token * > &rpn, GlobalVariables &globalVariables, const std::set< std::string > &keep ){
+//substitutes global variables into an RPN expression and replaces each arithmetic subexpression whose operands are all known with its value
+//globals named in keep are left alone, and anything the interpreter should report (a malformed expression, wildcards, sets) leaves the expression as it was
+
+	std::vector< FoldOperand > stack;
+
+	for ( auto t = rpn.begin(); t < rpn.end(); t++ ){
+
+		std::string kind = (*t) -> identify();
+		std::string op = (*t) -> value();
+		FoldOperand result;
+
+		if ( kind == "IntLiteral" or kind == "DoubleLiteral" ){
+
+			result.isConstant = true;
+			result.value = ( kind == "IntLiteral" ) ? kInt( atoi( op.c_str() ) ) : kDouble( atof( op.c_str() ) );
+			result.tokens.push_back( *t );
+		}
+		else if ( kind == "Variable" ){
+
+			auto global = globalVariables.values.find( op );
+			if ( global != globalVariables.values.end() and keep.count( op ) == 0 ){
+
+				result.isConstant = true;
+				result.value = global -> second;
+				result.tokens.push_back( literalToken( result.value, *t ) );
+			}
+			else result.tokens.push_back( *t );
+		}
+		else if ( op == "neg" or op == "abs" or op == "sqrt" or op == "~" ){
+
+			if ( stack.empty() ) return rpn;
+			FoldOperand a = stack.back();
+			stack.pop_back();
+
+			if ( a.isConstant and op != "~" ){
+
+				result.value = ( op == "neg" ) ? kNegate( a.value ) : ( ( op == "abs" ) ? kAbs( a.value ) : kSqrt( a.value ) );
+				result.isConstant = foldable( result.value );
+			}
+			if ( result.isConstant ) result.tokens.push_back( literalToken( result.value, a.tokens[0] ) );
+			else{
+
+				result.tokens = a.tokens;
+				result.tokens.push_back( *t );
+			}
+		}
+		else if ( op == "+" or op == "-" or op == "*" or op == "/" or op == "^" or op == "min" or op == "max" or
+		          op == "==" or op == "!=" or op == ">" or op == "<" or op == ">=" or op == "<=" or op == "|" or op == "&" ){
+
+			if ( stack.size() < 2 ) return rpn;
+			FoldOperand b = stack.back();
+			stack.pop_back();
+			FoldOperand a = stack.back();
+			stack.pop_back();
+
+			bool arithmetic = op == "+" or op == "-" or op == "*" or op == "/" or op == "^" or op == "min" or op == "max";
+			bool integerDivisionByZero = op == "/" and b.isConstant and b.value.isInt() and b.value.getInt() == 0 and a.isConstant and a.value.isInt();
+			if ( arithmetic and a.isConstant and b.isConstant and not integerDivisionByZero ){
+
+				if ( op == "+" ) result.value = kAdd( a.value, b.value );
+				else if ( op == "-" ) result.value = kSubtract( a.value, b.value );
+				else if ( op == "*" ) result.value = kMultiply( a.value, b.value );
+				else if ( op == "/" ) result.value = kDivide( a.value, b.value );
+				else if ( op == "^" ) result.value = kPower( a.value, b.value );
+				else if ( op == "min" ) result.value = kMin( a.value, b.value );
+				else result.value = kMax( a.value, b.value );
+				result.isConstant = foldable( result.value );
+			}
+			if ( result.isConstant ) result.tokens.push_back( literalToken( result.value, a.tokens[0] ) );
+			else{
+
+				result.tokens = a.tokens;
+				result.tokens.insert( result.tokens.end(), b.tokens.begin(), b.tokens.end() );
+				result.tokens.push_back( *t );
+			}
+		}
+		else return rpn;
+
+		stack.push_back( result );
+	}
+
+	if ( stack.size() != 1 ) return rpn;
+	return stack.back().tokens;
+}
+
+
+void foldConstants( CompiledModel &model, const std::set< std::string > &variableGlobals ){
+//partial evaluation of every expression in the model against the global variables, which don't change once the model is parsed
+//globals that are swept or inferred change between simulations and are passed in variableGlobals so that they're left alone,
+//as are globals that share a name with a binding variable, since bound values take precedence over globals
+//rates that fold down to a single value are marked as constant on their block so that candidates don't evaluate them at all
+//a constant rate that isn't positive is still only an error if the block is reached, so it's checked where the rate is used, as before
+
+	std::set< std::string > keep = variableGlobals;
+	for ( auto pd = model.processDefinitions.begin(); pd != model.processDefinitions.end(); pd++ ){
+
+		std::vector< Block * > nodes = (pd -> second).parseTree.getNodes();
+		for ( auto b = nodes.begin(); b < nodes.end(); b++ ){
+
+			if ( (*b) -> identify() != "MessageReceive" ) continue;
+			std::vector< std::string > bindingVariables = static_cast< MessageReceiveBlock * >( *b ) -> getBindingVariable();
+			keep.insert( bindingVariables.begin(), bindingVariables.end() );
+		}
+	}
+
+	for ( auto pd = model.processDefinitions.begin(); pd != model.processDefinitions.end(); pd++ ){
+
+		std::vector< Block * > nodes = (pd -> second).parseTree.getNodes();
+		for ( auto b = nodes.begin(); b < nodes.end(); b++ ){
+
+			(*b) -> visitExpressions( [&]( std::vector< Token * > &rpn, ExpressionKind kind ){
+
+				//a channel name that's a single variable is only substituted if it's a parameter or bound variable, never a global
+				if ( kind == CHANNEL_EXPRESSION and rpn.size() == 1 ) return;
+				rpn = foldExpression( rpn, model.globalVars, keep );
+			} );
+
+			if ( (*b) -> identify() == "Action" or (*b) -> identify() == "MessageReceive" or (*b) -> identify() == "MessageSend" ){
+
+				std::vector< Token * > rate = (*b) -> getRate();
+				if ( rate.size() == 1 and rate[0] -> identify() == "IntLiteral" ) (*b) -> setConstantRate( kInt( atoi( rate[0] -> value().c_str() ) ) );
+				else if ( rate.size() == 1 and rate[0] -> identify() == "DoubleLiteral" ) (*b) -> setConstantRate( kDouble( atof( rate[0] -> value().c_str() ) ) );
+			}
+		}
+	}
+
+	for ( auto o = model.observables.begin(); o < model.observables.end(); o++ ) o -> RPNcondition = foldExpression( o -> RPNcondition, model.globalVars, keep );
+	for ( auto sc = model.stopConditions.begin(); sc < model.stopConditions.end(); sc++ ) sc -> RPNcondition = foldExpression( sc -> RPNcondition, model.globalVars, keep );
+}
@@ -0,0 +1,21 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include "model.h"
+
+/*function prototypes */
+std::vector< Token * > foldExpression( const std::vector< Token * > &, GlobalVariables &, const std::set< std::string > & );
+void foldConstants( CompiledModel &, const std::set< std::string > & );
+
+#endif
@@ -15,14 +15,17 @@
 #include <iomanip>
 #include <sstream>
 #include <iterator>
+#include <limits>
+#include <exception>
 #include "handshake.h"
 #include "common.h"
 #include "error_handling.h"
 
-HandshakeChannel::HandshakeChannel( std::vector< std::string > name, GlobalVariables &globalVars ){
+HandshakeChannel::HandshakeChannel( std::vector< std::string > name, GlobalVariables &globalVars, ExpressionMemo *memo ){
 
 	_channelName = name;
 	_globalVars = globalVars;
+	_memo = memo;
 }
 
 std::vector< std::string > HandshakeChannel::getChannelName(void){ return _channelName;}
@@ -56,7 +59,7 @@ std::cout << "receiving sp: " << receiveCand -> processInSystem << std::endl;
 		}
 	}
 
-	Numerical receiveRate = evalRPN_numerical( mrb -> getRate(), receiveCand -> parameterValues, _globalVars, augmentedLocalVars );
+	Numerical receiveRate = _memo -> rate( mrb, receiveCand -> parameterValues, _globalVars, augmentedLocalVars );
 	if ( receiveRate.doubleCast() <= 0 ) throw BadRate( mrb -> getToken() );
 
 	double rate = (sendCand -> rate) * receiveRate.doubleCast();
@@ -74,6 +77,21 @@ std::cout << "receiving sp: " << receiveCand -> processInSystem << std::endl;
 }
 
 
+static bool canReceive( const Candidate &receiveCand, const std::vector< int > &sEval ){
+//whether a receive can take the values a send is sending, using the sets worked out when the receive was added to the channel
+
+	//fast pass if the parameter arity is wrong
+	if ( receiveCand.receiveSets.size() != sEval.size() ) return false;
+
+	for ( unsigned int i = 0; i < sEval.size(); i++ ){
+
+		if ( receiveCand.receiveSetError and i == receiveCand.receiveSetErrorAt ) std::rethrow_exception( receiveCand.receiveSetError );
+		if ( not receiveCand.receiveSets[i].contains( sEval[i] ) ) return false;
+	}
+	return true;
+}
+
+
 std::pair<int, double> HandshakeChannel::updateHandshakeCandidates(void){
 
 	int candidatesAdded = 0;
@@ -91,23 +109,7 @@ std::pair<int, double> HandshakeChannel::updateHandshakeCandidates(void){
 
 			for ( auto r_cand = (receive -> second).begin(); r_cand != (receive -> second).end(); r_cand++ ){
 
-				MessageReceiveBlock *mrb = dynamic_cast< MessageReceiveBlock * >((*r_cand) -> actionCandidate);
-				std::vector< std::vector< Token * > > setExpressions = mrb -> getSetExpression();
-
-				//fast pass if the parameter arity is wrong
-				if (setExpressions.size() != sEval.size()) continue;
-
-				//check each value against its set expression
-				bool allPassed = true;
-				for ( unsigned int i = 0; i < sEval.size(); i++ ){
-
-					bool setEval = evalRPN_setTest( sEval[i], setExpressions[i], (*r_cand) -> parameterValues, _globalVars, (*r_cand) -> localVariables );
-					if (not setEval){
-						allPassed = false;
-						break;
-					}
-				}
-				if (allPassed){
+				if ( canReceive( **r_cand, sEval ) ){
 
 					std::shared_ptr<HandshakeCandidate> newHS = buildHandshakeCandidate( *addedSend, *r_cand, sEval );
 
@@ -124,9 +126,6 @@ std::pair<int, double> HandshakeChannel::updateHandshakeCandidates(void){
 	//match added receives to sends that are already there
 	for ( auto addedReceive = _receiveToAdd.begin(); addedReceive != _receiveToAdd.end(); addedReceive++ ){
 
-		MessageReceiveBlock *mrb = dynamic_cast< MessageReceiveBlock * >((*addedReceive) -> actionCandidate);
-		std::vector< std::vector< Token * > > setExpressions = mrb -> getSetExpression();
-
 		for ( auto send = _hsSend_Sp2Candidates.begin(); send != _hsSend_Sp2Candidates.end(); send++ ){
 
 			//can't have a handshake between the same sp
@@ -136,20 +135,7 @@ std::pair<int, double> HandshakeChannel::updateHandshakeCandidates(void){
 
 				std::vector<int> sEval = (*s_cand) -> sendReceiveParameters;
 
-				//fast pass if the parameter arity is wrong
-				if (setExpressions.size() != sEval.size()) continue;
-
-				//check each value against its set expression
-				bool allPassed = true;
-				for ( unsigned int i = 0; i < sEval.size(); i++ ){
-
-					bool setEval = evalRPN_setTest( sEval[i], setExpressions[i], (*addedReceive) -> parameterValues, _globalVars, (*addedReceive) -> localVariables );
-					if (not setEval){
-						allPassed = false;
-						break;
-					}
-				}
-				if (allPassed){
+				if ( canReceive( **addedReceive, sEval ) ){
 
 					std::shared_ptr<HandshakeCandidate> newHS = buildHandshakeCandidate( *s_cand, *addedReceive, sEval );
 					SystemProcess *sp_send = (*s_cand) -> processInSystem;
@@ -172,23 +158,7 @@ std::pair<int, double> HandshakeChannel::updateHandshakeCandidates(void){
 			//can't have a handshake between the same sp
 			if ((*addedSend) -> processInSystem == (*r_cand) -> processInSystem) continue;
 
-			MessageReceiveBlock *mrb = dynamic_cast< MessageReceiveBlock * >((*r_cand) -> actionCandidate);
-			std::vector< std::vector< Token * > > setExpressions = mrb -> getSetExpression();
-
-			//fast pass if the parameter arity is wrong
-			if (setExpressions.size() != sEval.size()) continue;
-
-			//check each value against its set expression
-			bool allPassed = true;
-			for ( unsigned int i = 0; i < sEval.size(); i++ ){
-
-				bool setEval = evalRPN_setTest( sEval[i], setExpressions[i], (*r_cand) -> parameterValues, _globalVars, (*r_cand) -> localVariables );
-				if (not setEval){
-					allPassed = false;
-					break;
-				}
-			}
-			if (allPassed){
+			if ( canReceive( **r_cand, sEval ) ){
 
 				std::shared_ptr<HandshakeCandidate> newHS = buildHandshakeCandidate( *addedSend, *r_cand, sEval );
 				SystemProcess *sp_send = (*addedSend) -> processInSystem;
@@ -332,6 +302,27 @@ std::cout << std::endl;
 std::cout << "associated with sp: " << rc -> processInSystem << std::endl;
 #endif
 
+	//the receive's parameters and local variables don't change while it waits, so the set of values it can take is worked out once here
+	//if a set can't be worked out, the error is kept and only raised once a send gets as far as that parameter, as it would be if the set were evaluated then
+	MessageReceiveBlock *mrb = static_cast< MessageReceiveBlock * >( rc -> actionCandidate );
+	std::vector< std::vector< Token * > > setExpressions = mrb -> getSetExpression();
+	rc -> receiveSets.assign( setExpressions.size(), IntervalSet() );
+	rc -> receiveSetError = nullptr;
+	for ( unsigned int i = 0; i < setExpressions.size(); i++ ){
+
+		try{
+
+			if ( setExpressions[i][0] -> identify() == "Wildcard" ) rc -> receiveSets[i] = IntervalSet( std::numeric_limits<int>::min(), std::numeric_limits<int>::max() );
+			else rc -> receiveSets[i] = evalRPN_set( setExpressions[i], rc -> parameterValues, _globalVars, rc -> localVariables );
+		}
+		catch ( ... ){
+
+			rc -> receiveSetError = std::current_exception();
+			rc -> receiveSetErrorAt = i;
+			break;
+		}
+	}
+
 	_receiveToAdd.push_back( rc );
 }
 
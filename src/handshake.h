@@ -17,6 +17,7 @@
 #include <sstream>
 #include <iterator>
 #include "evaluate_trees.h"
+#include "memo.h"
 
 class HandshakeCandidate{
 
@@ -47,6 +48,7 @@ class HandshakeChannel{
 	private:
 		std::vector< std::string > _channelName;
 		GlobalVariables _globalVars;
+		ExpressionMemo *_memo; //owned by the system, shared by all of its channels
 		std::map< SystemProcess *, std::list< std::shared_ptr<Candidate> > > _hsSend_Sp2Candidates;
 		std::map< SystemProcess *, std::list< std::shared_ptr<Candidate> > > _hsReceive_Sp2Candidates;
 		std::map< SystemProcess *, std::list< std::shared_ptr<HandshakeCandidate> > > _possibleHandshakes_sp2Candidates;
@@ -55,7 +57,7 @@ class HandshakeChannel{
 		std::list< std::shared_ptr<Candidate> > _receiveToAdd;
 
 	public:
-		HandshakeChannel( std::vector< std::string > name, GlobalVariables & );
+		HandshakeChannel( std::vector< std::string > name, GlobalVariables &, ExpressionMemo * );
 		HandshakeChannel( const HandshakeChannel & );
 		std::vector< std::string > getChannelName(void);
 		std::shared_ptr<HandshakeCandidate> buildHandshakeCandidate( std::shared_ptr<Candidate> , std::shared_ptr<Candidate> , std::vector<int> );
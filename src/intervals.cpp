@@ -0,0 +1,112 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <algorithm>
+#include "intervals.h"
+
+
+void IntervalSet::append( long long lb, long long ub ){
+//adds [lb,ub], where lb is no smaller than the lower bound of any interval already in the set
+//bounds are long long so that ub+1 can't overflow at the top of the int range
+
+	if ( lb > ub ) return;
+
+	if ( _size > 0 and lb <= (long long) back().second + 1 ){
+
+		if ( ub > back().second ) back().second = ub;
+		return;
+	}
+
+	if ( _size < INTERVALS_INLINE ) _inline[ _size ] = std::make_pair( (int) lb, (int) ub );
+	else _spill.push_back( std::make_pair( (int) lb, (int) ub ) );
+	_size++;
+}
+
+
+bool IntervalSet::contains( int i ) const {
+//binary search for the last interval that starts at or before i
+
+	size_t lo = 0, hi = _size;
+	while ( lo < hi ){
+
+		size_t mid = ( lo + hi ) / 2;
+		if ( (*this)[mid].first <= i ) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo > 0 and i <= (*this)[ lo - 1 ].second;
+}
+
+
+IntervalSet IntervalSet::unite( const IntervalSet &other ) const {
+//merges the two sets by lower bound
+
+	IntervalSet out;
+	size_t i = 0, j = 0;
+	while ( i < _size or j < other._size ){
+
+		if ( j == other._size or ( i < _size and (*this)[i].first <= other[j].first ) ){
+
+			out.append( (*this)[i].first, (*this)[i].second );
+			i++;
+		}
+		else{
+
+			out.append( other[j].first, other[j].second );
+			j++;
+		}
+	}
+	return out;
+}
+
+
+IntervalSet IntervalSet::intersect( const IntervalSet &other ) const {
+//the overlap of the current pair of intervals, then move past whichever of them ends first
+
+	IntervalSet out;
+	size_t i = 0, j = 0;
+	while ( i < _size and j < other._size ){
+
+		out.append( std::max( (*this)[i].first, other[j].first ), std::min( (*this)[i].second, other[j].second ) );
+		if ( (*this)[i].second < other[j].second ) i++;
+		else j++;
+	}
+	return out;
+}
+
+
+IntervalSet IntervalSet::subtract( const IntervalSet &other ) const {
+//for each interval, keep the gaps between the intervals of other that overlap it
+//intervals of other that end before this interval starts can't overlap any later one either, so j only moves forward
+
+	IntervalSet out;
+	size_t j = 0;
+	for ( size_t i = 0; i < _size; i++ ){
+
+		long long lb = (*this)[i].first, ub = (*this)[i].second;
+		while ( j < other._size and other[j].second < lb ) j++;
+
+		for ( size_t k = j; k < other._size and other[k].first <= ub and lb <= ub; k++ ){
+
+			out.append( lb, (long long) other[k].first - 1 );
+			lb = std::max( lb, (long long) other[k].second + 1 );
+		}
+		out.append( lb, ub );
+	}
+	return out;
+}
+
+
+bool operator==( const IntervalSet &s1, const IntervalSet &s2 ){
+
+	if ( s1._size != s2._size ) return false;
+	for ( size_t i = 0; i < s1._size; i++ ){
+
+		if ( s1[i] != s2[i] ) return false;
+	}
+	return true;
+}
@@ -0,0 +1,43 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef INTERVALS_H
+#define INTERVALS_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+#define INTERVALS_INLINE 4 //intervals held in the set itself before it spills onto the heap
+
+
+class IntervalSet{
+//a set of ints as closed intervals that are sorted, disjoint, and never adjacent, so every set has exactly one representation
+//the operations walk both sets once in order and build their result with append, which keeps it in that form
+
+	private:
+		std::pair< int, int > _inline[ INTERVALS_INLINE ];
+		std::vector< std::pair< int, int > > _spill;
+		unsigned int _size = 0;
+		std::pair< int, int > &back( void ){ return ( _size <= INTERVALS_INLINE ) ? _inline[ _size - 1 ] : _spill.back(); }
+		void append( long long, long long );
+
+	public:
+		IntervalSet(){}
+		IntervalSet( int lb, int ub ){ append( lb, ub ); }
+		size_t size( void ) const { return _size; }
+		bool empty( void ) const { return _size == 0; }
+		const std::pair< int, int > &operator[]( size_t i ) const { return ( i < INTERVALS_INLINE ) ? _inline[i] : _spill[ i - INTERVALS_INLINE ]; }
+		bool contains( int ) const;
+		IntervalSet unite( const IntervalSet & ) const;
+		IntervalSet intersect( const IntervalSet & ) const;
+		IntervalSet subtract( const IntervalSet & ) const;
+		friend bool operator==( const IntervalSet &, const IntervalSet & );
+};
+
+#endif
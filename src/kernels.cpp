@@ -0,0 +1,348 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <sstream>
+#include <iomanip>
+#include <unordered_map>
+#include "kernels.h"
+#include "model.h"
+
+static const LinkedModel *linked = NULL;
+static std::unordered_map< Token *, std::pair< size_t, ExpressionKernel > > installed;
+
+
+/*EXPRESSIONS--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+void forEachExpression( CompiledModel &model, std::function< void( const std::vector< Token * > &, bool ) > visit ){
+//visits every expression in the model, and whether it's a condition, in a fixed order that the code generator and installKernels both rely on
+
+	for ( auto pd = model.processDefinitions.begin(); pd != model.processDefinitions.end(); pd++ ){
+
+		std::vector< Block * > nodes = (pd -> second).parseTree.getNodes();
+		for ( auto b = nodes.begin(); b < nodes.end(); b++ ){
+
+			(*b) -> visitExpressions( [&]( std::vector< Token * > &rpn, ExpressionKind kind ){ visit( rpn, kind == CONDITION_EXPRESSION ); } );
+		}
+	}
+
+	for ( auto o = model.observables.begin(); o < model.observables.end(); o++ ) visit( o -> RPNcondition, true );
+	for ( auto sc = model.stopConditions.begin(); sc < model.stopConditions.end(); sc++ ) visit( sc -> RPNcondition, true );
+}
+
+
+/*LINKED KERNELS-----------------------------------------------------------------------------------------------------------------------------------------------------*/
+void linkModel( const LinkedModel *lm ){
+//called while the program starts up by code from bcs --emit-cpp
+
+	linked = lm;
+}
+
+
+const LinkedModel *linkedModel( void ){
+
+	return linked;
+}
+
+
+void installKernels( CompiledModel &model ){
+//matches the linked kernels to the expressions of the model that was read from the linked data
+//expressions are looked up by their first token, which no two expressions share - if they ever did, both are left to the interpreter
+
+	if ( linked == NULL ) return;
+
+	std::vector< std::vector< Token * > > expressions;
+	std::vector< bool > conditions;
+	forEachExpression( model, [&]( const std::vector< Token * > &rpn, bool condition ){
+
+		expressions.push_back( rpn );
+		conditions.push_back( condition );
+	} );
+	if ( expressions.size() != linked -> numKernels ) throw BadModelFile( "the generated code doesn't match the model it was built with." );
+
+	std::map< Token *, std::vector< Token * > > seen;
+	std::vector< Token * > ambiguous;
+	for ( unsigned int i = 0; i < expressions.size(); i++ ){
+
+		const ExpressionKernel &k = linked -> kernels[i];
+		if ( expressions[i].empty() or ( k.numerical == NULL and k.condition == NULL ) ) continue;
+		if ( ( conditions[i] and k.condition == NULL ) or ( not conditions[i] and k.numerical == NULL ) ) continue;
+
+		Token *first = expressions[i][0];
+		if ( seen.count( first ) > 0 ){
+
+			if ( seen[first] != expressions[i] ) ambiguous.push_back( first );
+			continue;
+		}
+		seen[first] = expressions[i];
+		installed[first] = std::make_pair( expressions[i].size(), k );
+	}
+	for ( auto a = ambiguous.begin(); a < ambiguous.end(); a++ ) installed.erase( *a );
+}
+
+
+const ExpressionKernel *findKernel( const std::vector< Token * > &rpn ){
+
+	if ( installed.empty() or rpn.empty() ) return NULL;
+	auto found = installed.find( rpn[0] );
+	if ( found == installed.end() or (found -> second).first != rpn.size() ) return NULL;
+	return &( (found -> second).second );
+}
+
+
+/*CODE GENERATION----------------------------------------------------------------------------------------------------------------------------------------------------*/
+struct KernelOperand{
+//an operand on the stack while an RPN expression is turned into code, which is either a constant or a temporary in the generated function
+
+	std::string code;
+	bool isBool = false;
+	bool isConstant = false;
+	Numerical value;
+	bool truth = false;
+};
+
+
+static std::string numericalLiteral( Numerical n ){
+
+	std::stringstream ss;
+	if ( n.isInt() ) ss << "kInt( " << n.getInt() << " )";
+	else ss << "kDouble( " << std::setprecision( 17 ) << n.getDouble() << " )";
+	return ss.str();
+}
+
+
+static std::string cppString( const std::string &s ){
+
+	std::string out = "\"";
+	for ( auto c = s.begin(); c < s.end(); c++ ){
+
+		if ( *c == '"' or *c == '\\' ) out.push_back( '\\' );
+		out.push_back( *c );
+	}
+	return out + "\"";
+}
+
+
+static std::string doubleCode( KernelOperand &a ){
+//an operand of a comparison, which compares as a double
+
+	if ( not a.isConstant ) return a.code + ".doubleCast()";
+	std::stringstream ss;
+	ss << std::setprecision( 17 ) << a.value.doubleCast();
+	return ss.str();
+}
+
+
+static bool foldable( Numerical n ){
+
+	return n.isInt() or std::isfinite( n.getDouble() );
+}
+
+
+static bool generateKernel( const std::vector< Token * > &rpn, bool condition, std::string &body ){
+//writes the statements of a kernel for one RPN expression into body, folding operations whose operands are all literals
+//returns false if the expression uses something that's left to the interpreter (sets, wildcards) or is malformed, in which
+//case the interpreter also gets to report the error
+
+	std::vector< KernelOperand > stack;
+	std::stringstream code;
+	unsigned int temporaries = 0;
+
+	for ( unsigned int i = 0; i < rpn.size(); i++ ){
+
+		std::string kind = rpn[i] -> identify();
+		std::string op = rpn[i] -> value();
+		KernelOperand result;
+
+		if ( kind == "IntLiteral" or kind == "DoubleLiteral" ){
+
+			result.isConstant = true;
+			if ( kind == "IntLiteral" ) result.value = kInt( atoi( op.c_str() ) );
+			else result.value = kDouble( atof( op.c_str() ) );
+			if ( not foldable( result.value ) ) return false;
+			result.code = numericalLiteral( result.value );
+		}
+		else if ( kind == "Variable" ){
+
+			result.code = "v" + std::to_string( temporaries++ );
+			code << "\tNumerical " << result.code << " = kVariable( " << cppString( op ) << ", rpn, " << i << ", pv, gv, lv );\n";
+		}
+		else if ( op == "neg" or op == "abs" or op == "sqrt" or op == "~" ){
+
+			if ( stack.empty() ) return false;
+			KernelOperand a = stack.back();
+			stack.pop_back();
+
+			if ( op == "~" ){
+
+				if ( not a.isBool ) return false;
+				result.isBool = true;
+				result.isConstant = a.isConstant;
+				result.truth = not a.truth;
+				result.code = result.isConstant ? ( result.truth ? "true" : "false" ) : "( not " + a.code + " )";
+			}
+			else{
+
+				if ( a.isBool ) return false;
+				std::string function = ( op == "neg" ) ? "kNegate" : ( ( op == "abs" ) ? "kAbs" : "kSqrt" );
+				if ( a.isConstant ){
+
+					result.value = ( op == "neg" ) ? kNegate( a.value ) : ( ( op == "abs" ) ? kAbs( a.value ) : kSqrt( a.value ) );
+					result.isConstant = foldable( result.value );
+				}
+				if ( result.isConstant ) result.code = numericalLiteral( result.value );
+				else{
+
+					result.code = "v" + std::to_string( temporaries++ );
+					code << "\tNumerical " << result.code << " = " << function << "( " << a.code << " );\n";
+				}
+			}
+		}
+		else if ( op == "+" or op == "-" or op == "*" or op == "/" or op == "^" or op == "min" or op == "max" ){
+
+			if ( stack.size() < 2 ) return false;
+			KernelOperand b = stack.back();
+			stack.pop_back();
+			KernelOperand a = stack.back();
+			stack.pop_back();
+			if ( a.isBool or b.isBool ) return false;
+
+			std::map< std::string, std::string > functions = { {"+","kAdd"}, {"-","kSubtract"}, {"*","kMultiply"}, {"/","kDivide"}, {"^","kPower"}, {"min","kMin"}, {"max","kMax"} };
+			bool integerDivisionByZero = op == "/" and b.isConstant and b.value.isInt() and b.value.getInt() == 0 and a.isConstant and a.value.isInt();
+			if ( a.isConstant and b.isConstant and not integerDivisionByZero ){
+
+				if ( op == "+" ) result.value = kAdd( a.value, b.value );
+				else if ( op == "-" ) result.value = kSubtract( a.value, b.value );
+				else if ( op == "*" ) result.value = kMultiply( a.value, b.value );
+				else if ( op == "/" ) result.value = kDivide( a.value, b.value );
+				else if ( op == "^" ) result.value = kPower( a.value, b.value );
+				else if ( op == "min" ) result.value = kMin( a.value, b.value );
+				else result.value = kMax( a.value, b.value );
+				result.isConstant = foldable( result.value );
+			}
+			if ( result.isConstant ) result.code = numericalLiteral( result.value );
+			else{
+
+				result.code = "v" + std::to_string( temporaries++ );
+				code << "\tNumerical " << result.code << " = " << functions[op] << "( " << a.code << ", " << b.code << " );\n";
+			}
+		}
+		else if ( op == "==" or op == "!=" or op == ">" or op == "<" or op == ">=" or op == "<=" ){
+
+			if ( stack.size() < 2 ) return false;
+			KernelOperand b = stack.back();
+			stack.pop_back();
+			KernelOperand a = stack.back();
+			stack.pop_back();
+			if ( a.isBool or b.isBool ) return false;
+
+			result.isBool = true;
+			if ( a.isConstant and b.isConstant ){
+
+				double x = a.value.doubleCast(), y = b.value.doubleCast();
+				result.isConstant = true;
+				if ( op == "==" ) result.truth = x == y;
+				else if ( op == "!=" ) result.truth = x != y;
+				else if ( op == ">" ) result.truth = x > y;
+				else if ( op == "<" ) result.truth = x < y;
+				else if ( op == ">=" ) result.truth = x >= y;
+				else result.truth = x <= y;
+				result.code = result.truth ? "true" : "false";
+			}
+			else{
+
+				result.code = "b" + std::to_string( temporaries++ );
+				code << "\tbool " << result.code << " = " << doubleCode( a ) << " " << op << " " << doubleCode( b ) << ";\n";
+			}
+		}
+		else if ( op == "|" or op == "&" ){
+
+			if ( stack.size() < 2 ) return false;
+			KernelOperand b = stack.back();
+			stack.pop_back();
+			KernelOperand a = stack.back();
+			stack.pop_back();
+			if ( not a.isBool or not b.isBool ) return false;
+
+			result.isBool = true;
+			if ( a.isConstant and b.isConstant ){
+
+				result.isConstant = true;
+				result.truth = ( op == "|" ) ? ( a.truth or b.truth ) : ( a.truth and b.truth );
+				result.code = result.truth ? "true" : "false";
+			}
+			else{
+
+				result.code = "b" + std::to_string( temporaries++ );
+				code << "\tbool " << result.code << " = " << a.code << ( ( op == "|" ) ? " or " : " and " ) << b.code << ";\n";
+			}
+		}
+		else return false;
+
+		stack.push_back( result );
+	}
+
+	if ( stack.size() != 1 or stack.back().isBool != condition ) return false;
+	code << "\treturn " << stack.back().code << ";\n";
+	body = code.str();
+	return true;
+}
+
+
+void emitCpp( CompiledModel &model, std::ostream &out ){
+//writes C++ for the model: the compiled model itself, and a native kernel for each expression that the interpreter would otherwise evaluate token by token
+//linking it against lib/libbcs.a gives a bcs executable that runs this model without a source file
+
+	out << "//generated by bcs --emit-cpp - edit the .bc model and generate this again rather than editing it\n";
+	out << "//build with: g++ -O2 -fopenmp -std=c++11 -I<bcs>/src thisFile.cpp <bcs>/lib/libbcs.a -o model\n\n";
+	out << "#include \"kernels.h\"\n\n";
+
+	std::vector< std::pair< std::string, bool > > kernels;
+	forEachExpression( model, [&]( const std::vector< Token * > &rpn, bool condition ){
+
+		std::string body;
+		if ( rpn.size() < 2 or not generateKernel( rpn, condition, body ) ){
+
+			kernels.push_back( std::make_pair( "", condition ) );
+			return;
+		}
+
+		std::string name = "expression" + std::to_string( kernels.size() );
+		out << "static " << ( condition ? "bool " : "Numerical " ) << name;
+		out << "( const std::vector< Token * > &rpn, ParameterValues &pv, GlobalVariables &gv, std::map< std::string, Numerical > &lv ){\n";
+		out << "//line " << rpn[0] -> getLine() << ": ";
+		for ( auto t = rpn.begin(); t < rpn.end(); t++ ) out << (*t) -> value() << " ";
+		out << "\n\n" << body << "}\n\n\n";
+		kernels.push_back( std::make_pair( name, condition ) );
+	} );
+
+	out << "static const ExpressionKernel expressionKernels[] = {\n";
+	for ( auto k = kernels.begin(); k < kernels.end(); k++ ){
+
+		if ( (k -> first).empty() ) out << "\t{ NULL, NULL }";
+		else if ( k -> second ) out << "\t{ NULL, " << k -> first << " }";
+		else out << "\t{ " << k -> first << ", NULL }";
+		out << ( ( k + 1 < kernels.end() ) ? ",\n" : "\n" );
+	}
+	if ( kernels.empty() ) out << "\t{ NULL, NULL }\n";
+	out << "};\n\n";
+
+	std::string data = serialiseModel( model );
+	out << "static const unsigned char compiledModel[] = {";
+	for ( size_t i = 0; i < data.size(); i++ ){
+
+		if ( i % 20 == 0 ) out << "\n\t";
+		out << (unsigned int) (unsigned char) data[i] << ( ( i + 1 < data.size() ) ? "," : "" );
+	}
+	out << "\n};\n\n";
+
+	out << "static const LinkedModel thisModel = { compiledModel, sizeof( compiledModel ), expressionKernels, " << kernels.size() << " };\n";
+	out << "static ModelLink link( &thisModel );\n\n";
+
+	//lib/libbcs.a has the bcs front end with its main renamed, so that only this file defines main
+	out << "int bcsMain( int, char** );\n\n";
+	out << "int main( int argc, char** argv ){\n\n\treturn bcsMain( argc, argv );\n}\n";
+}
@@ -0,0 +1,165 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include "blockParser.h"
+#include "error_handling.h"
+
+struct CompiledModel;
+
+
+/*compiled expressions are passed their RPN so that errors can point at the right token */
+typedef Numerical (*NumericalKernel)( const std::vector< Token * > &, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > & );
+typedef bool (*ConditionKernel)( const std::vector< Token * > &, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > & );
+
+
+struct ExpressionKernel{
+//native code for one expression in the model - at most one of these is set, and neither is set if the expression is left to the interpreter
+
+	NumericalKernel numerical;
+	ConditionKernel condition;
+};
+
+
+struct LinkedModel{
+//a compiled model and the kernels for its expressions, built into the executable by code from bcs --emit-cpp
+//kernels are in the order that forEachExpression visits the expressions of the model
+
+	const unsigned char *data;
+	size_t size;
+	const ExpressionKernel *kernels;
+	size_t numKernels;
+};
+
+
+void linkModel( const LinkedModel * );
+
+
+struct ModelLink{
+//generated code links its model in while the program starts up by declaring one of these
+
+	ModelLink( const LinkedModel *lm ){ linkModel( lm ); }
+};
+
+
+/*arithmetic used by both the code generator and the code it generates, so that constants folded at generation time have the same value they would have at run time */
+inline Numerical kInt( int i ){
+
+	Numerical n;
+	n.setInt( i );
+	return n;
+}
+
+
+inline Numerical kDouble( double d ){
+
+	Numerical n;
+	n.setDouble( d );
+	return n;
+}
+
+
+inline Numerical kVariable( const std::string &name, const std::vector< Token * > &rpn, unsigned int position, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables ){
+//same order of precedence as substituteVariable
+
+	auto local = localVariables.find( name );
+	if ( local != localVariables.end() ) return local -> second;
+	auto global = globalVariables.values.find( name );
+	if ( global != globalVariables.values.end() ) return global -> second;
+	auto param = param2value.values.find( name );
+	if ( param != param2value.values.end() ) return param -> second;
+	throw UndefinedVariable( rpn[position] );
+}
+
+
+inline Numerical kAdd( Numerical a, Numerical b ){
+
+	if ( a.isDouble() or b.isDouble() ) return kDouble( a.doubleCast() + b.doubleCast() );
+	return kInt( a.getInt() + b.getInt() );
+}
+
+
+inline Numerical kSubtract( Numerical a, Numerical b ){
+
+	if ( a.isDouble() or b.isDouble() ) return kDouble( a.doubleCast() - b.doubleCast() );
+	return kInt( a.getInt() - b.getInt() );
+}
+
+
+inline Numerical kMultiply( Numerical a, Numerical b ){
+
+	if ( a.isDouble() or b.isDouble() ) return kDouble( a.doubleCast() * b.doubleCast() );
+	return kInt( a.getInt() * b.getInt() );
+}
+
+
+inline Numerical kDivide( Numerical a, Numerical b ){
+
+	if ( a.isDouble() or b.isDouble() ) return kDouble( a.doubleCast() / b.doubleCast() );
+	return kInt( a.getInt() / b.getInt() );
+}
+
+
+inline Numerical kPower( Numerical a, Numerical b ){
+
+	if ( a.isDouble() or b.isDouble() ) return kDouble( pow( a.doubleCast(), b.doubleCast() ) );
+	return kInt( pow( a.getInt(), b.getInt() ) );
+}
+
+
+inline Numerical kMin( Numerical a, Numerical b ){
+
+	if ( a.isDouble() or b.isDouble() ) return kDouble( std::min( a.doubleCast(), b.doubleCast() ) );
+	return kInt( std::min( a.getInt(), b.getInt() ) );
+}
+
+
+inline Numerical kMax( Numerical a, Numerical b ){
+
+	if ( a.isDouble() or b.isDouble() ) return kDouble( std::max( a.doubleCast(), b.doubleCast() ) );
+	return kInt( std::max( a.getInt(), b.getInt() ) );
+}
+
+
+inline Numerical kNegate( Numerical a ){
+
+	if ( a.isInt() ) return kInt( -a.getInt() );
+	return kDouble( -a.getDouble() );
+}
+
+
+inline Numerical kAbs( Numerical a ){
+
+	if ( a.isInt() ) return kInt( std::abs( a.getInt() ) );
+	return kDouble( std::abs( a.getDouble() ) );
+}
+
+
+inline Numerical kSqrt( Numerical a ){
+
+	if ( a.isInt() ) return kInt( sqrt( a.getInt() ) );
+	return kDouble( sqrt( a.getDouble() ) );
+}
+
+
+/*function prototypes */
+void forEachExpression( CompiledModel &, std::function< void( const std::vector< Token * > &, bool ) > );
+const LinkedModel *linkedModel( void );
+void installKernels( CompiledModel & );
+const ExpressionKernel *findKernel( const std::vector< Token * > & );
+void emitCpp( CompiledModel &, std::ostream & );
+
+#endif
@@ -12,6 +12,8 @@
 #include <vector>
 #include <fstream>
 #include <assert.h>
+#include <map>
+#include <utility>
 #include "lexer.h"
 #include "error_handling.h"
 #include "parser.h"
@@ -48,62 +50,137 @@ void FiniteStateAutomaton::designate_endState( std::string newEndState ){
 }
 
 
-std::string FiniteStateAutomaton::testString( std::string strToTest ){
-//takes strToTest and tests if it's valid using the automaton
-//returns:
-// - empty string if rejected, which is to say we can't transition from a start state to an end state in this automaton
-// - the accepted string, a portion of strToTest
+void FiniteStateAutomaton::compile( std::vector< std::array< int, 256 > > &transitions, std::vector< bool > &isEndState ) const{
+//numbers the states of the automaton, with the start state as 0, and writes out a table of where each state goes on each character
+//args:
+// - transitions: for each state, the state reached on each character or -1 if there's no edge for it
+// - isEndState: true for each state that's an end state
+
+	std::map< std::string, int > stateIndex;
+	stateIndex[startState] = 0;
+	for ( auto edg = edges.begin(); edg < edges.end(); edg++ ){
+
+		stateIndex.insert( std::make_pair( std::get<0>(*edg), (int) stateIndex.size() ) );
+		stateIndex.insert( std::make_pair( std::get<2>(*edg), (int) stateIndex.size() ) );
+	}
+
+	std::array< int, 256 > noEdges;
+	noEdges.fill( -1 );
+	transitions.assign( stateIndex.size(), noEdges );
+	for ( auto edg = edges.begin(); edg < edges.end(); edg++ ){
 
-	std::string currentState = startState;
-	std::string acceptedString;
+		int from = stateIndex[std::get<0>(*edg)];
+		int to = stateIndex[std::get<2>(*edg)];
+		for ( auto c = std::get<1>(*edg).begin(); c != std::get<1>(*edg).end(); c++ ) transitions[from][(unsigned char) *c] = to;
+	}
 
-	/*require that we have at least one end state */
-	assert( endStates.size() > 0 );
+	isEndState.assign( stateIndex.size(), false );
+	for ( auto es = endStates.begin(); es < endStates.end(); es++ ){
 
-	/*iterate on symbols in the test string */
-	for ( unsigned int i = 0; i < strToTest.size(); i++ ){
+		if ( stateIndex.count( *es ) ) isEndState[stateIndex[*es]] = true;
+	}
+}
 
-		bool foundEdge = false;
 
-		/*iterate on possible edges we can take from this state */
-		for ( auto edg = edges.begin(); edg < edges.end(); edg++ ){
+/*COMBINED AUTOMATON METHODS-----------------------------------------------------------------------------------------------------------------------------------------*/
+CombinedAutomaton::CombinedAutomaton( const std::vector< std::pair< FiniteStateAutomaton *, std::string > > &machines ){
+//product construction: each combined state is the state that every machine is in after reading the same characters, with -1 for machines that have stopped
+//args:
+// - machines: token automata paired with the name of the token they accept, in the order that they take priority
 
-			std::string fromState = std::get<0>(*edg);
+	assert( machines.size() <= 32 );
 
-			/*if the edge leads from the current state... */
-			if ( fromState == currentState ){
+	std::vector< std::vector< std::array< int, 256 > > > machineTransitions( machines.size() );
+	std::vector< std::vector< bool > > machineEndStates( machines.size() );
+	for ( unsigned int m = 0; m < machines.size(); m++ ){
 
-				std::set< char > acceptingSymbols = std::get<1>(*edg);
+		machines[m].first -> compile( machineTransitions[m], machineEndStates[m] );
+		_tokenNames.push_back( machines[m].second );
+	}
 
-				/*if this edge accepts the symbol */
-				if ( acceptingSymbols.count( strToTest[i] ) ){
+	std::map< std::vector< int >, int > combinedIndex;
+	std::vector< std::vector< int > > toVisit;
+	toVisit.push_back( std::vector< int >( machines.size(), 0 ) );
+	combinedIndex[toVisit[0]] = 0;
 
-					/*switch the current state to the state that the edge leads to, append the symbol to the accepted string */
-					currentState = std::get<2>(*edg);
-					acceptedString += strToTest[i];
-					foundEdge=true;
-					break;
-				}
-			}
+	for ( unsigned int s = 0; s < toVisit.size(); s++ ){
+
+		std::vector< int > current = toVisit[s];
+
+		uint32_t alive = 0, accepting = 0;
+		for ( unsigned int m = 0; m < machines.size(); m++ ){
+
+			if ( current[m] == -1 ) continue;
+			alive |= ( (uint32_t) 1 ) << m;
+			if ( machineEndStates[m][current[m]] ) accepting |= ( (uint32_t) 1 ) << m;
 		}
+		_alive.push_back( alive );
+		_accepting.push_back( accepting );
 
-		/*termination conditions - if I have a symbol where there's no viable edge from the state I'm in, OR i've reached the end of the test string */
-		if ( (not foundEdge) or (i == strToTest.size() - 1) ){
+		std::array< int, 256 > row;
+		for ( unsigned int c = 0; c < 256; c++ ){
 
-			/*if we're in an end state, then we're okay - terminate the machine successfully and return the accepted string */
-			if ( std::find( endStates.begin(), endStates.end(), currentState ) != endStates.end() ){
+			std::vector< int > next( machines.size(), -1 );
+			bool anyAlive = false;
+			for ( unsigned int m = 0; m < machines.size(); m++ ){
 
-				break;
+				if ( current[m] == -1 ) continue;
+				next[m] = machineTransitions[m][current[m]][c];
+				if ( next[m] != -1 ) anyAlive = true;
 			}
-			/*if we're not in the end state, then don't accept anything and return the empty string */
-			else {
 
-				acceptedString = "";
-				break;
+			if ( not anyAlive ){
+
+				row[c] = -1;
+				continue;
+			}
+
+			auto found = combinedIndex.find( next );
+			if ( found == combinedIndex.end() ){
+
+				found = combinedIndex.insert( std::make_pair( next, (int) toVisit.size() ) ).first;
+				toVisit.push_back( next );
 			}
+			row[c] = found -> second;
 		}
+		_transitions.push_back( row );
+	}
+}
+
+
+void CombinedAutomaton::longestMatches( const std::string &line, size_t start, std::vector< size_t > &matchLengths ) const{
+//runs every machine over line from position start in a single pass
+//each machine takes edges for as long as it can, and it matches the characters it has read if it stops in an end state
+//args:
+// - line: the string being lexed
+// - start: position in line where the token begins
+// - matchLengths: set to the length each machine matched, or 0 if it rejected
+
+	matchLengths.assign( _tokenNames.size(), 0 );
+
+	int state = 0;
+	for ( size_t i = start; i < line.size(); i++ ){
+
+		int next = _transitions[state][(unsigned char) line[i]];
+		uint32_t nextAlive = ( next == -1 ) ? 0 : _alive[next];
+
+		/*machines that stop on this character match up to here if they were in an end state */
+		uint32_t stopped = _alive[state] & ~nextAlive & _accepting[state];
+		for ( unsigned int m = 0; stopped; m++, stopped >>= 1 ){
+
+			if ( stopped & 1 ) matchLengths[m] = i - start;
+		}
+
+		if ( next == -1 ) return;
+		state = next;
+	}
+
+	/*machines still running at the end of the line */
+	uint32_t finished = _alive[state] & _accepting[state];
+	for ( unsigned int m = 0; finished; m++, finished >>= 1 ){
+
+		if ( finished & 1 ) matchLengths[m] = line.size() - start;
 	}
-	return acceptedString;	
 }
 
 
@@ -139,92 +216,8 @@ std::set< char > setAlpha = {'A','B','C','D','E','F','G','H','I','J','K','L',
 
 std::set< char > setNumeric = {'0','1','2','3','4','5','6','7','8','9'};
 
-std::vector< Token * > scanLine( std::string &line, unsigned int lineNumber, unsigned int colNumber ){
-//scans a line (as a string) and lexes that line into tokens, returns the ordered tokens as a vector
-
-	std::vector< std::pair< FiniteStateAutomaton, std::string > > machTokenPairs= { std::make_pair( BeaconCheckTestMachine, "BeaconCheck" ),
-											std::make_pair( BeaconKillTestMachine, "BeaconKill" ),
-											std::make_pair( MessageSendTestMachine, "MessageSend" ),
-											std::make_pair( MessageReceiveTestMachine, "MessageReceive" ),
-											std::make_pair( ActionTestMachine, "Action" ),
-											std::make_pair( ProcessTestMachine, "Process" ),
-											std::make_pair( SetOperatorTestMachine, "SetOperation" ),
-											std::make_pair( VariableTestMachine, "Variable" ),
-											std::make_pair( DoubleTestMachine, "DoubleLiteral" ),				  
-											std::make_pair( IntTestMachine, "IntLiteral" ),
-											std::make_pair( WhitespaceTestMachine, "Whitespace" ),
-											std::make_pair( GateTestMachine, "Gate" ),
-											std::make_pair( ParameterTestMachine, "ParameterCondition" ),
-											std::make_pair( OperatorTestMachine, "Operator" ),
-											std::make_pair( ComparisonTestMachine, "Comparison" ),
-											std::make_pair( AssignmentTestMachine, "Assignment" ),
-											std::make_pair( ParenthesesTestMachine, "Parentheses" ),
-											std::make_pair( CommaTestMachine, "Comma" ),
-											std::make_pair( WildcardTestMachine, "Wildcard" ),
-											std::make_pair( MessagePrimitiveTestMachine, "MessagePrimitive" ),
-											std::make_pair( SemicolonTestMachine, "Semicolon" ) };
-
-	std::vector< Token * > tokenisedLine;
-	std::string testOutcome;
-
-	while ( not line.empty() ){
-
-		bool tokenFound = false;
-
-		for ( auto machine = machTokenPairs.begin(); machine < machTokenPairs.end(); machine++ ){
-
-			std::string testOutcome = ((*machine).first).testString( line );
-			if ( testOutcome != "" ){
-
-				/*ignore whitespace */
-				if ( (*machine).second == "Whitespace" ){
-
-					line = line.substr( testOutcome.size() );
-					colNumber += testOutcome.size();
-					tokenFound = true;
-				}
-				else if ( (*machine).second == "DoubleLiteral" and not line.substr( testOutcome.size() ).empty() ){
-
-					if (line.substr(testOutcome.size(), 1) == "."){
-
-						goto isARange;
-					}
-					else{
-
-						tokenisedLine.push_back( new Token( (*machine).second, testOutcome, lineNumber, colNumber ) );
-						line = line.substr( testOutcome.size() );
-						colNumber += testOutcome.size();
-						tokenFound = true;
-					}
-				}
-				else if ( (*machine).second == "Variable" and (testOutcome == "abs" or testOutcome == "min" or testOutcome == "max" or testOutcome == "sqrt") ){
-
-					tokenisedLine.push_back( new Token( "Function", testOutcome, lineNumber, colNumber ) );
-					line = line.substr( testOutcome.size() );
-					colNumber += testOutcome.size();
-					tokenFound = true;
-				}
-				else{
-
-					tokenisedLine.push_back( new Token( (*machine).second, testOutcome, lineNumber, colNumber ) );
-					line = line.substr( testOutcome.size() );
-					colNumber += testOutcome.size();
-					tokenFound = true;
-				}
-				break;
-			}
-			isARange: ;
-		}
-		if ( not tokenFound ) throw NoMachinePath( line, lineNumber, colNumber );
-	}
-	return tokenisedLine;
-};
-
-
-std::vector< std::vector< Token * > > scanSource( std::string &sourceFilename ){
-//main lexer function, calls scanLine on each line, contains definitions for automata to do the tokenisation
-//arguments:
-// - sourceFilename: a string that's the path to the source code
+static CombinedAutomaton buildTokenAutomaton( void ){
+//contains definitions for automata to do the tokenisation, and combines them into one automaton
 
 	/*MACHINES */
 
@@ -492,6 +485,89 @@ std::vector< std::vector< Token * > > scanSource( std::string &sourceFilename ){
 	BeaconKillTestMachine.add_edge( "q7", {'_',' ','^',',','+','-','*','.','(',')','/','"'}, "q7" );
 	BeaconKillTestMachine.add_edge( "q7", {'}'}, "endState" );
 
+	/*machines in priority order: where more than one machine matches, the first one in this list gives the token */
+	std::vector< std::pair< FiniteStateAutomaton *, std::string > > machTokenPairs= { std::make_pair( &BeaconCheckTestMachine, "BeaconCheck" ),
+											std::make_pair( &BeaconKillTestMachine, "BeaconKill" ),
+											std::make_pair( &MessageSendTestMachine, "MessageSend" ),
+											std::make_pair( &MessageReceiveTestMachine, "MessageReceive" ),
+											std::make_pair( &ActionTestMachine, "Action" ),
+											std::make_pair( &ProcessTestMachine, "Process" ),
+											std::make_pair( &SetOperatorTestMachine, "SetOperation" ),
+											std::make_pair( &VariableTestMachine, "Variable" ),
+											std::make_pair( &DoubleTestMachine, "DoubleLiteral" ),
+											std::make_pair( &IntTestMachine, "IntLiteral" ),
+											std::make_pair( &WhitespaceTestMachine, "Whitespace" ),
+											std::make_pair( &GateTestMachine, "Gate" ),
+											std::make_pair( &ParameterTestMachine, "ParameterCondition" ),
+											std::make_pair( &OperatorTestMachine, "Operator" ),
+											std::make_pair( &ComparisonTestMachine, "Comparison" ),
+											std::make_pair( &AssignmentTestMachine, "Assignment" ),
+											std::make_pair( &ParenthesesTestMachine, "Parentheses" ),
+											std::make_pair( &CommaTestMachine, "Comma" ),
+											std::make_pair( &WildcardTestMachine, "Wildcard" ),
+											std::make_pair( &MessagePrimitiveTestMachine, "MessagePrimitive" ),
+											std::make_pair( &SemicolonTestMachine, "Semicolon" ) };
+
+	return CombinedAutomaton( machTokenPairs );
+}
+
+
+std::vector< Token * > scanLine( std::string &line, unsigned int lineNumber, unsigned int colNumber ){
+//scans a line (as a string) and lexes that line into tokens, returns the ordered tokens as a vector
+
+	/*built the first time we lex anything */
+	static const CombinedAutomaton tokenAutomaton = buildTokenAutomaton();
+
+	std::vector< Token * > tokenisedLine;
+	std::vector< size_t > matchLengths;
+	size_t position = 0;
+
+	while ( position < line.size() ){
+
+		tokenAutomaton.longestMatches( line, position, matchLengths );
+
+		bool tokenFound = false;
+
+		for ( unsigned int machine = 0; machine < tokenAutomaton.numMachines(); machine++ ){
+
+			size_t matchLength = matchLengths[machine];
+			if ( matchLength == 0 ) continue;
+
+			const std::string &tokenName = tokenAutomaton.tokenName( machine );
+
+			/*a double literal followed by a dot is the start of a range, so leave it to the int machine */
+			if ( tokenName == "DoubleLiteral" and position + matchLength < line.size() and line[position + matchLength] == '.' ) continue;
+
+			/*ignore whitespace */
+			if ( tokenName != "Whitespace" ){
+
+				std::string testOutcome = line.substr( position, matchLength );
+
+				if ( tokenName == "Variable" and (testOutcome == "abs" or testOutcome == "min" or testOutcome == "max" or testOutcome == "sqrt") ){
+
+					tokenisedLine.push_back( new Token( "Function", testOutcome, lineNumber, colNumber ) );
+				}
+				else{
+
+					tokenisedLine.push_back( new Token( tokenName, testOutcome, lineNumber, colNumber ) );
+				}
+			}
+			position += matchLength;
+			colNumber += matchLength;
+			tokenFound = true;
+			break;
+		}
+		if ( not tokenFound ) throw NoMachinePath( line.substr( position ), lineNumber, colNumber );
+	}
+	return tokenisedLine;
+};
+
+
+std::vector< std::vector< Token * > > scanSource( std::string &sourceFilename ){
+//main lexer function, calls scanLine on each line
+//arguments:
+// - sourceFilename: a string that's the path to the source code
+
 	std::ifstream sourceFile( sourceFilename );
 
 	if ( not sourceFile.is_open() ) throw BadSourcePath();
@@ -525,7 +601,7 @@ std::vector< std::vector< Token * > > scanSource( std::string &sourceFilename ){
 
 		if ( (*t) -> identify() == "Semicolon" ){
 			
-			parsedTokenisation.push_back(running);
+			parsedTokenisation.push_back( std::move( running ) );
 			running.clear();
 		}
 		else{
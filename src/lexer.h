@@ -13,6 +13,8 @@
 #include <vector>
 #include <tuple>
 #include <set>
+#include <array>
+#include <cstdint>
 
 class Token{
 	
@@ -39,7 +41,7 @@ class FiniteStateAutomaton {
 	public:
 		void add_edge( std::string, std::set< char >, std::string );
 		void designate_endState( std::string );
-		std::string testString( std::string );
+		void compile( std::vector< std::array< int, 256 > > &, std::vector< bool > & ) const;
 		std::string startState = "startState";
 
 	private:
@@ -47,6 +49,23 @@ class FiniteStateAutomaton {
 		std::vector< std::string > endStates;
 };
 
+
+class CombinedAutomaton {
+//every token automaton run in lockstep as one DFA with integer states, built once from the product of the individual machines
+//state 0 is the start state, and a transition to -1 means that no machine can take that character
+
+	private:
+		std::vector< std::string > _tokenNames; //indexed by machine, in the order that machines take priority
+		std::vector< std::array< int, 256 > > _transitions;
+		std::vector< uint32_t > _alive, _accepting; //bitmasks over machines: still running, and sitting in an end state
+
+	public:
+		CombinedAutomaton( const std::vector< std::pair< FiniteStateAutomaton *, std::string > > & );
+		void longestMatches( const std::string &, size_t, std::vector< size_t > & ) const;
+		const std::string &tokenName( unsigned int m ) const { return _tokenNames[m]; }
+		unsigned int numMachines( void ) const { return _tokenNames.size(); }
+};
+
 std::vector< Token * > scanLine( std::string &, unsigned int, unsigned int );
 std::vector< std::vector< Token * > > scanSource( std::string & );
 
@@ -12,16 +12,28 @@
 #include <tuple>
 #include <utility>
 #include <iostream>
+#include <cstdio>
+#include <fstream>
 #include "../lexer.h"
 #include "../parser.h"
 #include "../simulator.h"
 #include "../common.h"
+#include "../model.h"
+#include "../kernels.h"
+#include "../fold.h"
+#include "../memo.h"
 
 
 static const char *help=
 "bcs simulates a stochastic model written in the Beacon Calculus.\n"
 "To run bcs, do:\n"
 "  ./bcs [arguments] -o simulationOutput sourceCode.bc\n"
+"The model can also be compiled once with:\n"
+"  ./bcs compile sourceCode.bc -o model.bcx\n"
+"and model.bcx given to bcs in place of the source code to skip parsing.\n"
+"C++ for a model can be generated with:\n"
+"  ./bcs --emit-cpp sourceCode.bc -o model.cpp\n"
+"and built against lib/libbcs.a (make lib) into a bcs executable that runs the model without a source file.\n"
 "Required arguments are:\n"
 "  -o,--output               output file name prefix,\n"
 "  -s,--simulations          number of simulations to run.\n"
@@ -29,6 +41,30 @@ static const char *help=
 "  -t,--threads              number of threads to use (default: 1),\n"
 "  -m,--maxTrans             maximum number of transitions allowed per simulation (default: 1000000),\n"
 "  -d,--maxDuration          maximum duration of each simulation(default: Inf),\n"
+"  -f,--format               output format, text or binary (default: text),\n"
+"  -z,--compress             compress the output in independently readable blocks (default: off),\n"
+"  --record                  action, channel, or process name to write (can be given more than once, default: all),\n"
+"  --ignore                  action, channel, or process name not to write (can be given more than once, default: none),\n"
+"  --sample-interval         write counts of live processes every this many time units instead of transitions,\n"
+"  --aggregate               write summary statistics of observables over all simulations (requires --sample-interval),\n"
+"  --observe                 process or observable name to summarise with --aggregate (can be given more than once),\n"
+"  --histogram               histogram of observables with --aggregate, given as lower:upper:bins,\n"
+"  --first-passage           only write the time each simulation met a stop condition in the model,\n"
+"  --sweep                   sweep a global variable over name=start:stop:step (can be given more than once),\n"
+"  --sweep-file              sweep global variables over the rows of a whitespace-delimited table with a header of names,\n"
+"  --checkpoint-every        checkpoint each simulation every this many transitions so that the run can be resumed,\n"
+"  --resume                  resume an interrupted run from its checkpoints (give the same arguments as the original run),\n"
+"  --burn-in                 simulate up to this time once and fork every simulation from the state it reached,\n"
+"  --burn-in-runs            number of separate burn-ins shared out between the simulations at each grid point (default: 1),\n"
+"  --profile                 time each phase of the simulation loop, print a report, and write it as JSON,\n"
+"  --metrics-every           sample candidate counts, the rate sum, and channel sizes every this many transitions,\n"
+"  --abc-data                infer global variables by ABC-SMC against observed values of observables in this file,\n"
+"  --prior                   prior for ABC as name=uniform:lower:upper or name=loguniform:lower:upper (can be given more than once),\n"
+"  --abc-particles           number of particles in each ABC generation (default: 1000),\n"
+"  --abc-generations         maximum number of ABC generations (default: 10),\n"
+"  --abc-quantile            quantile of the last generation's distances used as the next tolerance (default: 0.5),\n"
+"  --abc-tolerance           stop ABC once the tolerance reaches this value (default: 0),\n"
+"  --abc-min-acceptance      stop ABC once fewer than this fraction of simulations are accepted (default: 0.01),\n"
 "  -h,--help                 show useage information,\n"
 "  -v,--version              show version.\n";
 
@@ -36,11 +72,9 @@ static const char *help=
 struct Arguments {
 
 	std::string targetFilename;
-	std::string outputFilename;
-	int threads;
-	int numOfSimulations;
-	int maxTrans;
-	double maxDuration;
+	SimulationOptions options;
+	SweepGrid sweep;
+	ABCOptions abc;
 };
 
 
@@ -61,6 +95,68 @@ void showVersion(){
 }
 
 
+void compileModel( int argc, char** argv ){
+//bcs compile sourceCode.bc -o model.bcx
+
+	std::string sourceFilename, outputFilename;
+	for ( int i = 2; i < argc; i++ ){
+
+		std::string arg( argv[ i ] );
+		if ( ( arg == "-o" or arg == "--output" ) and i + 1 < argc ) outputFilename = argv[ ++i ];
+		else if ( sourceFilename.empty() ) sourceFilename = arg;
+		else{
+
+			std::cout << "Exiting with error.  Unrecognised argument to bcs compile: " << arg << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if ( sourceFilename.empty() or outputFilename.empty() ){
+
+		std::cout << "Exiting with error.  To compile a model, do: ./bcs compile sourceCode.bc -o model.bcx" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	CompiledModel model = parseModel( sourceFilename );
+	writeModel( model, outputFilename );
+}
+
+
+void emitModel( int argc, char** argv ){
+//bcs --emit-cpp sourceCode.bc -o model.cpp, which writes to stdout if -o isn't given
+
+	std::string sourceFilename, outputFilename;
+	for ( int i = 2; i < argc; i++ ){
+
+		std::string arg( argv[ i ] );
+		if ( ( arg == "-o" or arg == "--output" ) and i + 1 < argc ) outputFilename = argv[ ++i ];
+		else if ( sourceFilename.empty() ) sourceFilename = arg;
+		else{
+
+			std::cout << "Exiting with error.  Unrecognised argument to bcs --emit-cpp: " << arg << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if ( sourceFilename.empty() ){
+
+		std::cout << "Exiting with error.  To generate C++ for a model, do: ./bcs --emit-cpp sourceCode.bc -o model.cpp" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	CompiledModel model = parseModel( sourceFilename );
+	if ( outputFilename.empty() ){
+
+		emitCpp( model, std::cout );
+		return;
+	}
+
+	std::ofstream outFile( outputFilename );
+	if ( not outFile.is_open() ) throw BadOutputPath();
+	emitCpp( model, outFile );
+}
+
+
 Arguments parseArguments( int argc, char** argv ){
 
 	if( argc < 2 ){
@@ -84,12 +180,7 @@ Arguments parseArguments( int argc, char** argv ){
 
 	Arguments args;
 
-	/*defaults - we'll override these if the option was specified by the user */
-	args.outputFilename = "simulationOutput";
-	args.threads = 1;
-	args.numOfSimulations = 1;
-	args.maxTrans = 1000000;
-	args.maxDuration = std::numeric_limits<double>::max();
+	/*defaults are set in SimulationOptions - we'll override these if the option was specified by the user */
 
 	/*parse the command line arguments */
 	for ( int i = 1; i < argc; ){
@@ -99,33 +190,216 @@ Arguments parseArguments( int argc, char** argv ){
 		if ( flag == "-o" or flag == "--output" ){
 
 			std::string strArg( argv[ i + 1 ] );
-			args.outputFilename = strArg + ".simulation.bcs";
+			args.options.outputFilename = strArg + ".simulation.bcs";
+			args.options.observablesFilename = strArg + ".observables.bcs";
+			args.options.checkpointPrefix = strArg + ".checkpoint";
+			args.options.profileFilename = strArg + ".profile.json";
+			args.options.metricsFilename = strArg + ".metrics.bcs";
 			i+=2;	
 		}
 		else if ( flag == "-s" or flag == "--simulations" ){
 
 			std::string strArg( argv[ i + 1 ] );
-			args.numOfSimulations = atoi( strArg.c_str() );
+			args.options.numOfSimulations = atoi( strArg.c_str() );
 			i+=2;	
 		}
 		else if ( flag == "-m" or flag == "--maxTrans" ){
 
 			std::string strArg( argv[ i + 1 ] );
-			args.maxTrans = atoi( strArg.c_str() );
+			args.options.maxTransitions = atoi( strArg.c_str() );
 			i+=2;	
 		}
 		else if ( flag == "-d" or flag == "--maxDuration" ){
 
 			std::string strArg( argv[ i + 1 ] );
-			args.maxDuration = atof( strArg.c_str() );
+			args.options.maxDuration = atof( strArg.c_str() );
 			i+=2;	
 		}
 		else if ( flag == "-t" or flag == "--threads" ){
 
 			std::string strArg( argv[ i + 1 ] );
-			args.threads = atoi( strArg.c_str() );
+			args.options.threads = atoi( strArg.c_str() );
 			i+=2;	
 		}
+		else if ( flag == "-f" or flag == "--format" ){
+
+			std::string strArg( argv[ i + 1 ] );
+			if ( strArg == "text" ) args.options.outputFormat = TEXT_OUTPUT;
+			else if ( strArg == "binary" ) args.options.outputFormat = BINARY_OUTPUT;
+			else{
+
+				std::cout << "Exiting with error.  Output format must be text or binary." << std::endl;
+				showHelp();
+				exit(EXIT_FAILURE);
+			}
+			i+=2;
+		}
+		else if ( flag == "-z" or flag == "--compress" ){
+
+			args.options.compress = true;
+			i+=1;
+		}
+		else if ( flag == "--record" ){
+
+			args.options.recordNames.push_back( argv[ i + 1 ] );
+			i+=2;
+		}
+		else if ( flag == "--ignore" ){
+
+			args.options.ignoreNames.push_back( argv[ i + 1 ] );
+			i+=2;
+		}
+		else if ( flag == "--sample-interval" ){
+
+			std::string strArg( argv[ i + 1 ] );
+			args.options.sampleInterval = atof( strArg.c_str() );
+			if ( args.options.sampleInterval <= 0.0 ){
+
+				std::cout << "Exiting with error.  Sample interval must be greater than zero." << std::endl;
+				showHelp();
+				exit(EXIT_FAILURE);
+			}
+			i+=2;
+		}
+		else if ( flag == "--first-passage" ){
+
+			args.options.firstPassage = true;
+			i+=1;
+		}
+		else if ( flag == "--aggregate" ){
+
+			args.options.aggregate = true;
+			i+=1;
+		}
+		else if ( flag == "--observe" ){
+
+			args.options.observeProcesses.push_back( argv[ i + 1 ] );
+			i+=2;
+		}
+		else if ( flag == "--histogram" ){
+
+			std::string strArg( argv[ i + 1 ] );
+			HistogramOptions &ho = args.options.histogram;
+			if ( sscanf( strArg.c_str(), "%lf:%lf:%u", &ho.lower, &ho.upper, &ho.bins ) != 3 or ho.bins == 0 or ho.upper <= ho.lower ){
+
+				std::cout << "Exiting with error.  Histogram must be given as lower:upper:bins with upper > lower and bins > 0." << std::endl;
+				showHelp();
+				exit(EXIT_FAILURE);
+			}
+			ho.use = true;
+			i+=2;
+		}
+		else if ( flag == "--sweep" ){
+
+			args.sweep.addRange( argv[ i + 1 ] );
+			i+=2;
+		}
+		else if ( flag == "--sweep-file" ){
+
+			args.sweep.addFile( argv[ i + 1 ] );
+			i+=2;
+		}
+		else if ( flag == "--checkpoint-every" ){
+
+			args.options.checkpointEvery = atoi( argv[ i + 1 ] );
+			if ( args.options.checkpointEvery <= 0 ){
+
+				std::cout << "Exiting with error.  Checkpoint interval must be a positive number of transitions." << std::endl;
+				showHelp();
+				exit(EXIT_FAILURE);
+			}
+			i+=2;
+		}
+		else if ( flag == "--resume" ){
+
+			args.options.resume = true;
+			i+=1;
+		}
+		else if ( flag == "--burn-in" ){
+
+			args.options.burnIn = atof( argv[ i + 1 ] );
+			if ( args.options.burnIn <= 0.0 ){
+
+				std::cout << "Exiting with error.  Burn-in must be a positive duration." << std::endl;
+				showHelp();
+				exit(EXIT_FAILURE);
+			}
+			i+=2;
+		}
+		else if ( flag == "--burn-in-runs" ){
+
+			args.options.burnInRuns = atoi( argv[ i + 1 ] );
+			if ( args.options.burnInRuns <= 0 ){
+
+				std::cout << "Exiting with error.  Number of burn-ins must be a positive integer." << std::endl;
+				showHelp();
+				exit(EXIT_FAILURE);
+			}
+			i+=2;
+		}
+		else if ( flag == "--profile" ){
+
+			args.options.profile = true;
+			i+=1;
+		}
+		else if ( flag == "--metrics-every" ){
+
+			args.options.metricsEvery = atoi( argv[ i + 1 ] );
+			if ( args.options.metricsEvery <= 0 ){
+
+				std::cout << "Exiting with error.  Metrics interval must be a positive number of transitions." << std::endl;
+				showHelp();
+				exit(EXIT_FAILURE);
+			}
+			i+=2;
+		}
+		else if ( flag == "--abc-data" ){
+
+			args.abc.dataFilename = argv[ i + 1 ];
+			i+=2;
+		}
+		else if ( flag == "--prior" ){
+
+			args.abc.addPrior( argv[ i + 1 ] );
+			i+=2;
+		}
+		else if ( flag == "--abc-particles" ){
+
+			args.abc.particles = atoi( argv[ i + 1 ] );
+			i+=2;
+		}
+		else if ( flag == "--abc-generations" ){
+
+			args.abc.generations = atoi( argv[ i + 1 ] );
+			i+=2;
+		}
+		else if ( flag == "--abc-quantile" ){
+
+			args.abc.quantile = atof( argv[ i + 1 ] );
+			if ( args.abc.quantile <= 0.0 or args.abc.quantile >= 1.0 ){
+
+				std::cout << "Exiting with error.  ABC quantile must be between 0 and 1." << std::endl;
+				showHelp();
+				exit(EXIT_FAILURE);
+			}
+			i+=2;
+		}
+		else if ( flag == "--abc-tolerance" ){
+
+			args.abc.finalTolerance = atof( argv[ i + 1 ] );
+			i+=2;
+		}
+		else if ( flag == "--abc-min-acceptance" ){
+
+			args.abc.minAcceptance = atof( argv[ i + 1 ] );
+			if ( args.abc.minAcceptance <= 0.0 or args.abc.minAcceptance > 1.0 ){
+
+				std::cout << "Exiting with error.  ABC minimum acceptance must be greater than 0 and at most 1." << std::endl;
+				showHelp();
+				exit(EXIT_FAILURE);
+			}
+			i+=2;
+		}
 		else if ( flag == "-h" or flag == "--help" ){
 
 			showHelp();
@@ -151,37 +425,93 @@ Arguments parseArguments( int argc, char** argv ){
 		}
 	}
 
+	if ( args.options.aggregate and ( args.options.sampleInterval <= 0.0 or args.options.observeProcesses.empty() ) ){
+
+		std::cout << "Exiting with error.  Aggregation needs a sampling grid (--sample-interval) and at least one observable (--observe)." << std::endl;
+		showHelp();
+		exit(EXIT_FAILURE);
+	}
+
+	if ( args.options.aggregate and args.options.firstPassage ){
+
+		std::cout << "Exiting with error.  Only one of --aggregate and --first-passage can be used." << std::endl;
+		showHelp();
+		exit(EXIT_FAILURE);
+	}
+
+	if ( ( args.options.checkpointEvery > 0 or args.options.resume ) and ( args.options.aggregate or not args.abc.dataFilename.empty() or args.options.metricsEvery > 0 ) ){
+
+		std::cout << "Exiting with error.  Checkpoints can't be used with --aggregate, --metrics-every, or ABC inference." << std::endl;
+		showHelp();
+		exit(EXIT_FAILURE);
+	}
+
+	if ( not args.abc.dataFilename.empty() and ( args.options.aggregate or args.options.firstPassage or not args.sweep.empty() or args.options.burnIn > 0.0 or args.options.metricsEvery > 0 ) ){
+
+		std::cout << "Exiting with error.  ABC inference can't be used with --aggregate, --first-passage, --sweep, --burn-in, or --metrics-every." << std::endl;
+		showHelp();
+		exit(EXIT_FAILURE);
+	}
+
 	return args;
 }
 
 
 int main( int argc, char** argv ){
 
+	if ( argc > 1 and std::string( argv[ 1 ] ) == "compile" ){
+
+		compileModel( argc, argv );
+		return 0;
+	}
+
+	if ( argc > 1 and std::string( argv[ 1 ] ) == "--emit-cpp" ){
+
+		emitModel( argc, argv );
+		return 0;
+	}
+
 	Arguments args = parseArguments( argc, argv );
 
-	/*call lexer */
-	std::vector< std::vector< Token * > > tokenisedSource = scanSource( args.targetFilename );
+	/*parse the source code, or read the model if it was already compiled */
+	/*executables built from bcs --emit-cpp carry their own model, which is used unless they're given another one */
+	CompiledModel model;
+	if ( args.targetFilename.empty() and linkedModel() ){
 
-#if DEBUG
-std::cout << "Finished lexer." << std::endl;
-#endif
+		//foldConstants isn't run on a linked model: its kernels were generated for the expressions as they were written, and installKernels
+		//finds each one by the expression it replaces, so folding them here would leave every expression to the interpreter
+		model = readModel( (const char *) linkedModel() -> data, linkedModel() -> size );
+		installKernels( model );
+	}
+	else{
 
-	/*call token parser */
-	auto parsedSource = parseSource( tokenisedSource );
+		model = loadModel( args.targetFilename );
 
-#if DEBUG
-std::cout << "Finished parser." << std::endl;
-#endif
+		/*substitute global variables that are the same in every simulation into the model's expressions */
+		std::set< std::string > variableGlobals = args.sweep.names();
+		for ( auto p = args.abc.priors.begin(); p < args.abc.priors.end(); p++ ) variableGlobals.insert( p -> name );
+		foldConstants( model, variableGlobals );
+	}
+	findExpressionReads( model );
+	std::vector< ObservableDefinition > &observables = model.observables;
+	std::vector< StopCondition > &stopConditions = model.stopConditions;
 
-	/*call block parser */
-	auto blockParsed = secondPassParse( std::get<0>(parsedSource), std::get<1>(parsedSource), std::get<2>(parsedSource) );
+	if ( args.options.firstPassage and stopConditions.empty() ){
 
-#if DEBUG
-std::cout << "Finished block parser." << std::endl;
-#endif
+		std::cout << "Exiting with error.  First passage mode needs at least one stop condition (stop when ...) in the model." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	/*infer global variables from observed data instead of writing simulations */
+	if ( not args.abc.dataFilename.empty() ){
+
+		runABC( model.processDefinitions, model.systemLine, model.globalVars, observables, stopConditions, args.options, args.abc );
+		return 0;
+	}
 
 	/*call the simulator */
-	simulateSystem( blockParsed.first, blockParsed.second, std::get<2>(parsedSource), args.numOfSimulations, args.threads, args.outputFilename, args.maxTrans, args.maxDuration );
+	std::vector< GridPoint > grid = args.sweep.build( model.processDefinitions, model.systemLine, model.system, model.globalVars );
+	simulateSystem( model.processDefinitions, grid, observables, stopConditions, args.options );
 
 #if DEBUG
 std::cout << "Finished simulation." << std::endl;
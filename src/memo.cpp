@@ -0,0 +1,219 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <cstring>
+#include <algorithm>
+#include "memo.h"
+#include "model.h"
+#include "evaluate_trees.h"
+#include "kernels.h"
+
+
+static bool readsOf( const std::vector< Token * > &rpn, std::vector< std::string > &reads ){
+//the distinct variables an expression reads, in the order they first appear
+//returns false for anything whose value might depend on more than the variables it names (sets, wildcards)
+
+	reads.clear();
+	for ( auto t = rpn.begin(); t < rpn.end(); t++ ){
+
+		std::string kind = (*t) -> identify();
+		if ( kind == "Variable" ){
+
+			if ( std::find( reads.begin(), reads.end(), (*t) -> value() ) == reads.end() ) reads.push_back( (*t) -> value() );
+		}
+		else if ( kind != "IntLiteral" and kind != "DoubleLiteral" and kind != "Operator" and kind != "Function" and kind != "Comparison" ) return false;
+	}
+	return reads.size() <= MEMO_MAX_READS;
+}
+
+
+static void specialise( Block *b, const std::vector< Token * > &rpn, const std::vector< std::string > &reads, bool condition ){
+//expressions with native code from bcs --emit-cpp are left to it
+
+	if ( findKernel( rpn ) ) return;
+	std::vector< TypedProgram > programs = specialiseExpression( rpn, reads, condition );
+	b -> setTypedPrograms( programs );
+}
+
+
+void findExpressionReads( CompiledModel &model ){
+//dependency analysis for the memo: each rate and gate condition that can be memoised gets a slot and the list of variables it reads,
+//and a typed program for each combination of types those variables can have to evaluate it with when it isn't in the memo
+//run once the model's expressions are in their final form, since folding changes what they read
+
+	unsigned int slot = 0;
+	std::vector< std::string > reads;
+	for ( auto pd = model.processDefinitions.begin(); pd != model.processDefinitions.end(); pd++ ){
+
+		std::vector< Block * > nodes = (pd -> second).parseTree.getNodes();
+		for ( auto b = nodes.begin(); b < nodes.end(); b++ ){
+
+			std::string kind = (*b) -> identify();
+			if ( kind == "Gate" ){
+
+				std::vector< Token * > condition = static_cast< GateBlock * >( *b ) -> getConditionExpression();
+				if ( not readsOf( condition, reads ) ) continue;
+				(*b) -> setMemoReads( slot++, reads );
+				specialise( *b, condition, reads, true );
+			}
+			else if ( ( kind == "Action" or kind == "MessageReceive" or kind == "MessageSend" ) and not (*b) -> hasConstantRate() ){
+
+				std::vector< Token * > rate = (*b) -> getRate();
+				if ( not readsOf( rate, reads ) ) continue;
+				(*b) -> setMemoReads( slot++, reads );
+				specialise( *b, rate, reads, false );
+			}
+		}
+	}
+}
+
+
+static uint64_t mix( uint64_t h ){
+//finaliser from splitmix64
+
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h;
+}
+
+
+bool ExpressionMemo::key( Block *b, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables, MemoEntry &k, TypedValue *values ) const {
+//fills in the key for this block under these values, with the same order of precedence as substituteVariable, and the values themselves
+//in the form the block's typed programs read them
+//returns false if a variable isn't defined, so that the interpreter can report it
+
+	const std::vector< std::string > &reads = b -> getMemoReads();
+	k.slot = b -> getMemoSlot() + 1;
+	k.intReads = 0;
+	memset( k.values, 0, sizeof( k.values ) );
+	for ( unsigned int i = 0; i < reads.size(); i++ ){
+
+		Numerical n;
+		auto local = localVariables.find( reads[i] );
+		if ( local != localVariables.end() ) n = local -> second;
+		else{
+
+			auto global = globalVariables.values.find( reads[i] );
+			if ( global != globalVariables.values.end() ) n = global -> second;
+			else{
+
+				auto param = param2value.values.find( reads[i] );
+				if ( param == param2value.values.end() ) return false;
+				n = param -> second;
+			}
+		}
+
+		if ( n.isInt() ){
+
+			k.intReads |= 1u << i;
+			k.values[i] = (uint64_t) (int64_t) n.getInt();
+			values[i].i = n.getInt();
+		}
+		else{
+
+			double d = n.getDouble();
+			memcpy( &k.values[i], &d, sizeof( double ) );
+			values[i].d = d;
+		}
+	}
+	return true;
+}
+
+
+MemoEntry &ExpressionMemo::probe( const MemoEntry &k, bool &found ){
+//linear probing from the key's hash - returns the matching entry, or the empty entry where it would go
+
+	if ( _table.empty() ) _table.resize( MEMO_TABLE_SIZE );
+
+	uint64_t h = k.slot;
+	for ( unsigned int i = 0; i < MEMO_MAX_READS; i++ ) h = mix( h ^ k.values[i] );
+
+	size_t mask = MEMO_TABLE_SIZE - 1;
+	for ( size_t i = h & mask; ; i = ( i + 1 ) & mask ){
+
+		MemoEntry &e = _table[i];
+		if ( e.slot == 0 ){
+
+			found = false;
+			return e;
+		}
+		if ( e.slot == k.slot and e.intReads == k.intReads and memcmp( e.values, k.values, sizeof( k.values ) ) == 0 ){
+
+			found = true;
+			return e;
+		}
+	}
+}
+
+
+void ExpressionMemo::insert( MemoEntry &e, const MemoEntry &k, Numerical result ){
+//the table is emptied rather than grown once it's three quarters full, so models that keep reaching new values don't use more memory
+
+	if ( 4 * ( _used + 1 ) > 3 * MEMO_TABLE_SIZE ){
+
+		clear();
+		bool found;
+		MemoEntry &fresh = probe( k, found );
+		fresh = k;
+		fresh.result = result;
+		_used = 1;
+		return;
+	}
+	e = k;
+	e.result = result;
+	_used++;
+}
+
+
+Numerical ExpressionMemo::rate( Block *b, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables ){
+
+	if ( b -> hasConstantRate() or not b -> isMemoised() ) return evalRate( b, param2value, globalVariables, localVariables );
+
+	MemoEntry k;
+	TypedValue values[ MEMO_MAX_READS ];
+	if ( not key( b, param2value, globalVariables, localVariables, k, values ) ) return evalRate( b, param2value, globalVariables, localVariables );
+
+	bool found;
+	MemoEntry &e = probe( k, found );
+	if ( found ) return e.result;
+
+	Numerical result = b -> isTyped() ? b -> getTypedProgram( k.intReads ).evaluate( values ) : evalRate( b, param2value, globalVariables, localVariables );
+	insert( e, k, result );
+	return result;
+}
+
+
+bool ExpressionMemo::condition( GateBlock *gb, ParameterValues &param2value, GlobalVariables &globalVariables, std::map< std::string, Numerical > &localVariables ){
+
+	if ( not gb -> isMemoised() ) return evalRPN_condition( gb -> getConditionExpression(), param2value, globalVariables, localVariables );
+
+	MemoEntry k;
+	TypedValue values[ MEMO_MAX_READS ];
+	if ( not key( gb, param2value, globalVariables, localVariables, k, values ) ) return evalRPN_condition( gb -> getConditionExpression(), param2value, globalVariables, localVariables );
+
+	bool found;
+	MemoEntry &e = probe( k, found );
+	if ( found ) return e.result.getInt();
+
+	bool holds = gb -> isTyped() ? gb -> getTypedProgram( k.intReads ).holds( values ) : evalRPN_condition( gb -> getConditionExpression(), param2value, globalVariables, localVariables );
+	Numerical result;
+	result.setInt( holds );
+	insert( e, k, result );
+	return holds;
+}
+
+
+void ExpressionMemo::clear( void ){
+
+	if ( _used == 0 ) return;
+	for ( auto e = _table.begin(); e < _table.end(); e++ ) e -> slot = 0;
+	_used = 0;
+}
@@ -0,0 +1,56 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include "blockParser.h"
+
+struct CompiledModel;
+
+#define MEMO_MAX_READS 4 //rates and gates that read more variables than this are always evaluated
+#define MEMO_TABLE_SIZE 1024 //entries in the memo table - must be a power of two
+
+
+struct MemoEntry{
+//a rate or gate value, keyed by the memo slot of its block and the values of the variables its expression reads
+
+	unsigned int slot = 0; //one more than the block's memo slot, or zero if the entry is empty
+	unsigned int intReads = 0; //bit i is set if the value of read i is an int
+	uint64_t values[ MEMO_MAX_READS ];
+	Numerical result;
+};
+
+
+class ExpressionMemo{
+//rates and gate conditions that have already been evaluated during one simulation
+//entries are keyed by the values of the variables that an expression reads, wherever they're found, so they stay correct for every
+//clone and every process that reaches the same block with the same bound values
+
+	private:
+		std::vector< MemoEntry > _table;
+		size_t _used = 0;
+		bool key( Block *, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > &, MemoEntry &, TypedValue * ) const;
+		MemoEntry &probe( const MemoEntry &, bool & );
+		void insert( MemoEntry &, const MemoEntry &, Numerical );
+
+	public:
+		Numerical rate( Block *, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > & );
+		bool condition( GateBlock *, ParameterValues &, GlobalVariables &, std::map< std::string, Numerical > & );
+		void clear( void );
+};
+
+
+/*function prototypes */
+void findExpressionReads( CompiledModel & );
+
+#endif
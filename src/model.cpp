@@ -0,0 +1,611 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+//#define DEBUG 1
+
+#include <fstream>
+#include <tuple>
+#include <utility>
+#include <cstring>
+#include <iterator>
+#include "model.h"
+#include "lexer.h"
+#include "error_handling.h"
+
+
+/*MODEL WRITER-------------------------------------------------------------------------------------------------------------------------------------------------------*/
+void ModelWriter::strings( const std::vector< std::string > &s ){
+
+	varint( s.size() );
+	for ( auto i = s.begin(); i < s.end(); i++ ) string( *i );
+}
+
+
+void ModelWriter::token( Token *t ){
+//0 is a null token, otherwise the token's place in the table plus one
+
+	if ( t == NULL ){
+
+		varint( 0 );
+		return;
+	}
+
+	auto found = _tokenIndex.find( t );
+	if ( found == _tokenIndex.end() ){
+
+		found = _tokenIndex.insert( std::make_pair( t, (unsigned int) _tokens.size() ) ).first;
+		_tokens.push_back( t );
+	}
+	varint( found -> second + 1 );
+}
+
+
+void ModelWriter::tokens( const std::vector< Token * > &ts ){
+
+	varint( ts.size() );
+	for ( auto t = ts.begin(); t < ts.end(); t++ ) token( *t );
+}
+
+
+void ModelWriter::tokenLists( const std::vector< std::vector< Token * > > &lists ){
+
+	varint( lists.size() );
+	for ( auto l = lists.begin(); l < lists.end(); l++ ) tokens( *l );
+}
+
+
+void ModelWriter::writeTokenTable( std::string &out ) const{
+//the handful of token types are written once and each token refers to its type by index
+
+	std::map< std::string, unsigned int > identityIndex;
+	std::vector< std::string > identities;
+	for ( auto t = _tokens.begin(); t < _tokens.end(); t++ ){
+
+		if ( identityIndex.count( (*t) -> identify() ) == 0 ){
+
+			identityIndex[ (*t) -> identify() ] = identities.size();
+			identities.push_back( (*t) -> identify() );
+		}
+	}
+
+	writeVarint( out, identities.size() );
+	for ( auto i = identities.begin(); i < identities.end(); i++ ) writeString( out, *i );
+
+	writeVarint( out, _tokens.size() );
+	for ( auto t = _tokens.begin(); t < _tokens.end(); t++ ){
+
+		writeVarint( out, identityIndex[ (*t) -> identify() ] );
+		writeString( out, (*t) -> value() );
+		writeVarint( out, (*t) -> getLine() );
+		writeVarint( out, (*t) -> getColumn() );
+	}
+}
+
+
+/*MODEL READER-------------------------------------------------------------------------------------------------------------------------------------------------------*/
+uint64_t ModelReader::varint( void ){
+
+	uint64_t v = 0;
+	if ( _ok and not readVarint( _data, _size, _pos, v ) ) _ok = false;
+	return _ok ? v : 0;
+}
+
+
+uint64_t ModelReader::count( void ){
+//number of items that follow, each of which takes at least a byte, so a corrupt count can't ask for more than the file holds
+
+	uint64_t n = varint();
+	if ( n > _size - _pos ) _ok = false;
+	return _ok ? n : 0;
+}
+
+
+std::string ModelReader::string( void ){
+
+	std::string s;
+	if ( _ok and not readString( _data, _size, _pos, s ) ) _ok = false;
+	return s;
+}
+
+
+std::vector< std::string > ModelReader::strings( void ){
+
+	std::vector< std::string > s;
+	uint64_t n = count();
+	for ( uint64_t i = 0; i < n and _ok; i++ ) s.push_back( string() );
+	return s;
+}
+
+
+Token *ModelReader::token( void ){
+
+	uint64_t i = varint();
+	if ( i == 0 ) return NULL;
+	if ( i > _tokens.size() ){
+
+		_ok = false;
+		return NULL;
+	}
+	return _tokens[i - 1];
+}
+
+
+std::vector< Token * > ModelReader::tokens( void ){
+
+	std::vector< Token * > ts;
+	uint64_t n = count();
+	ts.reserve( n );
+	for ( uint64_t i = 0; i < n and _ok; i++ ) ts.push_back( token() );
+	return ts;
+}
+
+
+std::vector< std::vector< Token * > > ModelReader::tokenLists( void ){
+
+	std::vector< std::vector< Token * > > lists;
+	uint64_t n = count();
+	for ( uint64_t i = 0; i < n and _ok; i++ ) lists.push_back( tokens() );
+	return lists;
+}
+
+
+void ModelReader::numericals( std::map< std::string, Numerical > &values ){
+
+	if ( _ok and not readNumericalMap( _data, _size, _pos, values ) ) _ok = false;
+}
+
+
+void ModelReader::readMagic( void ){
+
+	size_t magicLength = strlen( MODEL_MAGIC );
+	if ( _size < magicLength or memcmp( _data, MODEL_MAGIC, magicLength ) != 0 ) throw BadModelFile( "this is not a compiled bcs model." );
+	_pos = magicLength;
+	if ( varint() != MODEL_FORMAT_VERSION ) throw BadModelFile( "this model was compiled by a different version of bcs - compile it again." );
+}
+
+
+void ModelReader::readTokenTable( void ){
+
+	std::vector< std::string > identities = strings();
+
+	uint64_t n = count();
+	_tokens.reserve( n );
+	for ( uint64_t i = 0; i < n and _ok; i++ ){
+
+		uint64_t identity = varint();
+		std::string raw = string();
+		unsigned int line = varint();
+		unsigned int column = varint();
+		if ( identity >= identities.size() ) _ok = false;
+		if ( not _ok ) break;
+		_tokens.push_back( new Token( identities[identity], raw, line, column ) );
+	}
+}
+
+
+/*BLOCK STATE--------------------------------------------------------------------------------------------------------------------------------------------------------*/
+void Block::writeState( ModelWriter &out ) const{
+
+	out.token( inputToken );
+	out.varint( _blockID );
+}
+
+
+void Block::readState( ModelReader &in ){
+
+	inputToken = in.token();
+	_blockID = in.varint();
+}
+
+
+void ActionBlock::writeState( ModelWriter &out ) const{
+
+	Block::writeState( out );
+	out.string( _owningProcess );
+	out.token( _underlyingToken );
+	out.tokens( _RPNrate );
+	out.string( actionName );
+}
+
+
+void ActionBlock::readState( ModelReader &in ){
+
+	Block::readState( in );
+	_owningProcess = in.string();
+	_underlyingToken = in.token();
+	_RPNrate = in.tokens();
+	actionName = in.string();
+}
+
+
+void ChoiceBlock::writeState( ModelWriter &out ) const{
+
+	Block::writeState( out );
+	out.string( _owningProcess );
+	out.token( _underlyingToken );
+}
+
+
+void ChoiceBlock::readState( ModelReader &in ){
+
+	Block::readState( in );
+	_owningProcess = in.string();
+	_underlyingToken = in.token();
+}
+
+
+void ParallelBlock::writeState( ModelWriter &out ) const{
+
+	Block::writeState( out );
+	out.string( _owningProcess );
+	out.token( _underlyingToken );
+}
+
+
+void ParallelBlock::readState( ModelReader &in ){
+
+	Block::readState( in );
+	_owningProcess = in.string();
+	_underlyingToken = in.token();
+}
+
+
+void GateBlock::writeState( ModelWriter &out ) const{
+
+	Block::writeState( out );
+	out.string( _owningProcess );
+	out.token( _underlyingToken );
+	out.tokens( _RPNexpression );
+}
+
+
+void GateBlock::readState( ModelReader &in ){
+
+	Block::readState( in );
+	_owningProcess = in.string();
+	_underlyingToken = in.token();
+	_RPNexpression = in.tokens();
+}
+
+
+void MessageReceiveBlock::writeState( ModelWriter &out ) const{
+
+	Block::writeState( out );
+	out.varint( _handshake | (_check << 1) | (_usesSets << 2) | (_hasBindingVar << 3) );
+	out.string( _owningProcess );
+	out.token( _underlyingToken );
+	out.tokenLists( _channelNames );
+	out.strings( _bindingVariables );
+	out.tokenLists( _RPNexpressions );
+	out.tokens( _RPNrate );
+}
+
+
+void MessageReceiveBlock::readState( ModelReader &in ){
+
+	Block::readState( in );
+	uint64_t flags = in.varint();
+	_handshake = flags & 1;
+	_check = flags & 2;
+	_usesSets = flags & 4;
+	_hasBindingVar = flags & 8;
+	_owningProcess = in.string();
+	_underlyingToken = in.token();
+	_channelNames = in.tokenLists();
+	_bindingVariables = in.strings();
+	_RPNexpressions = in.tokenLists();
+	_RPNrate = in.tokens();
+}
+
+
+void MessageSendBlock::writeState( ModelWriter &out ) const{
+
+	Block::writeState( out );
+	out.varint( _handshake | (_kill << 1) );
+	out.string( _owningProcess );
+	out.token( _underlyingToken );
+	out.tokenLists( _channelNames );
+	out.tokenLists( _RPNexpressions );
+	out.tokens( _RPNrate );
+}
+
+
+void MessageSendBlock::readState( ModelReader &in ){
+
+	Block::readState( in );
+	uint64_t flags = in.varint();
+	_handshake = flags & 1;
+	_kill = flags & 2;
+	_owningProcess = in.string();
+	_underlyingToken = in.token();
+	_channelNames = in.tokenLists();
+	_RPNexpressions = in.tokenLists();
+	_RPNrate = in.tokens();
+}
+
+
+void ProcessBlock::writeState( ModelWriter &out ) const{
+
+	Block::writeState( out );
+	out.string( _processName );
+	out.string( _owningProcess );
+	out.tokenLists( _parameterExpressions );
+	out.token( _underlyingToken );
+}
+
+
+void ProcessBlock::readState( ModelReader &in ){
+
+	Block::readState( in );
+	_processName = in.string();
+	_owningProcess = in.string();
+	_parameterExpressions = in.tokenLists();
+	_underlyingToken = in.token();
+}
+
+
+static Block *newBlock( const std::string &kind ){
+//an empty block of the kind named by identify(), for readState to fill in
+
+	if ( kind == "Action" ) return new ActionBlock();
+	else if ( kind == "Choice" ) return new ChoiceBlock();
+	else if ( kind == "Parallel" ) return new ParallelBlock();
+	else if ( kind == "Gate" ) return new GateBlock();
+	else if ( kind == "MessageReceive" ) return new MessageReceiveBlock();
+	else if ( kind == "MessageSend" ) return new MessageSendBlock();
+	else if ( kind == "Process" ) return new ProcessBlock();
+	return NULL;
+}
+
+
+/*COMPILED MODELS----------------------------------------------------------------------------------------------------------------------------------------------------*/
+CompiledModel parseModel( std::string &sourceFilename ){
+//runs the lexer and both passes of the parser on a .bc source file
+
+	CompiledModel model;
+
+	/*call lexer */
+	std::vector< std::vector< Token * > > tokenisedSource = scanSource( sourceFilename );
+
+#if DEBUG
+std::cout << "Finished lexer." << std::endl;
+#endif
+
+	/*call token parser */
+	auto parsedSource = parseSource( tokenisedSource );
+
+#if DEBUG
+std::cout << "Finished parser." << std::endl;
+#endif
+
+	/*call block parser */
+	auto blockParsed = secondPassParse( std::get<0>(parsedSource), std::get<1>(parsedSource), std::get<2>(parsedSource) );
+
+#if DEBUG
+std::cout << "Finished block parser." << std::endl;
+#endif
+
+	model.processDefinitions = std::move( blockParsed.first );
+	model.system = std::move( blockParsed.second );
+	model.systemLine = std::move( std::get<1>(parsedSource) );
+	model.globalVars = std::get<2>(parsedSource);
+
+	/*build the observables and stop conditions declared in the model */
+	model.observables = parseObservables( std::get<3>(parsedSource), model.processDefinitions, model.globalVars );
+	model.stopConditions = parseStopConditions( std::get<3>(parsedSource), model.observables, model.processDefinitions, model.globalVars );
+
+	return model;
+}
+
+
+std::string serialiseModel( CompiledModel &model ){
+//serialises a parsed model so that later runs can skip the lexer and parser
+//process definitions are written node by node in tree order, each with the index of its parent, so that reading them back
+//rebuilds the same trees; processes in the initial system refer to their definition by name and share its blocks
+
+	ModelWriter out;
+
+	out.numericals( model.globalVars.values );
+
+	std::map< Block *, std::string > root2Name;
+	out.varint( model.processDefinitions.size() );
+	for ( auto pd = model.processDefinitions.begin(); pd != model.processDefinitions.end(); pd++ ){
+
+		Tree< Block > &tree = (pd -> second).parseTree;
+		root2Name[ tree.getRoot() ] = pd -> first;
+
+		out.string( pd -> first );
+		out.strings( (pd -> second).parameters );
+
+		std::vector< Block * > nodes = tree.getNodes();
+		std::map< Block *, unsigned int > nodeIndex;
+		out.varint( nodes.size() );
+		for ( unsigned int i = 0; i < nodes.size(); i++ ){
+
+			nodeIndex[ nodes[i] ] = i;
+			out.varint( tree.isRoot( nodes[i] ) ? 0 : nodeIndex.at( tree.getParent( nodes[i] ) ) );
+			out.string( nodes[i] -> identify() );
+			nodes[i] -> writeState( out );
+		}
+	}
+
+	out.varint( model.systemLine.size() );
+	for ( auto term = model.systemLine.begin(); term < model.systemLine.end(); term++ ){
+
+		out.token( term -> process );
+		out.token( term -> multiplier );
+		out.string( term -> processName );
+		out.tokens( term -> parameters );
+	}
+
+	out.varint( model.system.size() );
+	for ( auto sp = model.system.begin(); sp != model.system.end(); sp++ ){
+
+		out.string( root2Name.at( (sp -> parseTree).getRoot() ) );
+		out.varint( sp -> clones );
+		out.numericals( (sp -> parameterValues).values );
+		out.numericals( sp -> localVariables );
+	}
+
+	out.varint( model.observables.size() );
+	for ( auto o = model.observables.begin(); o < model.observables.end(); o++ ){
+
+		out.string( o -> name );
+		out.string( o -> processName );
+		out.strings( o -> bindingNames );
+		out.tokens( o -> RPNcondition );
+	}
+
+	out.varint( model.stopConditions.size() );
+	for ( auto sc = model.stopConditions.begin(); sc < model.stopConditions.end(); sc++ ){
+
+		out.tokens( sc -> RPNcondition );
+		out.varint( (sc -> observables).size() );
+		for ( auto i = (sc -> observables).begin(); i < (sc -> observables).end(); i++ ) out.varint( *i );
+		out.strings( sc -> actionNames );
+	}
+
+	std::string file = MODEL_MAGIC;
+	writeVarint( file, MODEL_FORMAT_VERSION );
+	out.writeTokenTable( file );
+	file += out.body;
+	return file;
+}
+
+
+void writeModel( CompiledModel &model, std::string filename ){
+
+	std::string file = serialiseModel( model );
+	std::ofstream modelFile( filename, std::ios::binary );
+	if ( not modelFile.is_open() ) throw BadOutputPath();
+	modelFile.write( file.data(), file.size() );
+	if ( not modelFile.good() ) throw BadOutputPath();
+}
+
+
+CompiledModel readModel( const char *data, size_t size ){
+//reads a model written by writeModel from memory
+
+	CompiledModel model;
+	ModelReader in( data, size );
+
+	in.readMagic();
+	in.readTokenTable();
+
+	in.numericals( model.globalVars.values );
+
+	uint64_t numDefinitions = in.count();
+	for ( uint64_t d = 0; d < numDefinitions and in.ok(); d++ ){
+
+		std::string name = in.string();
+		ProcessDefinition &pd = model.processDefinitions[ name ];
+		pd.parameters = in.strings();
+
+		std::vector< Block * > nodes;
+		uint64_t numNodes = in.count();
+		for ( uint64_t i = 0; i < numNodes and in.ok(); i++ ){
+
+			uint64_t parent = in.varint();
+			Block *b = newBlock( in.string() );
+			if ( b == NULL or ( i > 0 and parent >= i ) ){
+
+				in.fail();
+				break;
+			}
+			b -> readState( in );
+
+			if ( i == 0 ) pd.parseTree.setRoot( b );
+			else pd.parseTree.addChild( nodes[parent], b );
+			nodes.push_back( b );
+		}
+		if ( nodes.empty() ) in.fail();
+	}
+
+	uint64_t numTerms = in.count();
+	for ( uint64_t i = 0; i < numTerms and in.ok(); i++ ){
+
+		SystemLineTerm term;
+		term.process = in.token();
+		term.multiplier = in.token();
+		term.processName = in.string();
+		term.parameters = in.tokens();
+		if ( term.process == NULL ) in.fail();
+		model.systemLine.push_back( std::move( term ) );
+	}
+
+	uint64_t numProcesses = in.count();
+	for ( uint64_t i = 0; i < numProcesses and in.ok(); i++ ){
+
+		auto pd = model.processDefinitions.find( in.string() );
+		if ( pd == model.processDefinitions.end() ){
+
+			in.fail();
+			break;
+		}
+
+		SystemProcess sp;
+		sp.parseTree = (pd -> second).parseTree;
+		sp.clones = in.varint();
+		in.numericals( sp.parameterValues.values );
+		in.numericals( sp.localVariables );
+		model.system.push_back( sp );
+	}
+
+	uint64_t numObservables = in.count();
+	for ( uint64_t i = 0; i < numObservables and in.ok(); i++ ){
+
+		ObservableDefinition o;
+		o.name = in.string();
+		o.processName = in.string();
+		o.bindingNames = in.strings();
+		o.RPNcondition = in.tokens();
+		model.observables.push_back( o );
+	}
+
+	uint64_t numStopConditions = in.count();
+	for ( uint64_t i = 0; i < numStopConditions and in.ok(); i++ ){
+
+		StopCondition sc;
+		sc.RPNcondition = in.tokens();
+		uint64_t numUsed = in.count();
+		for ( uint64_t j = 0; j < numUsed and in.ok(); j++ ){
+
+			uint64_t observable = in.varint();
+			if ( observable >= model.observables.size() ) in.fail();
+			sc.observables.push_back( observable );
+		}
+		sc.actionNames = in.strings();
+		model.stopConditions.push_back( sc );
+	}
+
+	if ( not in.ok() or not in.atEnd() ) throw BadModelFile( "the file is truncated or corrupt." );
+
+	return model;
+}
+
+
+CompiledModel loadModel( std::string &filename ){
+//reads a compiled model if the file starts with the .bcx magic and parses it as source otherwise
+//readModel copies everything it needs out of the buffer, so the file is read into memory once and then released
+
+	std::ifstream modelFile( filename, std::ios::binary );
+	if ( not modelFile.is_open() ) throw BadSourcePath();
+
+	char magic[4];
+	bool compiled = modelFile.read( magic, 4 ) and memcmp( magic, MODEL_MAGIC, 4 ) == 0;
+	if ( not compiled ){
+
+		modelFile.close();
+		return parseModel( filename );
+	}
+
+	std::string contents( magic, 4 );
+	contents.append( std::istreambuf_iterator< char >( modelFile ), std::istreambuf_iterator< char >() );
+	if ( modelFile.bad() ) throw BadModelFile( "the file could not be read." );
+	return readModel( contents.data(), contents.size() );
+}
@@ -0,0 +1,93 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <cstdint>
+#include "blockParser.h"
+#include "output.h"
+
+#define MODEL_MAGIC "BCSX"
+#define MODEL_FORMAT_VERSION 1
+
+
+struct CompiledModel{
+//everything the simulator and ABC need from a model, whether it was parsed from source or read from a compiled .bcx file
+
+	std::map< std::string, ProcessDefinition > processDefinitions;
+	std::vector< SystemLineTerm > systemLine; //kept so that sweeps and ABC can evaluate the system line under other global variables
+	std::list< SystemProcess > system;
+	GlobalVariables globalVars;
+	std::vector< ObservableDefinition > observables;
+	std::vector< StopCondition > stopConditions;
+};
+
+
+class ModelWriter{
+//writes the parts of a compiled model into body
+//tokens are numbered the first time they're written and stored once in a table ahead of the body, so tokens shared between
+//expressions stay shared when the model is read back
+
+	private:
+		std::map< Token *, unsigned int > _tokenIndex;
+		std::vector< Token * > _tokens;
+
+	public:
+		std::string body;
+		void varint( uint64_t v ){ writeVarint( body, v ); }
+		void string( const std::string &s ){ writeString( body, s ); }
+		void strings( const std::vector< std::string > & );
+		void token( Token * );
+		void tokens( const std::vector< Token * > & );
+		void tokenLists( const std::vector< std::vector< Token * > > & );
+		void numericals( std::map< std::string, Numerical > &values ){ writeNumericalMap( body, values ); }
+		void writeTokenTable( std::string & ) const;
+};
+
+
+class ModelReader{
+//reads the parts of a compiled model in the order ModelWriter wrote them
+//the first read that runs off the end or finds something malformed clears ok() and every read after it returns nothing
+
+	private:
+		const char *_data;
+		size_t _size, _pos = 0;
+		bool _ok = true;
+		std::vector< Token * > _tokens;
+
+	public:
+		ModelReader( const char *data, size_t size ) : _data(data), _size(size) {}
+		bool ok( void ) const { return _ok; }
+		bool atEnd( void ) const { return _pos == _size; }
+		void fail( void ){ _ok = false; }
+		uint64_t varint( void );
+		uint64_t count( void );
+		std::string string( void );
+		std::vector< std::string > strings( void );
+		Token *token( void );
+		std::vector< Token * > tokens( void );
+		std::vector< std::vector< Token * > > tokenLists( void );
+		void numericals( std::map< std::string, Numerical > & );
+		void readMagic( void );
+		void readTokenTable( void );
+};
+
+
+/*function prototypes */
+CompiledModel parseModel( std::string & );
+std::string serialiseModel( CompiledModel & );
+void writeModel( CompiledModel &, std::string );
+CompiledModel readModel( const char *, size_t );
+CompiledModel loadModel( std::string & );
+
+#endif
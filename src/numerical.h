@@ -11,29 +11,26 @@
 
 #include <limits>
 #include <cassert>
+#include <type_traits>
 
 class Numerical{
+//a value is only ever an int or a double, so both share the same storage
+//copies are left to the compiler so that Numericals can be copied as plain memory
 
 	private:
-		double dVal;
-		int iVal;
+		union{
+			double dVal;
+			int iVal;
+		};
 		bool isDouble_b;
 		bool isInt_b;
 
 	public:
 		Numerical(void){
 			dVal = std::numeric_limits<double>::min();
-			iVal = std::numeric_limits<int>::min();
 			isDouble_b = false;
 			isInt_b = false;
 		}
-		Numerical(const Numerical &n){
-
-			dVal = n.dVal;
-			iVal = n.iVal;
-			isDouble_b = n.isDouble_b;
-			isInt_b = n.isInt_b;
-		}
 		inline void setDouble(double d){
 
 			assert(not isDouble_b and not isInt_b); //not already set
@@ -78,4 +75,6 @@ class Numerical{
 		friend bool operator!= (const Numerical &n1, const Numerical &n2);
 };
 
+static_assert( std::is_trivially_copyable< Numerical >::value, "Numerical should be trivially copyable" );
+
 #endif
@@ -0,0 +1,824 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include "output.h"
+#include "error_handling.h"
+
+
+std::string writeChannelName( std::vector< std::vector< Token * > > channelName ){
+
+	std::string out;
+	for ( auto i = channelName.begin(); i < channelName.end(); i++ ){ //for each comma-separated value
+
+		for ( auto j = (*i).begin(); j < (*i).end(); j++ ){ //for each token in that value
+
+			out += (*j) -> value();
+		}
+		if (i != channelName.end() - 1) out += ',';
+	}
+	return out;
+}
+
+
+/*VARINT AND FIXED-WIDTH ENCODING------------------------------------------------------------------------------------------------------------------------------------*/
+void writeVarint( std::string &out, uint64_t v ){
+
+	while ( v >= 0x80 ){
+
+		out.push_back( (char) ((v & 0x7F) | 0x80) );
+		v >>= 7;
+	}
+	out.push_back( (char) v );
+}
+
+
+bool readVarint( const char *in, size_t size, size_t &pos, uint64_t &v ){
+//returns false without moving pos if the varint runs off the end of the buffer
+
+	v = 0;
+	unsigned int shift = 0;
+	for ( size_t i = pos; i < size and shift < 64; i++ ){
+
+		unsigned char byte = in[i];
+		v |= ( (uint64_t) (byte & 0x7F) ) << shift;
+		if ( not (byte & 0x80) ){
+
+			pos = i + 1;
+			return true;
+		}
+		shift += 7;
+	}
+	return false;
+}
+
+
+bool readVarint( const std::string &in, size_t &pos, uint64_t &v ){
+
+	return readVarint( in.data(), in.size(), pos, v );
+}
+
+
+void writeFixed64( std::string &out, double d ){
+//little-endian regardless of host, so files can move between machines
+
+	uint64_t bits;
+	memcpy( &bits, &d, sizeof(bits) );
+	for ( unsigned int i = 0; i < 8; i++ ) out.push_back( (char) ((bits >> (8*i)) & 0xFF) );
+}
+
+
+bool readFixed64( const char *in, size_t size, size_t &pos, double &d ){
+
+	if ( pos + 8 > size ) return false;
+	uint64_t bits = 0;
+	for ( unsigned int i = 0; i < 8; i++ ) bits |= ( (uint64_t) (unsigned char) in[pos + i] ) << (8*i);
+	memcpy( &d, &bits, sizeof(d) );
+	pos += 8;
+	return true;
+}
+
+
+bool readFixed64( const std::string &in, size_t &pos, double &d ){
+
+	return readFixed64( in.data(), in.size(), pos, d );
+}
+
+
+void writeString( std::string &out, const std::string &s ){
+
+	writeVarint( out, s.size() );
+	out += s;
+}
+
+
+bool readString( const char *in, size_t size, size_t &pos, std::string &s ){
+
+	uint64_t length;
+	size_t p = pos;
+	if ( not readVarint( in, size, p, length ) or length > size - p ) return false;
+	s.assign( in + p, length );
+	pos = p + length;
+	return true;
+}
+
+
+bool readString( const std::string &in, size_t &pos, std::string &s ){
+
+	return readString( in.data(), in.size(), pos, s );
+}
+
+
+void writeNumericalMap( std::string &out, std::map< std::string, Numerical > &values ){
+
+	writeVarint( out, values.size() );
+	for ( auto v = values.begin(); v != values.end(); v++ ){
+
+		writeString( out, v -> first );
+		if ( (v -> second).isInt() ){
+
+			out.push_back( (char) VALUE_INT );
+			writeVarint( out, zigzag( (v -> second).getInt() ) );
+		}
+		else{
+
+			out.push_back( (char) VALUE_DOUBLE );
+			writeFixed64( out, (v -> second).getDouble() );
+		}
+	}
+}
+
+
+bool readNumericalMap( const char *in, size_t size, size_t &pos, std::map< std::string, Numerical > &values ){
+
+	uint64_t n, v;
+	if ( not readVarint( in, size, pos, n ) ) return false;
+	for ( uint64_t i = 0; i < n; i++ ){
+
+		std::string name;
+		if ( not readString( in, size, pos, name ) or pos >= size ) return false;
+		char kind = in[pos++];
+		Numerical num;
+		if ( kind == VALUE_INT ){
+
+			if ( not readVarint( in, size, pos, v ) ) return false;
+			num.setInt( unzigzag( v ) );
+		}
+		else if ( kind == VALUE_DOUBLE ){
+
+			double d;
+			if ( not readFixed64( in, size, pos, d ) ) return false;
+			num.setDouble( d );
+		}
+		else return false;
+		values[name] = num;
+	}
+	return true;
+}
+
+
+bool readNumericalMap( const std::string &in, size_t &pos, std::map< std::string, Numerical > &values ){
+
+	return readNumericalMap( in.data(), in.size(), pos, values );
+}
+
+
+/*OUTPUT TABLES------------------------------------------------------------------------------------------------------------------------------------------------------*/
+unsigned int OutputTables::intern( std::vector< std::string > &table, std::map< std::string, unsigned int > &index, std::string s ){
+
+	auto found = index.find( s );
+	if ( found != index.end() ) return found -> second;
+	index[s] = table.size();
+	table.push_back( s );
+	return table.size() - 1;
+}
+
+
+OutputTables::OutputTables( std::map< std::string, ProcessDefinition > &processDefs, const std::vector< std::string > &recordNames, const std::vector< std::string > &ignoreNames ){
+//recordNames and ignoreNames are action, channel, or process names that filter which transitions are written
+//a transition is written if it matches recordNames (or recordNames is empty) and doesn't match ignoreNames
+
+	std::map< std::string, unsigned int > actionIndex, channelIndex, parameterIndex;
+	std::set< std::string > record( recordNames.begin(), recordNames.end() );
+	std::set< std::string > ignore( ignoreNames.begin(), ignoreNames.end() );
+	std::set< std::string > matched;
+
+	for ( auto pd = processDefs.begin(); pd != processDefs.end(); pd++ ){
+
+		intern( processes, _processIndex, pd -> first );
+		bool processInRecord = record.empty() or record.count( pd -> first ) > 0;
+		_processRecorded.push_back( processInRecord and ignore.count( pd -> first ) == 0 );
+
+		std::vector< unsigned int > paramIDs;
+		for ( auto p = (pd -> second).parameters.begin(); p < (pd -> second).parameters.end(); p++ ){
+
+			paramIDs.push_back( intern( parameters, parameterIndex, *p ) );
+		}
+		processParameters.push_back( paramIDs );
+
+		//work out the label of every block that can show up as a transition
+		std::vector< Block * > nodes = (pd -> second).parseTree.getNodes();
+		for ( auto b = nodes.begin(); b < nodes.end(); b++ ){
+
+			if ( (*b) -> getID() >= _blockLabels.size() ) _blockLabels.resize( (*b) -> getID() + 1 );
+			TransitionLabel &l = _blockLabels[ (*b) -> getID() ];
+			l.processID = _processIndex[ (*b) -> getOwningProcess() ];
+
+			if ( (*b) -> identify() == "Action" ){
+
+				ActionBlock *ab = static_cast< ActionBlock * >( *b );
+				l.labelID = intern( actions, actionIndex, ab -> actionName );
+			}
+			else if ( (*b) -> identify() == "MessageSend" ){
+
+				MessageSendBlock *msb = static_cast< MessageSendBlock * >( *b );
+				l.isChannel = true;
+				l.labelID = intern( channels, channelIndex, writeChannelName( msb -> getChannelName() ) );
+			}
+			else if ( (*b) -> identify() == "MessageReceive" ){
+
+				MessageReceiveBlock *mrb = static_cast< MessageReceiveBlock * >( *b );
+				l.isChannel = true;
+				l.labelID = intern( channels, channelIndex, writeChannelName( mrb -> getChannelName() ) );
+			}
+			else continue;
+
+			//compile the filters into a flag on the block so that filtered transitions cost a lookup and nothing more
+			const std::string &labelString = labelName( l );
+			const std::string &processString = pd -> first;
+			bool inRecord = record.count( labelString ) > 0 or record.count( processString ) > 0;
+			bool inIgnore = ignore.count( labelString ) > 0 or ignore.count( processString ) > 0;
+			l.recorded = ( record.empty() or inRecord ) and not inIgnore;
+
+			matched.insert( labelString );
+			matched.insert( processString );
+		}
+	}
+
+	//let the user know about filters that won't do anything, since these are usually typos
+	for ( auto name = record.begin(); name != record.end(); name++ ){
+
+		if ( matched.count( *name ) == 0 ) std::cout << "Warning: --record name " << *name << " does not match any action, channel, or process in the model." << std::endl;
+	}
+	for ( auto name = ignore.begin(); name != ignore.end(); name++ ){
+
+		if ( matched.count( *name ) == 0 ) std::cout << "Warning: --ignore name " << *name << " does not match any action, channel, or process in the model." << std::endl;
+	}
+}
+
+
+void OutputTables::writeHeader( std::string &out ) const{
+
+	out += BINARY_MAGIC;
+	writeVarint( out, BINARY_FORMAT_VERSION );
+
+	const std::vector< std::string > *tables[] = { &actions, &channels, &processes, &parameters };
+	for ( unsigned int t = 0; t < 4; t++ ){
+
+		writeVarint( out, tables[t] -> size() );
+		for ( auto s = tables[t] -> begin(); s < tables[t] -> end(); s++ ) writeString( out, *s );
+	}
+
+	for ( auto pp = processParameters.begin(); pp < processParameters.end(); pp++ ){
+
+		writeVarint( out, pp -> size() );
+		for ( auto p = pp -> begin(); p < pp -> end(); p++ ) writeVarint( out, *p );
+	}
+}
+
+
+bool OutputTables::readHeader( const std::string &in, size_t &pos ){
+//returns false if the buffer doesn't yet hold the whole header
+
+	size_t p = pos;
+	if ( p + 4 > in.size() ) return false;
+	if ( in.compare( p, 4, BINARY_MAGIC ) != 0 ) throw BadTrajectoryFile();
+	p += 4;
+
+	uint64_t version;
+	if ( not readVarint( in, p, version ) ) return false;
+	if ( version == 0 or version > BINARY_FORMAT_VERSION ) throw BadTrajectoryFile();
+
+	std::vector< std::string > *tables[] = { &actions, &channels, &processes, &parameters };
+	for ( unsigned int t = 0; t < 4; t++ ){
+
+		uint64_t n;
+		if ( not readVarint( in, p, n ) ) return false;
+		tables[t] -> clear();
+		for ( uint64_t i = 0; i < n; i++ ){
+
+			std::string s;
+			if ( not readString( in, p, s ) ) return false;
+			tables[t] -> push_back( s );
+		}
+	}
+
+	processParameters.clear();
+	for ( unsigned int i = 0; i < processes.size(); i++ ){
+
+		uint64_t n;
+		if ( not readVarint( in, p, n ) ) return false;
+		std::vector< unsigned int > paramIDs;
+		for ( uint64_t j = 0; j < n; j++ ){
+
+			uint64_t id;
+			if ( not readVarint( in, p, id ) ) return false;
+			if ( id >= parameters.size() ) throw BadTrajectoryFile();
+			paramIDs.push_back( id );
+		}
+		processParameters.push_back( paramIDs );
+	}
+
+	pos = p;
+	return true;
+}
+
+
+/*TRAJECTORY WRITERS-------------------------------------------------------------------------------------------------------------------------------------------------*/
+static void appendNumerical( std::string &out, Numerical n ){
+
+	char buffer[32];
+	int length;
+	if ( n.isInt() ) length = snprintf( buffer, sizeof(buffer), "%d", n.getInt() );
+	else length = snprintf( buffer, sizeof(buffer), "%g", n.getDouble() ); //matches the default ostream formatting
+	out.append( buffer, length );
+}
+
+
+static void appendTime( std::string &out, double time ){
+
+	char buffer[32];
+	int length = snprintf( buffer, sizeof(buffer), "%g", time );
+	out.append( buffer, length );
+}
+
+
+void writeObservableLine( std::string &out, double time, const std::vector< long > &counts ){
+//one line of the observable time series: the time, then the value of each observable in declaration order
+
+	appendTime( out, time );
+	for ( auto c = counts.begin(); c < counts.end(); c++ ){
+
+		char buffer[32];
+		int length = snprintf( buffer, sizeof(buffer), "\t%ld", *c );
+		out.append( buffer, length );
+	}
+	out += '\n';
+}
+
+
+void appendGridLabel( std::string &out, unsigned int gridIndex, const std::vector< std::string > &names, const std::vector< Numerical > &values ){
+//tab-delimited grid point index and the value of each swept variable, for the end of a >======= line
+
+	out += "\tgrid\t";
+	out += std::to_string( gridIndex );
+	for ( unsigned int i = 0; i < names.size(); i++ ){
+
+		out += '\t';
+		out += names[i];
+		out += '\t';
+		appendNumerical( out, values[i] );
+	}
+}
+
+
+void TextTrajectoryWriter::beginSimulation( void ){
+
+	_buffer += ">=======\n";
+	endRecord();
+}
+
+
+void TextTrajectoryWriter::beginGridPoint( unsigned int gridIndex, const std::vector< std::string > &names, const std::vector< Numerical > &values ){
+
+	_buffer += ">=======";
+	appendGridLabel( _buffer, gridIndex, names, values );
+	_buffer += '\n';
+	endRecord();
+}
+
+
+void TextTrajectoryWriter::writeTransition( double time, Block *actionDone, ParameterValues &pv ){
+
+	const TransitionLabel &l = _tables.getLabel( actionDone );
+
+	appendTime( _buffer, time );
+	_buffer += '\t';
+	_buffer += _tables.labelName( l );
+	_buffer += '\t';
+	_buffer += _tables.processes[ l.processID ];
+
+	const std::vector< unsigned int > &paramIDs = _tables.processParameters[ l.processID ];
+	for ( auto p = paramIDs.begin(); p < paramIDs.end(); p++ ){
+
+		auto val = pv.values.find( _tables.parameters[*p] );
+		if ( val != pv.values.end() ){
+
+			_buffer += '\t';
+			_buffer += _tables.parameters[*p];
+			_buffer += '\t';
+			appendNumerical( _buffer, val -> second );
+		}
+	}
+	_buffer += '\n';
+	endRecord();
+}
+
+
+void TextTrajectoryWriter::writeSnapshot( double time, unsigned int processID, size_t count, std::vector< Numerical > &values ){
+//one line per group of identical live processes: time, process name, number of processes, then the parameter values
+
+	appendTime( _buffer, time );
+	_buffer += '\t';
+	_buffer += _tables.processes[ processID ];
+	_buffer += '\t';
+	_buffer += std::to_string( count );
+
+	const std::vector< unsigned int > &paramIDs = _tables.processParameters[ processID ];
+	for ( unsigned int i = 0; i < paramIDs.size(); i++ ){
+
+		_buffer += '\t';
+		_buffer += _tables.parameters[ paramIDs[i] ];
+		_buffer += '\t';
+		appendNumerical( _buffer, values[i] );
+	}
+	_buffer += '\n';
+	endRecord();
+}
+
+
+void TextTrajectoryWriter::writeLine( double time, const TransitionLabel &l, std::vector< std::pair< BinaryValue, Numerical > > &values ){
+//same format as writeTransition, but from values that were decoded from a binary record
+
+	appendTime( _buffer, time );
+	_buffer += '\t';
+	_buffer += _tables.labelName( l );
+	_buffer += '\t';
+	_buffer += _tables.processes[ l.processID ];
+
+	const std::vector< unsigned int > &paramIDs = _tables.processParameters[ l.processID ];
+	for ( unsigned int i = 0; i < paramIDs.size(); i++ ){
+
+		if ( values[i].first != VALUE_ABSENT ){
+
+			_buffer += '\t';
+			_buffer += _tables.parameters[ paramIDs[i] ];
+			_buffer += '\t';
+			appendNumerical( _buffer, values[i].second );
+		}
+	}
+	_buffer += '\n';
+	endRecord();
+}
+
+
+void BinaryTrajectoryWriter::beginSimulation( void ){
+
+	_buffer.push_back( (char) RECORD_NEWSIMULATION );
+	endRecord();
+}
+
+
+void BinaryTrajectoryWriter::beginGridPoint( unsigned int gridIndex, const std::vector< std::string > &names, const std::vector< Numerical > &values ){
+//record layout: tag, grid point index, number of swept variables, then the name and value of each
+//this takes the place of a new simulation record
+
+	_buffer.push_back( (char) RECORD_GRIDPOINT );
+	writeVarint( _buffer, gridIndex );
+	writeVarint( _buffer, names.size() );
+	for ( unsigned int i = 0; i < names.size(); i++ ){
+
+		writeString( _buffer, names[i] );
+		Numerical v = values[i];
+		if ( v.isInt() ){
+
+			_buffer.push_back( (char) VALUE_INT );
+			writeVarint( _buffer, zigzag( v.getInt() ) );
+		}
+		else{
+
+			_buffer.push_back( (char) VALUE_DOUBLE );
+			writeFixed64( _buffer, v.getDouble() );
+		}
+	}
+	endRecord();
+}
+
+
+void BinaryTrajectoryWriter::writeTransition( double time, Block *actionDone, ParameterValues &pv ){
+//record layout: tag, time (fixed 8 bytes), label ID with the channel flag in the low bit, process ID,
+//then one value per parameter of the owning process in definition order
+
+	const TransitionLabel &l = _tables.getLabel( actionDone );
+
+	_buffer.push_back( (char) RECORD_TRANSITION );
+	writeFixed64( _buffer, time );
+	writeVarint( _buffer, ( ((uint64_t) l.labelID) << 1 ) | (l.isChannel ? 1 : 0) );
+	writeVarint( _buffer, l.processID );
+
+	const std::vector< unsigned int > &paramIDs = _tables.processParameters[ l.processID ];
+	for ( auto p = paramIDs.begin(); p < paramIDs.end(); p++ ){
+
+		auto val = pv.values.find( _tables.parameters[*p] );
+		if ( val == pv.values.end() ){
+
+			_buffer.push_back( (char) VALUE_ABSENT );
+		}
+		else if ( (val -> second).isInt() ){
+
+			_buffer.push_back( (char) VALUE_INT );
+			writeVarint( _buffer, zigzag( (val -> second).getInt() ) );
+		}
+		else{
+
+			_buffer.push_back( (char) VALUE_DOUBLE );
+			writeFixed64( _buffer, (val -> second).getDouble() );
+		}
+	}
+	endRecord();
+}
+
+
+void BinaryTrajectoryWriter::writeSnapshot( double time, unsigned int processID, size_t count, std::vector< Numerical > &values ){
+//record layout: tag, time (fixed 8 bytes), process ID, count, then every parameter value of the process in definition order
+
+	_buffer.push_back( (char) RECORD_SNAPSHOT );
+	writeFixed64( _buffer, time );
+	writeVarint( _buffer, processID );
+	writeVarint( _buffer, count );
+
+	for ( auto v = values.begin(); v < values.end(); v++ ){
+
+		if ( v -> isInt() ){
+
+			_buffer.push_back( (char) VALUE_INT );
+			writeVarint( _buffer, zigzag( v -> getInt() ) );
+		}
+		else{
+
+			_buffer.push_back( (char) VALUE_DOUBLE );
+			writeFixed64( _buffer, v -> getDouble() );
+		}
+	}
+	endRecord();
+}
+
+
+void TrajectoryWriter::compress( void ){
+//replaces the buffer with independently decompressible blocks, each cut on a record boundary
+
+	_blockEnds.push_back( _buffer.size() );
+
+	std::string compressed;
+	size_t start = 0;
+	for ( auto end = _blockEnds.begin(); end < _blockEnds.end(); end++ ){
+
+		if ( *end > start ) appendCompressedBlock( compressed, _buffer.data() + start, *end - start );
+		start = *end;
+	}
+
+	_buffer.swap( compressed );
+	_blockEnds.clear();
+	_blockStart = _buffer.size();
+}
+
+
+void TrajectoryWriter::writeState( std::string &out ) const{
+//the record boundaries so far, so that compression blocks are cut in the same places after a restart
+
+	writeVarint( out, _blockEnds.size() );
+	for ( auto end = _blockEnds.begin(); end < _blockEnds.end(); end++ ) writeVarint( out, *end );
+	writeVarint( out, _blockStart );
+}
+
+
+bool TrajectoryWriter::readState( const std::string &in, size_t &pos ){
+
+	uint64_t n, v;
+	if ( not readVarint( in, pos, n ) ) return false;
+	_blockEnds.clear();
+	for ( uint64_t i = 0; i < n; i++ ){
+
+		if ( not readVarint( in, pos, v ) ) return false;
+		_blockEnds.push_back( v );
+	}
+	if ( not readVarint( in, pos, v ) ) return false;
+	_blockStart = v;
+	return true;
+}
+
+
+TrajectoryWriter *newTrajectoryWriter( OutputFormat format, const OutputTables &tables ){
+
+	if ( format == BINARY_OUTPUT ) return new BinaryTrajectoryWriter( tables );
+	else return new TextTrajectoryWriter( tables );
+}
+
+
+/*CONVERSION BACK TO TEXT--------------------------------------------------------------------------------------------------------------------------------------------*/
+static bool readValue( const std::string &in, size_t &p, BinaryValue kind, Numerical &n ){
+//reads a parameter value of the given kind; returns false if it runs off the end of the buffer
+
+	if ( kind == VALUE_INT ){
+
+		uint64_t v;
+		if ( not readVarint( in, p, v ) ) return false;
+		n.setInt( unzigzag(v) );
+	}
+	else if ( kind == VALUE_DOUBLE ){
+
+		double d;
+		if ( not readFixed64( in, p, d ) ) return false;
+		n.setDouble( d );
+	}
+	else if ( kind != VALUE_ABSENT ) throw BadTrajectoryFile();
+	return true;
+}
+
+
+static bool decodeRecord( const std::string &in, size_t &pos, const OutputTables &tables, TextTrajectoryWriter &out ){
+//decodes one record and writes it as text; returns false without moving pos if the record is incomplete
+
+	size_t p = pos;
+	if ( p >= in.size() ) return false;
+	unsigned char tag = in[p++];
+
+	if ( tag == RECORD_NEWSIMULATION ){
+
+		out.beginSimulation();
+		pos = p;
+		return true;
+	}
+	else if ( tag == RECORD_GRIDPOINT ){
+
+		uint64_t gridIndex, n;
+		if ( not readVarint( in, p, gridIndex ) ) return false;
+		if ( not readVarint( in, p, n ) ) return false;
+
+		std::vector< std::string > names;
+		std::vector< Numerical > values;
+		for ( uint64_t i = 0; i < n; i++ ){
+
+			std::string name;
+			if ( not readString( in, p, name ) ) return false;
+			if ( p >= in.size() ) return false;
+			BinaryValue kind = (BinaryValue) (unsigned char) in[p++];
+			Numerical v;
+			if ( not readValue( in, p, kind, v ) ) return false;
+			if ( kind == VALUE_ABSENT ) throw BadTrajectoryFile();
+			names.push_back( name );
+			values.push_back( v );
+		}
+
+		out.beginGridPoint( gridIndex, names, values );
+		pos = p;
+		return true;
+	}
+	else if ( tag == RECORD_SNAPSHOT ){
+
+		double time;
+		uint64_t processID, count;
+		if ( not readFixed64( in, p, time ) ) return false;
+		if ( not readVarint( in, p, processID ) ) return false;
+		if ( not readVarint( in, p, count ) ) return false;
+		if ( processID >= tables.processes.size() ) throw BadTrajectoryFile();
+
+		std::vector< Numerical > values;
+		for ( unsigned int i = 0; i < tables.processParameters[ processID ].size(); i++ ){
+
+			if ( p >= in.size() ) return false;
+			BinaryValue kind = (BinaryValue) (unsigned char) in[p++];
+			Numerical n;
+			if ( not readValue( in, p, kind, n ) ) return false;
+			if ( kind == VALUE_ABSENT ) throw BadTrajectoryFile();
+			values.push_back( n );
+		}
+
+		out.writeSnapshot( time, processID, count, values );
+		pos = p;
+		return true;
+	}
+	else if ( tag != RECORD_TRANSITION ) throw BadTrajectoryFile();
+
+	double time;
+	uint64_t label, processID;
+	if ( not readFixed64( in, p, time ) ) return false;
+	if ( not readVarint( in, p, label ) ) return false;
+	if ( not readVarint( in, p, processID ) ) return false;
+
+	TransitionLabel l;
+	l.isChannel = label & 1;
+	l.labelID = label >> 1;
+	l.processID = processID;
+	if ( l.processID >= tables.processes.size() ) throw BadTrajectoryFile();
+	if ( l.labelID >= (l.isChannel ? tables.channels.size() : tables.actions.size()) ) throw BadTrajectoryFile();
+
+	std::vector< std::pair< BinaryValue, Numerical > > values;
+	for ( unsigned int i = 0; i < tables.processParameters[ l.processID ].size(); i++ ){
+
+		if ( p >= in.size() ) return false;
+		BinaryValue kind = (BinaryValue) (unsigned char) in[p++];
+		Numerical n;
+		if ( not readValue( in, p, kind, n ) ) return false;
+		values.push_back( std::make_pair( kind, n ) );
+	}
+
+	out.writeLine( time, l, values );
+	pos = p;
+	return true;
+}
+
+
+class TrajectoryConverter{
+//takes uncompressed bytes of bcs output in whatever pieces they arrive and writes them out as text
+
+	private:
+		std::string _pending;
+		size_t _pos = 0;
+		bool _formatKnown = false, _isBinary = false, _headerRead = false;
+		OutputTables _tables;
+		TextTrajectoryWriter _writer;
+
+	public:
+		TrajectoryConverter() : _writer(_tables) {}
+		void feed( const char *data, size_t n, std::ostream &out ){
+
+			_pending.erase( 0, _pos );
+			_pos = 0;
+			_pending.append( data, n );
+
+			if ( not _formatKnown and _pending.size() >= 4 ){
+
+				_isBinary = _pending.compare( 0, 4, BINARY_MAGIC ) == 0;
+				_formatKnown = true;
+			}
+			if ( not _formatKnown ) return;
+
+			//text output passes straight through
+			if ( not _isBinary ){
+
+				out << _pending;
+				_pending.clear();
+				return;
+			}
+
+			if ( not _headerRead ) _headerRead = _tables.readHeader( _pending, _pos );
+			if ( _headerRead ){
+
+				while ( decodeRecord( _pending, _pos, _tables, _writer ) ){}
+			}
+			out << _writer.buffer();
+			_writer.buffer().clear();
+		}
+		void finish( std::ostream &out ){
+
+			if ( not _formatKnown ) out << _pending;
+			else if ( _isBinary and ( not _headerRead or _pos != _pending.size() ) ) throw BadTrajectoryFile();
+		}
+};
+
+
+void convertTrajectory( std::istream &in, std::ostream &out ){
+//streams bcs output back into the text format that bcs writes by default
+//handles binary output, compressed output, or both
+
+	const size_t chunkSize = 1 << 20;
+	std::vector< char > chunk( chunkSize );
+	TrajectoryConverter converter;
+
+	std::string compressedPending, decompressed;
+	size_t compressedPos = 0;
+	bool formatKnown = false, isCompressed = false;
+
+	while ( true ){
+
+		in.read( chunk.data(), chunkSize );
+		size_t bytesRead = in.gcount();
+
+		if ( not formatKnown ){
+
+			compressedPending.append( chunk.data(), bytesRead );
+			if ( compressedPending.size() >= 5 or bytesRead < chunkSize ){
+
+				formatKnown = true;
+				isCompressed = compressedPending.compare( 0, 4, COMPRESSED_MAGIC ) == 0;
+				if ( isCompressed ){
+
+					if ( compressedPending[4] != COMPRESSED_FORMAT_VERSION ) throw BadTrajectoryFile();
+					compressedPos = 5;
+				}
+				else{
+
+					converter.feed( compressedPending.data(), compressedPending.size(), out );
+					compressedPending.clear();
+				}
+			}
+		}
+		else if ( isCompressed ) compressedPending.append( chunk.data(), bytesRead );
+		else converter.feed( chunk.data(), bytesRead, out );
+
+		//blocks are independent, so each one is decompressed as soon as it has been read in full
+		if ( isCompressed ){
+
+			while ( readCompressedBlock( compressedPending, compressedPos, decompressed ) ){
+
+				converter.feed( decompressed.data(), decompressed.size(), out );
+				decompressed.clear();
+			}
+			compressedPending.erase( 0, compressedPos );
+			compressedPos = 0;
+		}
+
+		if ( bytesRead < chunkSize ) break;
+	}
+
+	if ( isCompressed and compressedPending.size() > 0 ) throw BadTrajectoryFile();
+	converter.finish( out );
+}
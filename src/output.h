@@ -0,0 +1,149 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <cstdint>
+#include "blockParser.h"
+#include "compression.h"
+
+#define BINARY_MAGIC "BCSB"
+#define BINARY_FORMAT_VERSION 2 //version 2 added grid point records for parameter sweeps
+
+enum OutputFormat { TEXT_OUTPUT, BINARY_OUTPUT };
+
+/*record tags in the binary trajectory format */
+enum BinaryRecord { RECORD_NEWSIMULATION = 0, RECORD_TRANSITION = 1, RECORD_SNAPSHOT = 2, RECORD_GRIDPOINT = 3 };
+
+/*how a parameter value is stored in a binary transition record */
+enum BinaryValue { VALUE_ABSENT = 0, VALUE_INT = 1, VALUE_DOUBLE = 2 };
+
+
+struct TransitionLabel{
+
+	bool isChannel = false;
+	bool recorded = true; //false if the user filtered this transition out with --record/--ignore
+	unsigned int labelID = 0;
+	unsigned int processID = 0;
+};
+
+
+class OutputTables{
+//interned strings for everything that appears in a trajectory: action names, channel names, process names, and parameter names
+
+	private:
+		std::vector< TransitionLabel > _blockLabels; //indexed by block ID
+		std::map< std::string, unsigned int > _processIndex;
+		std::vector< bool > _processRecorded; //indexed by process ID, used to filter snapshots
+		unsigned int intern( std::vector< std::string > &, std::map< std::string, unsigned int > &, std::string );
+
+	public:
+		std::vector< std::string > actions, channels, processes, parameters;
+		std::vector< std::vector< unsigned int > > processParameters; //parameter name IDs of each process, in definition order
+		OutputTables(){}
+		OutputTables( std::map< std::string, ProcessDefinition > &, const std::vector< std::string > &, const std::vector< std::string > & );
+		const TransitionLabel &getLabel( Block *b ) const { return _blockLabels[ b -> getID() ]; }
+		const std::string &labelName( const TransitionLabel &l ) const { return l.isChannel ? channels[l.labelID] : actions[l.labelID]; }
+		unsigned int getProcessID( const std::string &name ) const { return _processIndex.at(name); }
+		bool isProcessRecorded( unsigned int processID ) const { return _processRecorded[processID]; }
+		void writeHeader( std::string & ) const;
+		bool readHeader( const std::string &, size_t & );
+};
+
+
+class TrajectoryWriter{
+
+	protected:
+		const OutputTables &_tables;
+		std::string _buffer;
+		std::vector< size_t > _blockEnds; //record boundaries where the buffer can be cut into compression blocks
+		size_t _blockStart = 0;
+		void endRecord( void ){
+
+			if ( _buffer.size() - _blockStart >= COMPRESSION_BLOCK_SIZE ){
+
+				_blockEnds.push_back( _buffer.size() );
+				_blockStart = _buffer.size();
+			}
+		}
+
+	public:
+		TrajectoryWriter( const OutputTables &t ) : _tables(t) {}
+		virtual ~TrajectoryWriter(){}
+		virtual void beginSimulation( void ) = 0;
+		virtual void beginGridPoint( unsigned int, const std::vector< std::string > &, const std::vector< Numerical > & ) = 0;
+		virtual void writeTransition( double, Block *, ParameterValues & ) = 0;
+		virtual void writeSnapshot( double, unsigned int, size_t, std::vector< Numerical > & ) = 0;
+		std::string &buffer( void ){ return _buffer; }
+		bool isRecorded( Block *b ) const { return _tables.getLabel(b).recorded; }
+		void compress( void );
+		void writeState( std::string & ) const;
+		bool readState( const std::string &, size_t & );
+};
+
+
+class TextTrajectoryWriter : public TrajectoryWriter{
+
+	public:
+		TextTrajectoryWriter( const OutputTables &t ) : TrajectoryWriter(t) {}
+		void beginSimulation( void );
+		void beginGridPoint( unsigned int, const std::vector< std::string > &, const std::vector< Numerical > & );
+		void writeTransition( double, Block *, ParameterValues & );
+		void writeSnapshot( double, unsigned int, size_t, std::vector< Numerical > & );
+		void writeLine( double, const TransitionLabel &, std::vector< std::pair< BinaryValue, Numerical > > & );
+};
+
+
+class BinaryTrajectoryWriter : public TrajectoryWriter{
+
+	public:
+		BinaryTrajectoryWriter( const OutputTables &t ) : TrajectoryWriter(t) {}
+		void beginSimulation( void );
+		void beginGridPoint( unsigned int, const std::vector< std::string > &, const std::vector< Numerical > & );
+		void writeTransition( double, Block *, ParameterValues & );
+		void writeSnapshot( double, unsigned int, size_t, std::vector< Numerical > & );
+};
+
+
+inline uint64_t zigzag( int i ){
+
+	return ( ((uint64_t) i) << 1 ) ^ (uint64_t) ( (int64_t) i >> 63 );
+}
+
+
+inline int unzigzag( uint64_t v ){
+
+	return (int) ( (v >> 1) ^ (~(v & 1) + 1) );
+}
+
+
+/*function prototypes */
+std::string writeChannelName( std::vector< std::vector< Token * > > );
+TrajectoryWriter *newTrajectoryWriter( OutputFormat, const OutputTables & );
+void writeVarint( std::string &, uint64_t );
+bool readVarint( const char *, size_t, size_t &, uint64_t & );
+bool readVarint( const std::string &, size_t &, uint64_t & );
+void writeFixed64( std::string &, double );
+bool readFixed64( const char *, size_t, size_t &, double & );
+bool readFixed64( const std::string &, size_t &, double & );
+void writeString( std::string &, const std::string & );
+bool readString( const char *, size_t, size_t &, std::string & );
+bool readString( const std::string &, size_t &, std::string & );
+void writeNumericalMap( std::string &, std::map< std::string, Numerical > & );
+bool readNumericalMap( const char *, size_t, size_t &, std::map< std::string, Numerical > & );
+bool readNumericalMap( const std::string &, size_t &, std::map< std::string, Numerical > & );
+void convertTrajectory( std::istream &, std::ostream & );
+void writeObservableLine( std::string &, double, const std::vector< long > & );
+void appendGridLabel( std::string &, unsigned int, const std::vector< std::string > &, const std::vector< Numerical > & );
+
+#endif
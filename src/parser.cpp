@@ -20,7 +20,7 @@
 #include "parser.h"
 #include "error_handling.h"
 
-void printTree( Tree<Token> pt, Token *t ){
+void printTree( Tree<Token> &pt, Token *t ){
 /*for testing/debugging - prints out the parse tree */
 
 	/*if this token has children */
@@ -49,81 +49,89 @@ void printTree( Tree<Token> pt, Token *t ){
 }
 
 
-void checkProcessGrammar( Tree<Token> pt, Token *t ){
-/*checks process definition grammar against the BNF */
+void checkProcessGrammar( Tree<Token> &pt, Token *root ){
+/*checks process definition grammar against the BNF
+ *walks the tree depth first with its own stack, as the tree is as deep as the longest chain of choices or prefixes */
 
 	/*unary and binary tokens */
-	std::vector< std::string > ut = {"BeaconCheck", "BeaconKill", "MessageSend", "MessageReceive", "Action", "Process", "Gate"};
-	std::vector< std::string > bt = {"+", "||"};
+	static const std::vector< std::string > ut = {"BeaconCheck", "BeaconKill", "MessageSend", "MessageReceive", "Action", "Process", "Gate"};
+	static const std::vector< std::string > bt = {"+", "||"};
 
-	if ( pt.isLeaf( t ) ){
+	std::vector< Token * > toCheck( 1, root );
+	while ( not toCheck.empty() ){
 
-		//leaves must be messages, actions, or processes 
-		if ( std::find( ut.begin(), ut.end(), t -> identify() ) == ut.end() ) throw SyntaxError( t, "Thrown by parser: Leaf nodes must be messages, actions, or processes." );
-		if ( t -> identify() == "Gate" ) throw SyntaxError( t, "Thrown by parser: This gate does not guard an action." );
-		return;
-	}
+		Token *t = toCheck.back();
+		toCheck.pop_back();
 
-	std::vector< Token * > children = pt.getChildren( t );
+		if ( pt.isLeaf( t ) ){
 
-	if ( t -> value() == "=" ){
+			//leaves must be messages, actions, or processes 
+			if ( std::find( ut.begin(), ut.end(), t -> identify() ) == ut.end() ) throw SyntaxError( t, "Thrown by parser: Leaf nodes must be messages, actions, or processes." );
+			if ( t -> identify() == "Gate" ) throw SyntaxError( t, "Thrown by parser: This gate does not guard an action." );
+			continue;
+		}
 
-		/*must be binary */
-		if ( children.size() != 2 ) throw SyntaxError( t, "Thrown by parser: Assignment must have two arguments." );
+		std::vector< Token * > children = pt.getChildren( t );
 
-		/*LHS must be process, RHS must be +, ||, or action */
-		if ( children[0] -> identify() != "Process" ) throw SyntaxError( children[0], "Thrown by parser: Left hand side of this assignment must be a process." );
-		if ( std::find( ut.begin(), ut.end(), children[1] -> identify() ) == ut.end() and std::find( bt.begin(), bt.end(), children[1] -> value() ) == bt.end() ){
+		if ( t -> value() == "=" ){
 
-			throw SyntaxError( children[1], "Thrown by parser: Right hand side of this assignment must be an action, unary, or binary operator." ); 
-		}
+			/*must be binary */
+			if ( children.size() != 2 ) throw SyntaxError( t, "Thrown by parser: Assignment must have two arguments." );
 
-		/*recurse down the RHS */
-		checkProcessGrammar( pt, children[1] );
-	}
-	else if ( t -> value() == "+" or t -> value() == "||" ){
-		
-		/*must be binary */
-		if ( children.size() != 2 ) throw SyntaxError( t, "Thrown by parser: Choice/parallel must have two arguments." );
+			/*LHS must be process, RHS must be +, ||, or action */
+			if ( children[0] -> identify() != "Process" ) throw SyntaxError( children[0], "Thrown by parser: Left hand side of this assignment must be a process." );
+			if ( std::find( ut.begin(), ut.end(), children[1] -> identify() ) == ut.end() and std::find( bt.begin(), bt.end(), children[1] -> value() ) == bt.end() ){
 
-		/*must have the right children */
-		if ( std::find( ut.begin(), ut.end(), children[0] -> identify() ) == ut.end() and std::find( bt.begin(), bt.end(), children[0] -> value() ) == bt.end() ){
+				throw SyntaxError( children[1], "Thrown by parser: Right hand side of this assignment must be an action, unary, or binary operator." ); 
+			}
 
-			throw SyntaxError( children[0], "Thrown by parser: Arguments to choice/parallel must be processes, actions, unary, or binary operators." ); 
+			/*recurse down the RHS */
+			toCheck.push_back( children[1] );
 		}
-		if ( std::find( ut.begin(), ut.end(), children[1] -> identify() ) == ut.end() and std::find( bt.begin(), bt.end(), children[1] -> value() ) == bt.end() ){
+		else if ( t -> value() == "+" or t -> value() == "||" ){
+			
+			/*must be binary */
+			if ( children.size() != 2 ) throw SyntaxError( t, "Thrown by parser: Choice/parallel must have two arguments." );
+
+			/*must have the right children */
+			if ( std::find( ut.begin(), ut.end(), children[0] -> identify() ) == ut.end() and std::find( bt.begin(), bt.end(), children[0] -> value() ) == bt.end() ){
+
+				throw SyntaxError( children[0], "Thrown by parser: Arguments to choice/parallel must be processes, actions, unary, or binary operators." ); 
+			}
+			if ( std::find( ut.begin(), ut.end(), children[1] -> identify() ) == ut.end() and std::find( bt.begin(), bt.end(), children[1] -> value() ) == bt.end() ){
 
-			throw SyntaxError( children[1], "Thrown by parser: Arguments to choice/parallel must be processes, actions, unary, or binary operators." ); 
+				throw SyntaxError( children[1], "Thrown by parser: Arguments to choice/parallel must be processes, actions, unary, or binary operators." ); 
+			}
+
+			/*recurse down, left first */
+			toCheck.push_back( children[1] );
+			toCheck.push_back( children[0] );
+		}
+		else if ( t -> identify() == "Process" ){
+		
+			//processes must be leaves
+			if ( not pt.isLeaf( t ) ) throw SyntaxError( t, "Thrown by parser: A process can not be used as prefix." );
 		}
+		else if ( std::find( ut.begin(), ut.end(), t -> identify() ) != ut.end() ){
 
-		/*recurse down */
-		checkProcessGrammar( pt, children[0] );
-		checkProcessGrammar( pt, children[1] );
-	}
-	else if ( t -> identify() == "Process" ){
-	
-		//processes must be leaves
-		if ( not pt.isLeaf( t ) ) throw SyntaxError( t, "Thrown by parser: A process can not be used as prefix." );
-	}
-	else if ( std::find( ut.begin(), ut.end(), t -> identify() ) != ut.end() ){
+			/*must be unary */
+			if ( children.size() != 1 ) throw SyntaxError( t, "Thrown by parser: Unary operators can only have one operand." );
 
-		/*must be unary */
-		if ( children.size() != 1 ) throw SyntaxError( t, "Thrown by parser: Unary operators can only have one operand." );
+			/*must have the right children */
+			if ( std::find( ut.begin(), ut.end(), children[0] -> identify() ) == ut.end() and std::find( bt.begin(), bt.end(), children[0] -> value() ) == bt.end() ){
 
-		/*must have the right children */
-		if ( std::find( ut.begin(), ut.end(), children[0] -> identify() ) == ut.end() and std::find( bt.begin(), bt.end(), children[0] -> value() ) == bt.end() ){
+				throw SyntaxError( children[0], "Thrown by parser: Unary operators must have a process, action, unary, or binary operator as an operand." ); 
+			}
 
-			throw SyntaxError( children[0], "Thrown by parser: Unary operators must have a process, action, unary, or binary operator as an operand." ); 
+			/*recurse down */
+			toCheck.push_back( children[0] );
 		}
-
-		/*recurse down */
-		checkProcessGrammar( pt, children[0] );
+		else throw SyntaxError( t, "Thrown by parser: Unrecognised token value in process grammar check." );
 	}
-	else throw SyntaxError( t, "Thrown by parser: Unrecognised token value in process grammar check." );
 }
 
 
-void matchParentheses( std::vector< Token * > tokenisedLine ){
+void matchParentheses( std::vector< Token * > &tokenisedLine ){
 /*checks a tokenised line to make sure all parentheses are balanced, throws an error if not */
 
 	std::stack< Token * > parenStack;
@@ -145,10 +153,11 @@ void matchParentheses( std::vector< Token * > tokenisedLine ){
 }
 
 
-std::vector< Token * > parseSystemLine( std::vector< Token * > &tokenisedLine ){
-/*checks grammar on tokenised system line and strips out parallel operators */
+std::vector< SystemLineTerm > parseSystemLine( std::vector< Token * > &tokenisedLine ){
+/*checks grammar on tokenised system line, strips out parallel operators, and lexes the parameters of each process */
 
-	std::vector< Token * > tokenisedSystemLine;
+	std::vector< SystemLineTerm > systemLine;
+	SystemLineTerm term;
 	int flip = 0;
 
 	/*check the end to make sure we trail with a process */
@@ -163,12 +172,19 @@ std::vector< Token * > parseSystemLine( std::vector< Token * > &tokenisedLine ){
 		if ( (*t) -> identify() == "Process" and flip == 0 ){
 
 			flip++; flip %= 2;
-			tokenisedSystemLine.push_back( *t );
+
+			std::string wholeProcess = (*t) -> value();
+			std::string betweenBrackets = wholeProcess.substr( wholeProcess.find("[") + 1, wholeProcess.find("]") - wholeProcess.find("[") - 1 );
+			term.process = *t;
+			term.processName = wholeProcess.substr( 0, wholeProcess.find('[') );
+			term.parameters = scanLine( betweenBrackets, (*t) -> getLine(), (*t) -> getColumn() );
+			systemLine.push_back( std::move( term ) );
+			term = SystemLineTerm();
 			continue;
 		} 
 		else if ( ((*t) -> identify() == "Variable" or (*t) -> identify() == "IntLiteral") and (*(t+1)) -> value() == "*" and (*(t+2)) -> identify() == "Process" ){
 
-			tokenisedSystemLine.push_back( *t );
+			term.multiplier = *t;
 			continue;
 		}
 		else if ( (*t) -> value() == "*" and ( (*(t-1)) -> identify() == "Variable" or (*(t-1)) -> identify() == "IntLiteral") and (*(t+1)) -> identify() == "Process" ){
@@ -182,114 +198,136 @@ std::vector< Token * > parseSystemLine( std::vector< Token * > &tokenisedLine ){
 		}
 		else throw SyntaxError( *t, "Thrown by parser: Illegal token type in system line or system line formatted incorrectly." );
 	}
-	return tokenisedSystemLine;
+	return systemLine;
 }
 
 
-void parseDefLine( Token *parentToken, std::vector< Token * > &tokenisedLine, Tree<Token> &treeForLine ){
-/*called by parseSource, creates a parse tree for a single line of the source code */
+void parseDefLine( Token *parentToken, TokenIterator first, TokenIterator last, Tree<Token> &treeForLine ){
+/*called by parseSource, creates a parse tree for a single line of the source code
+ *the line is the range [first, last), and each side of a pivot is passed down as a subrange rather than copied.
+ *pivots are always leftmost, so the right hand side is handled by looping rather than recursing to keep the stack
+ *shallow for long chains of choices and prefixes */
 
 	/*operators */
-	std::vector< std::string > bindingOrder = {"+", "||"};
+	static const std::vector< std::string > bindingOrder = {"+", "||"};
 
-	/*vector for tokens for right hand side and left hand side for the pivot */
-	std::vector< Token * > LHS, RHS;
+	while ( true ){
 
-	/*stack for parentheses matching */
-	std::stack< Token * > parenStack;
+		/*stack for parentheses matching */
+		std::stack< Token * > parenStack;
+		bool foundPivot = false;
 
-	for ( auto binaryOperator = bindingOrder.begin(); binaryOperator < bindingOrder.end(); binaryOperator++ ){
+		for ( auto binaryOperator = bindingOrder.begin(); binaryOperator < bindingOrder.end() and not foundPivot; binaryOperator++ ){
 
-		/*scan until you find the leftmost operator that we're looking for */
-		for ( auto t = tokenisedLine.begin(); t < tokenisedLine.end(); t++ ){
+			/*scan until you find the leftmost operator that we're looking for */
+			for ( auto t = first; t < last; t++ ){
 
-			/*pop matching parentheses on/off the stack */
-			if ( (*t) -> value() == "(" ) parenStack.push( *t );
-			else if ( (*t) -> value() == ")" ) parenStack.pop();
+				/*pop matching parentheses on/off the stack */
+				if ( (*t) -> value() == "(" ) parenStack.push( *t );
+				else if ( (*t) -> value() == ")" ) parenStack.pop();
 
-			/*find pivot */
-			if ( (*t) -> value() == *binaryOperator and parenStack.empty() ){
+				/*find pivot */
+				if ( (*t) -> value() == *binaryOperator and parenStack.empty() ){
 
-				/*push the operator to the tree */				
-				treeForLine.addChild( parentToken, *t );
+					/*push the operator to the tree */
+					treeForLine.addChild( parentToken, *t );
 
-				/*separate into LHS and RHS of pivot */
-				RHS.insert( RHS.end(), std::next(t), tokenisedLine.end() );
-				LHS.insert( LHS.end(), tokenisedLine.begin(), t );
-
-				/*recurse */
-				parseDefLine( *t, LHS, treeForLine );
-				parseDefLine( *t, RHS, treeForLine );
-				return;
+					/*recurse on the LHS, then carry on with the RHS */
+					parseDefLine( *t, first, t, treeForLine );
+					parentToken = *t;
+					first = std::next(t);
+					foundPivot = true;
+					break;
+				}
 			}
 		}
-	}
+		if ( foundPivot ) continue;
 
-	/*when we're done with the binary operators, we need to handle the unary ones (prefix and gates) */
-	for ( auto t = tokenisedLine.begin(); t < tokenisedLine.end(); t++ ){
-
-		/*pop matching parentheses on/off the stack */
-		if ( (*t) -> value() == "(" ) parenStack.push( *t );
-		else if ( (*t) -> value() == ")" ) parenStack.pop();
+		/*when we're done with the binary operators, we need to handle the unary ones (prefix and gates) */
+		for ( auto t = first; t < last; t++ ){
 
-		/*find pivot using reverse iterators */
-		if ( ( (*t) -> value() == "." or (*t) -> identify() == "Gate" ) and parenStack.empty() ){
+			/*pop matching parentheses on/off the stack */
+			if ( (*t) -> value() == "(" ) parenStack.push( *t );
+			else if ( (*t) -> value() == ")" ) parenStack.pop();
 
-			/*separate into LHS and RHS of pivot */
-			RHS.insert( RHS.end(), std::next(t), tokenisedLine.end() );
-			LHS.insert( LHS.end(), tokenisedLine.begin(), t );
+			/*find pivot */
+			if ( ( (*t) -> value() == "." or (*t) -> identify() == "Gate" ) and parenStack.empty() ){
 
-			if ( (*t) -> identify() == "Gate" ){
+				if ( (*t) -> identify() == "Gate" ){
 
-				/*at this point, the tokenised line should look something like [g] -> B.C so make sure LHS is empty*/
-				if ( LHS.size() != 0 ) throw SyntaxError( LHS[0], "Thrown by parser: Could not parse gate - check syntax." );
+					/*at this point, the tokenised line should look something like [g] -> B.C so make sure LHS is empty*/
+					if ( t != first ) throw SyntaxError( *first, "Thrown by parser: Could not parse gate - check syntax." );
 
-				/*push to the tree */
-				treeForLine.addChild( parentToken, *t );
+					/*push to the tree */
+					treeForLine.addChild( parentToken, *t );
 
-				/*recurse on the LHS (the RHS was added already) */
-				parseDefLine( *t, RHS, treeForLine );
-				return;
-			}
-			else if ( (*t) -> value() == "." ){
+					/*carry on with the RHS */
+					parentToken = *t;
+					first = std::next(t);
+				}
+				else{
 
-				/*at this point, the tokenised line should look something like A.B.C so make sure LHS just has an action*/
-				if ( LHS.size() != 1 ) throw SyntaxError( LHS[0], "Thrown by parser: Could not parse prefix action - check syntax." );
+					/*at this point, the tokenised line should look something like A.B.C so make sure LHS just has an action*/
+					if ( t - first != 1 ) throw SyntaxError( *first, "Thrown by parser: Could not parse prefix action - check syntax." );
 
-				/*push to the tree */
-				treeForLine.addChild( parentToken, LHS[0] );
+					/*push to the tree */
+					treeForLine.addChild( parentToken, *first );
 
-				/*recurse on the LHS (the RHS was added already) */
-				parseDefLine( LHS[0], RHS, treeForLine );
-				return;
+					/*carry on with the RHS */
+					parentToken = *first;
+					first = std::next(t);
+				}
+				foundPivot = true;
+				break;
 			}
 		}
-	}
-	
-	/*there are no combinators left.  At this point, the tokenised line should be a single token (leaf node) unless there are parentheses left to resolve */
-	if ( tokenisedLine.size() > 1 ){
+		if ( foundPivot ) continue;
+
+		/*there are no combinators left.  At this point, the tokenised line should be a single token (leaf node) unless there are parentheses left to resolve */
+		if ( last - first > 1 ){
 
-		/*if this line segment is enclosed by parentheses, erase those parentheses */
-		if ( (*(tokenisedLine.begin())) -> value() == "(" and (*(tokenisedLine.end() - 1)) -> value() == ")"  ) {
+			/*if this line segment is enclosed by parentheses, erase those parentheses */
+			if ( (*first) -> value() == "(" and (*(last - 1)) -> value() == ")"  ) {
 
-			tokenisedLine.erase( tokenisedLine.begin() );
-			tokenisedLine.erase( tokenisedLine.end() - 1 );
+				first++;
+				last--;
+				continue;
+			}
+			throw SyntaxError( *first, "Thrown by parser: Could not parse process definition - check syntax." );
 		}
 
-		parseDefLine( parentToken, tokenisedLine, treeForLine );
+		if ( first == last ) throw SyntaxError( parentToken, "Thrown by parser: Operator is missing an operand." );
+
+		treeForLine.addChild( parentToken, *first );
 		return;
 	}
+}
+
+
+void checkObserveLine( std::vector< Token * > &tokenisedLine ){
+/*called by parseSource, checks that an observable declaration has the form: observe name = [condition] -> P[a,b,...]
+ *where the gate is optional */
 
-	treeForLine.addChild( parentToken, tokenisedLine[0] );
+	Token *keyword = tokenisedLine[0];
+	if ( tokenisedLine.size() < 4 or tokenisedLine[2] -> identify() != "Assignment" ) throw SyntaxError( keyword, "Thrown by parser: Observables must be declared as observe name = P[a,b,...] or observe name = [condition] -> P[a,b,...]" );
+
+	unsigned int processIdx = 3;
+	if ( tokenisedLine[3] -> identify() == "Gate" ) processIdx = 4;
+
+	if ( tokenisedLine.size() != processIdx + 1 or tokenisedLine[processIdx] -> identify() != "Process" ){
+
+		throw SyntaxError( tokenisedLine.back(), "Thrown by parser: Observables must be declared as observe name = P[a,b,...] or observe name = [condition] -> P[a,b,...]" );
+	}
 }
 
 
-std::tuple< std::vector< Tree<Token> >, std::vector<Token *>, GlobalVariables > parseSource( std::vector< std::vector< Token * > > &tokenisedSource ){
+std::tuple< std::vector< Tree<Token> >, std::vector< SystemLineTerm >, GlobalVariables, std::vector< std::vector< Token * > > > parseSource( std::vector< std::vector< Token * > > &tokenisedSource ){
 /*creates a vector of parse trees, one for each line in the source code.  this is the main parsing function */
 
 	std::vector< Tree<Token> > treesFromSource;
-	std::vector< Token * > tokenisedSystemLine;
+	std::vector< SystemLineTerm > tokenisedSystemLine;
 	GlobalVariables variableName2Value;
+	std::vector< std::vector< Token * > > declarationLines;
 
 	bool systemLineFound = false;
 
@@ -302,6 +340,20 @@ std::tuple< std::vector< Tree<Token> >, std::vector<Token *>, GlobalVariables >
 		/*check for balanced parentheses */
 		matchParentheses( *tokenisedLine );
 
+		/*observable and stop declarations are handled by the block parser once the process definitions are known */
+		if ( tokenisedLine -> size() > 1 and (*tokenisedLine)[0] -> value() == "observe" and (*tokenisedLine)[1] -> identify() == "Variable" ){
+
+			checkObserveLine( *tokenisedLine );
+			declarationLines.push_back( *tokenisedLine );
+			continue;
+		}
+		if ( tokenisedLine -> size() > 1 and (*tokenisedLine)[0] -> value() == "stop" and (*tokenisedLine)[1] -> value() == "when" ){
+
+			if ( tokenisedLine -> size() == 2 ) throw SyntaxError( (*tokenisedLine)[1], "Thrown by parser: Stop condition cannot be empty." );
+			declarationLines.push_back( *tokenisedLine );
+			continue;
+		}
+
 		bool definitionLine = false;
 
 		/*for each token in that line, find the first parent token (which will be the root of the tree).  then start recursion */
@@ -325,8 +377,8 @@ std::tuple< std::vector< Tree<Token> >, std::vector<Token *>, GlobalVariables >
 				if ( LHS[0] -> identify() == "Process" ){
 
 					/*recurse */
-					parseDefLine( *token, LHS, treeForLine );
-					parseDefLine( *token, RHS, treeForLine );
+					parseDefLine( *token, LHS.begin(), LHS.end(), treeForLine );
+					parseDefLine( *token, RHS.begin(), RHS.end(), treeForLine );
 
 					checkProcessGrammar( treeForLine, treeForLine.getRoot() );
 					treesFromSource.push_back( treeForLine );
@@ -384,5 +436,5 @@ variableName2Value.printValues();
 #if defined DEBUG_PARSER_PROCCESSDEFS || defined DEBUG_PARSER_VARDEFS
 exit(EXIT_SUCCESS);
 #endif
-	return make_tuple( treesFromSource, tokenisedSystemLine, variableName2Value );
+	return make_tuple( std::move( treesFromSource ), std::move( tokenisedSystemLine ), variableName2Value, std::move( declarationLines ) );
 }
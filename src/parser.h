@@ -14,12 +14,16 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_set>
 #include <algorithm>
 #include <cassert>
 #include "lexer.h"
 #include "error_handling.h"
 #include "numerical.h"
 
+typedef std::vector< Token * >::const_iterator TokenIterator;
+
+
 template <class T>
 class Tree {
 
@@ -42,12 +46,28 @@ class Tree {
 			}
 			else return;
 		}
+		void detachSubtree( T *node, std::unordered_set< T * > &detached ){
+
+			if ( _children.count( node ) > 0 ){
+
+				std::vector< T * > &children = _children.at( node );
+				for ( auto c = children.begin(); c < children.end(); c++ ) detachSubtree( *c, detached );
+				_children.erase( node );
+			}
+			_parents.erase( node );
+			detached.insert( node );
+		}
+		bool contains( T *node ) const{
+		//every node but the root has a parent, so membership is a lookup rather than a scan of _nodes
+
+			return ( _rootSet and node == _root ) or _parents.count( node ) > 0;
+		}
 
 	public:
 		void addChild( T *parent, T *newChild ){
 
-			assert( std::find( _nodes.begin(), _nodes.end(), parent ) != _nodes.end() );
-			assert( std::find( _nodes.begin(), _nodes.end(), newChild ) == _nodes.end() );
+			assert( contains( parent ) );
+			assert( not contains( newChild ) );
 			assert( _rootSet );
 			_children[ parent ].push_back( newChild );
 			_parents[ newChild ] = parent;
@@ -84,7 +104,7 @@ class Tree {
 
 			assert( _rootSet );
 
-			if ( std::find( _nodes.begin(), _nodes.end(), node ) != _nodes.end() and _children.find( node ) == _children.end() ){
+			if ( contains( node ) and _children.find( node ) == _children.end() ){
 
 				return true;
 			}
@@ -114,39 +134,22 @@ class Tree {
 		inline void deleteNode( T *node ){
 
 			assert( _rootSet );
-			assert( std::find( _nodes.begin(), _nodes.end(), node ) != _nodes.end() );
-
-			if ( _children.count( node ) > 0 ){
+			assert( contains( node ) );
 
-				std::vector< T * > children = _children.at( node );
-				for ( auto c = children.begin(); c < children.end(); c++ ){
-
-					deleteNode( *c );
-				}
+			if ( not isRoot(node) ){
 
-				if ( not isRoot(node) ){
-
-					_children.at(_parents.at(node)).erase( std::find(_children.at(_parents.at(node)).begin(), _children.at(_parents.at(node)).end(), node ) );
-				}
-
-				_children.erase( _children.find( node ) );
-				_parents.erase( _parents.find( node ) );
-				_nodes.erase( std::find( _nodes.begin(), _nodes.end(), node ) );
+				std::vector< T * > &siblings = _children.at(_parents.at(node));
+				siblings.erase( std::find( siblings.begin(), siblings.end(), node ) );
 			}
-			else{
-
-				if ( not isRoot(node) ){
-
-					_children.at(_parents.at(node)).erase( std::find(_children.at(_parents.at(node)).begin(), _children.at(_parents.at(node)).end(), node ) );
-				}
 
-				_parents.erase( _parents.find( node ) );
-				_nodes.erase( std::find( _nodes.begin(), _nodes.end(), node ) );
-			}
+			/*drop the whole subtree from the maps, then take it out of _nodes in one pass */
+			std::unordered_set< T * > detached;
+			detachSubtree( node, detached );
+			_nodes.erase( std::remove_if( _nodes.begin(), _nodes.end(), [&detached]( T *n ){ return detached.count( n ) > 0; } ), _nodes.end() );
 		}
 		Tree< T > getSubtree( T *node ){
 
-			assert( std::find( _nodes.begin(), _nodes.end(), node ) != _nodes.end() );
+			assert( contains( node ) );
 
 			if ( node == _root ) return *this;
 
@@ -214,9 +217,21 @@ class GlobalVariables{
 	}
 };
 
+
+struct SystemLineTerm{
+//a process on the system line, with what's between its square brackets lexed once here so that
+//sweeps and ABC can evaluate the system line again without lexing it again
+
+	Token *process;
+	Token *multiplier = NULL; //variable or int literal giving the number of copies, if there is one
+	std::string processName;
+	std::vector< Token * > parameters; //tokens for the initial parameter values, still separated by commas
+};
+
+
 /*function prototypes */
-std::tuple< std::vector< Tree<Token> >, std::vector<Token *>, GlobalVariables > parseSource( std::vector< std::vector< Token * > > & );
-void parseDefLine( Token *, std::vector< Token * > &, Tree<Token> & );
-void printTree( Tree<Token>, Token * );//debugging
+std::tuple< std::vector< Tree<Token> >, std::vector< SystemLineTerm >, GlobalVariables, std::vector< std::vector< Token * > > > parseSource( std::vector< std::vector< Token * > > & );
+void parseDefLine( Token *, TokenIterator, TokenIterator, Tree<Token> & );
+void printTree( Tree<Token> &, Token * );//debugging
 
 #endif
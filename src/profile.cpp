@@ -0,0 +1,134 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <fstream>
+#include <iomanip>
+#include "profile.h"
+#include "lexer.h"
+#include "error_handling.h"
+
+static const char *phaseNames[NUM_PHASES] = { "other", "selection", "sumTransitionRates", "updateHandshakeCandidates", "updateBeaconCandidates", "condenseSystem", "output" };
+
+
+const char *phaseName( unsigned int phase ){
+
+	return phaseNames[phase];
+}
+
+
+void PhaseProfile::charge( void ){
+//gives the time and candidates since the last mark to whichever phase we're in
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	seconds[_current] += std::chrono::duration< double >( now - _mark ).count();
+	_mark = now;
+
+	int change = *_candidatesLeft - _candidatesMark;
+	if ( change > 0 ) candidatesCreated[_current] += change;
+	else candidatesDestroyed[_current] += -change;
+	_candidatesMark = *_candidatesLeft;
+}
+
+
+void PhaseProfile::begin( const int *candidatesLeft ){
+
+	_candidatesLeft = candidatesLeft;
+	_candidatesMark = *candidatesLeft;
+	_current = PHASE_OTHER;
+	_mark = std::chrono::steady_clock::now();
+}
+
+
+void PhaseProfile::end( unsigned long transitionsTaken ){
+
+	charge();
+	_candidatesLeft = NULL;
+	simulations++;
+	transitions += transitionsTaken;
+}
+
+
+ProfilePhase PhaseProfile::enter( ProfilePhase phase ){
+
+	if ( not _candidatesLeft ) return _current;
+	charge();
+	calls[phase]++;
+	ProfilePhase outer = _current;
+	_current = phase;
+	return outer;
+}
+
+
+void PhaseProfile::leave( ProfilePhase outer ){
+
+	if ( not _candidatesLeft ) return;
+	charge();
+	_current = outer;
+}
+
+
+void PhaseProfile::merge( const PhaseProfile &pp ){
+
+	for ( unsigned int p = 0; p < NUM_PHASES; p++ ){
+
+		seconds[p] += pp.seconds[p];
+		calls[p] += pp.calls[p];
+		candidatesCreated[p] += pp.candidatesCreated[p];
+		candidatesDestroyed[p] += pp.candidatesDestroyed[p];
+	}
+	simulations += pp.simulations;
+	transitions += pp.transitions;
+}
+
+
+void PhaseProfile::writeReport( std::ostream &out ) const{
+
+	double total = 0.0;
+	for ( unsigned int p = 0; p < NUM_PHASES; p++ ) total += seconds[p];
+
+	out << "Profile of " << simulations << " simulations and " << transitions << " transitions (seconds are summed over threads):" << std::endl;
+	out << std::left << std::setw(28) << "phase" << std::right << std::setw(12) << "seconds" << std::setw(8) << "%" << std::setw(14) << "calls" << std::setw(14) << "created" << std::setw(14) << "destroyed" << std::endl;
+	for ( unsigned int p = 0; p < NUM_PHASES; p++ ){
+
+		out << std::left << std::setw(28) << phaseNames[p] << std::right << std::fixed << std::setprecision(3) << std::setw(12) << seconds[p];
+		out << std::setprecision(1) << std::setw(8) << ( ( total > 0.0 ) ? 100.0 * seconds[p] / total : 0.0 );
+		out << std::setw(14) << calls[p] << std::setw(14) << candidatesCreated[p] << std::setw(14) << candidatesDestroyed[p] << std::endl;
+	}
+	out << std::defaultfloat;
+}
+
+
+void PhaseProfile::writeJSON( std::ostream &out ) const{
+
+	out << "{" << std::endl;
+	out << "  \"simulations\": " << simulations << "," << std::endl;
+	out << "  \"transitions\": " << transitions << "," << std::endl;
+	out << "  \"phases\": [" << std::endl;
+	for ( unsigned int p = 0; p < NUM_PHASES; p++ ){
+
+		out << "    {\"phase\": \"" << phaseNames[p] << "\", \"seconds\": " << std::setprecision(9) << seconds[p] << ", \"calls\": " << calls[p];
+		out << ", \"candidatesCreated\": " << candidatesCreated[p] << ", \"candidatesDestroyed\": " << candidatesDestroyed[p] << "}";
+		if ( p + 1 < NUM_PHASES ) out << ",";
+		out << std::endl;
+	}
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
+
+
+void writeProfile( std::vector< PhaseProfile > &threadProfiles, std::string filename ){
+//merges the profile of each thread, prints the report, and writes the same numbers as JSON
+
+	for ( unsigned int t = 1; t < threadProfiles.size(); t++ ) threadProfiles[0].merge( threadProfiles[t] );
+
+	threadProfiles[0].writeReport( std::cout );
+
+	std::ofstream profileFile( filename );
+	if ( not profileFile.is_open() ) throw BadOutputPath();
+	threadProfiles[0].writeJSON( profileFile );
+}
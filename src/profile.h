@@ -0,0 +1,73 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <iostream>
+
+/*phases of a simulation that the profiler keeps time for */
+enum ProfilePhase { PHASE_OTHER = 0, PHASE_SELECTION, PHASE_RATES, PHASE_HANDSHAKES, PHASE_BEACONS, PHASE_CONDENSE, PHASE_OUTPUT, NUM_PHASES };
+
+
+class PhaseProfile{
+//time, calls, and changes in the number of candidates in each phase
+//time is exclusive: entering a phase inside another one stops the clock on the outer phase until the inner one is left,
+//and in the same way candidates added or removed by the inner phase aren't counted against the outer one
+
+	private:
+		std::chrono::steady_clock::time_point _mark;
+		int _candidatesMark = 0;
+		const int *_candidatesLeft = NULL;
+		ProfilePhase _current = PHASE_OTHER;
+		void charge( void );
+
+	public:
+		double seconds[NUM_PHASES] = {};
+		unsigned long calls[NUM_PHASES] = {};
+		unsigned long candidatesCreated[NUM_PHASES] = {}, candidatesDestroyed[NUM_PHASES] = {};
+		unsigned long simulations = 0, transitions = 0;
+		void begin( const int * );
+		void end( unsigned long );
+		ProfilePhase enter( ProfilePhase );
+		void leave( ProfilePhase );
+		void merge( const PhaseProfile & );
+		void writeReport( std::ostream & ) const;
+		void writeJSON( std::ostream & ) const;
+};
+
+
+class PhaseTimer{
+//scoped timer for one phase that does nothing if profiling is off
+
+	private:
+		PhaseProfile *_profile;
+		ProfilePhase _outer = PHASE_OTHER;
+
+	public:
+		PhaseTimer( PhaseProfile *profile, ProfilePhase phase ) : _profile(profile) {
+
+			if ( _profile ) _outer = _profile -> enter( phase );
+		}
+		~PhaseTimer(){ stop(); }
+		void stop( void ){
+
+			if ( _profile ) _profile -> leave( _outer );
+			_profile = NULL;
+		}
+};
+
+
+/*function prototypes */
+void writeProfile( std::vector< PhaseProfile > &, std::string );
+const char *phaseName( unsigned int );
+
+#endif
@@ -14,43 +14,116 @@
 #include <sstream>
 #include <random>
 #include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <omp.h>
+#include <unistd.h>
+#include <atomic>
+#include <exception>
 #include "blockParser.h"
 #include "error_handling.h"
 #include "simulator.h"
 #include "evaluate_trees.h"
 #include "common.h"
 
-System::System( std::list< SystemProcess > &s, std::map< std::string, ProcessDefinition > &processDefs, int mT, double mD, GlobalVariables &globalVars ){
+System::System( const GridPoint &point, std::map< std::string, ProcessDefinition > &processDefs, const std::vector< ObservableDefinition > &observables, const std::vector< StopCondition > &stopConditions, const SimulationOptions &options, const OutputTables &tables, std::string checkpointFilename, bool resume, const std::string *burnInState ) : _tables(tables) {
 
 	_name2ProcessDef = processDefs;
-	_maxTransitions = mT;
-	_maxDuration = mD;
-	_globalVars = globalVars;
+	_maxTransitions = options.maxTransitions;
+	_maxDuration = options.maxDuration;
+	_sampleInterval = options.sampleInterval;
+	_observeProcesses = options.observeProcesses;
+	_observables = observables;
+	_observableCounts.assign( observables.size(), 0 );
+	for ( auto o = _observeProcesses.begin(); o < _observeProcesses.end(); o++ ){
+
+		int index = -1;
+		for ( unsigned int i = 0; i < observables.size(); i++ ){
+
+			if ( observables[i].name == *o ) index = i;
+		}
+		_observeIndex.push_back( index );
+	}
+	_writeOutput = not ( options.aggregate or options.firstPassage or options.inference );
+
+	_stopConditions = stopConditions;
+	_actionCounts.assign( tables.actions.size(), 0 );
+	_stopOnAction.assign( tables.actions.size(), false );
+	for ( auto sc = stopConditions.begin(); sc < stopConditions.end(); sc++ ){
 
-	for ( auto i = s.begin(); i != s.end(); i++ ){
+		std::vector< unsigned int > actionIDs;
+		for ( auto a = (sc -> actionNames).begin(); a < (sc -> actionNames).end(); a++ ){
 
-		_currentProcesses.push_back( new SystemProcess( *i ) );
+			unsigned int id = std::find( tables.actions.begin(), tables.actions.end(), *a ) - tables.actions.begin();
+			actionIDs.push_back( id );
+			_stopOnAction[id] = true;
+		}
+		_stopActionIDs.push_back( actionIDs );
 	}
 
-	//do an initial pass through the whole system
-	std::list< SystemProcess * > newProcesses;
-	for ( auto sp = _currentProcesses.begin(); sp != _currentProcesses.end(); sp++ ){
+	_globalVars = point.globalVars;
+	_writer = std::shared_ptr< TrajectoryWriter >( newTrajectoryWriter( options.outputFormat, tables ) );
+
+	std::random_device rd;
+	_rng.seed( rd() );
+	_checkpointFilename = checkpointFilename;
+	if ( not checkpointFilename.empty() ) _checkpointEvery = options.checkpointEvery;
+
+	if ( resume ){
+
+		//the processes, beacon databases, and output so far come from the checkpoint, and the candidates are rebuilt from them below
+		readCheckpoint();
+	}
+	else{
+
+		if ( point.names.empty() ) _writer -> beginSimulation();
+		else _writer -> beginGridPoint( point.index, point.names, point.values );
+	}
+
+	if ( burnInState ){
+
+		//a fork starts from the state the burn-in reached, but with its own random number stream
+		size_t pos = 0;
+		if ( not restoreState( *burnInState, pos ) ) throw BadCheckpoint( "the burn-in state is incomplete." );
+		_rng.seed( rd() );
+	}
+	else if ( not resume ){
+
+		for ( auto i = point.system.begin(); i != point.system.end(); i++ ){
+
+			_currentProcesses.push_back( new SystemProcess( *i ) );
+		}
 
-		//see if we can make multiple system processes out of this one by splitting on parallel operators
-		if ( ((*sp) -> parseTree).getRoot() -> identify() == "Parallel" ){
+		//do an initial pass through the whole system
+		std::list< SystemProcess * > newProcesses;
+		for ( auto sp = _currentProcesses.begin(); sp != _currentProcesses.end(); sp++ ){
+
+			//see if we can make multiple system processes out of this one by splitting on parallel operators
+			if ( ((*sp) -> parseTree).getRoot() -> identify() == "Parallel" ){
 
-			splitOnParallel( *sp, ((*sp) -> parseTree).getRoot(), newProcesses );
-			delete *sp;
-			sp = _currentProcesses.erase( sp );
+				splitOnParallel( *sp, ((*sp) -> parseTree).getRoot(), newProcesses );
+				delete *sp;
+				sp = _currentProcesses.erase( sp );
+			}
 		}
+		_currentProcesses.insert( _currentProcesses.end(), newProcesses.begin(), newProcesses.end() );
 	}
-	_currentProcesses.insert( _currentProcesses.end(), newProcesses.begin(), newProcesses.end() );
 
 	//sum the transition rates for non-handshake candidates while building a list of handshake candidates
 	std::list< SystemProcess > parallelProcesses;
 	for ( auto s = _currentProcesses.begin(); s != _currentProcesses.end(); s++ ){
 
 		sumTransitionRates( *s, (*s) -> parseTree, ((*s) -> parseTree).getRoot(), parallelProcesses, (*s) -> parameterValues );
+		updateObservables( *s, (*s) -> clones );
+	}
+	if ( resume ) _observablesChanged = false;
+	else if ( _observables.size() > 0 and _writeOutput ){
+
+		_observableBuffer += ">=======";
+		if ( not point.names.empty() ) appendGridLabel( _observableBuffer, point.index, point.names, point.values );
+		_observableBuffer += '\n';
+		if ( _sampleInterval <= 0.0 ) writeObservableLine( _observableBuffer, _totalTime, _observableCounts );
+		_observablesChanged = false;
 	}
 
 	//sum handshake transitions
@@ -62,56 +135,425 @@ System::System( std::list< SystemProcess > &s, std::map< std::string, ProcessDef
 		_candidatesLeft += newHandshakesAdded;
 		_rateSum += rateSumIncrease;
 	}
+
+	_metricsEvery = options.metricsEvery;
+	if ( _metricsEvery > 0 ){
+
+		_metricsBuffer += ">=======";
+		if ( not point.names.empty() ) appendGridLabel( _metricsBuffer, point.index, point.names, point.values );
+		_metricsBuffer += '\n';
+	}
 }
 
 
-std::string System::writeChannelName( std::vector< std::vector< Token * > > channelName ){
+void System::writeTransition( double time, std::shared_ptr<Candidate> chosen ){
 
-	std::string out;
-	for ( auto i = channelName.begin(); i < channelName.end(); i++ ){ //for each comma-separated value
+	//every transition comes through here, so keep count of action firings for stop conditions
+	if ( _stopConditions.size() > 0 ){
 
-		for ( auto j = (*i).begin(); j < (*i).end(); j++ ){ //for each token in that value
+		const TransitionLabel &l = _tables.getLabel( chosen -> actionCandidate );
+		if ( not l.isChannel ){
 
-			out += (*j) -> value();
+			_actionCounts[l.labelID]++;
+			if ( _stopOnAction[l.labelID] ) _stopConditionsChanged = true;
 		}
-		if (i != channelName.end() - 1) out += ',';
 	}
-	return out;
+
+	if ( _writeOutput and _sampleInterval <= 0.0 and _writer -> isRecorded( chosen -> actionCandidate ) ){
+
+		PhaseTimer timer( _profile, PHASE_OUTPUT );
+		_writer -> writeTransition( time, chosen -> actionCandidate, chosen -> parameterValues );
+	}
 }
 
 
-void System::writeTransition( double time, std::shared_ptr<Candidate> chosen, std::stringstream &ss ){
+struct SnapshotKey{
 
-	Block *actionDone = chosen -> actionCandidate;
-	std::vector< std::string > parameterNames = _name2ProcessDef[ actionDone -> getOwningProcess()].parameters;
+	unsigned int processID;
+	std::vector< Numerical > values;
+};
 
-	if ( actionDone -> identify() == "Action" ){
 
-		ActionBlock *ab = static_cast< ActionBlock * >( actionDone );
-		ss << time << '\t' << ab -> actionName << '\t' << actionDone -> getOwningProcess();
-	}
-	else if ( actionDone -> identify() == "MessageSend" ){
+struct compareSnapshotKeys{
+//orders snapshot groups by process, then by parameter values with ints before doubles
 
-		MessageSendBlock *msb = static_cast< MessageSendBlock * >( actionDone );
-		ss << time << '\t' << writeChannelName(msb -> getChannelName()) << '\t' << actionDone -> getOwningProcess();
+	bool operator()( const SnapshotKey &k1, const SnapshotKey &k2 ) const {
+
+		if ( k1.processID != k2.processID ) return k1.processID < k2.processID;
+		for ( unsigned int i = 0; i < k1.values.size() and i < k2.values.size(); i++ ){
+
+			Numerical n1 = k1.values[i], n2 = k2.values[i];
+			if ( n1.isInt() != n2.isInt() ) return n1.isInt();
+			if ( n1 == n2 ) continue;
+			return n1.doubleCast() < n2.doubleCast();
+		}
+		return k1.values.size() < k2.values.size();
 	}
-	else if ( actionDone -> identify() == "MessageReceive" ){
+};
 
-		MessageReceiveBlock *mrb = static_cast< MessageReceiveBlock * >( actionDone );
-		ss << time << '\t' << writeChannelName(mrb -> getChannelName())  << '\t' << actionDone -> getOwningProcess();
+
+Block *System::resolveProcessCalls( SystemProcess *sp ){
+//a system process that starts with a process block (e.g., FR[i+1]) is really an instance of the process it calls
+//sumTransitionRates has already evaluated the call into the system process's parameter values, so only follow the blocks
+
+	Block *root = (sp -> parseTree).getRoot();
+	while ( root -> identify() == "Process" ){
+
+		ProcessBlock *pb = static_cast< ProcessBlock * >( root );
+		root = _name2ProcessDef[ pb -> getProcessName() ].parseTree.getRoot();
 	}
+	return root;
+}
 
+
+void System::snapshotIdentity( SystemProcess *sp, std::string &processName, std::vector< Numerical > &values ){
+//the process a system process is an instance of, and the values of that process's parameters
+
+	processName = resolveProcessCalls( sp ) -> getOwningProcess();
+	std::vector< std::string > parameterNames = _name2ProcessDef[ processName ].parameters;
 	for ( auto p = parameterNames.begin(); p < parameterNames.end(); p++ ){
 
-		if ( (chosen -> parameterValues).values.count(*p) > 0 ){
-	
-			Numerical val = (chosen -> parameterValues).values[*p];
+		values.push_back( (sp -> parameterValues).values.at( *p ) );
+	}
+}
+
+
+void System::updateObservables( SystemProcess *sp, long change ){
+//called whenever copies of sp are added to or removed from the system so that observables never need a scan of the whole system
+
+	if ( _observables.empty() ) return;
+
+	std::string processName;
+	std::vector< Numerical > values;
+	snapshotIdentity( sp, processName, values );
+
+	for ( unsigned int i = 0; i < _observables.size(); i++ ){
+
+		ObservableDefinition &od = _observables[i];
+		if ( od.processName != processName ) continue;
+
+		if ( od.RPNcondition.size() > 0 ){
+
+			ParameterValues bound;
+			for ( unsigned int j = 0; j < od.bindingNames.size(); j++ ) bound.updateValue( od.bindingNames[j], values[j] );
+			std::map< std::string, Numerical > noLocals;
+			if ( not evalRPN_condition( od.RPNcondition, bound, _globalVars, noLocals ) ) continue;
+		}
+
+		_observableCounts[i] += change;
+		_observablesChanged = true;
+		_stopConditionsChanged = true;
+	}
+}
+
+
+bool System::stopConditionHolds( void ){
+//true if any of the stop conditions hold for the current observable values and action counts
+
+	for ( unsigned int i = 0; i < _stopConditions.size(); i++ ){
+
+		StopCondition &sc = _stopConditions[i];
+		ParameterValues counts;
+		for ( auto o = sc.observables.begin(); o < sc.observables.end(); o++ ){
+
+			Numerical n;
+			n.setInt( _observableCounts[*o] );
+			counts.updateValue( _observables[*o].name, n );
+		}
+		for ( unsigned int j = 0; j < sc.actionNames.size(); j++ ){
+
+			Numerical n;
+			n.setInt( _actionCounts[ _stopActionIDs[i][j] ] );
+			counts.updateValue( sc.actionNames[j], n );
+		}
+
+		std::map< std::string, Numerical > noLocals;
+		if ( evalRPN_condition( sc.RPNcondition, counts, _globalVars, noLocals ) ) return true;
+	}
+	return false;
+}
+
+
+void System::writeSnapshot( double time ){
+//counts the live system processes, grouped by process and parameter values, and writes one line per group
+//if we're aggregating over simulations, just count the observed processes and hand them to the aggregator
+
+	if ( _aggregator ){
+
+		std::vector< size_t > observed( _observeProcesses.size(), 0 );
+		if ( std::count( _observeIndex.begin(), _observeIndex.end(), -1 ) > 0 ){
+
+			for ( auto sp = _currentProcesses.begin(); sp != _currentProcesses.end(); sp++ ){
+
+				std::string processName;
+				std::vector< Numerical > values;
+				snapshotIdentity( *sp, processName, values );
+				for ( unsigned int o = 0; o < _observeProcesses.size(); o++ ){
+
+					if ( _observeIndex[o] == -1 and _observeProcesses[o] == processName ) observed[o] += (*sp) -> clones;
+				}
+			}
+		}
+		for ( unsigned int o = 0; o < observed.size(); o++ ){
+
+			if ( _observeIndex[o] != -1 ) observed[o] = _observableCounts[ _observeIndex[o] ];
+			_aggregator -> add( _samplesTaken, o, observed[o] );
+		}
+		return;
+	}
+
+	if ( not _writeOutput ) return;
+	if ( _observables.size() > 0 ) writeObservableLine( _observableBuffer, time, _observableCounts );
+
+	std::map< SnapshotKey, size_t, compareSnapshotKeys > counts;
+
+	for ( auto sp = _currentProcesses.begin(); sp != _currentProcesses.end(); sp++ ){
+
+		std::string processName;
+		SnapshotKey key;
+		snapshotIdentity( *sp, processName, key.values );
+		key.processID = _tables.getProcessID( processName );
+		if ( not _tables.isProcessRecorded( key.processID ) ) continue;
+		counts[key] += (*sp) -> clones;
+	}
+
+	for ( auto c = counts.begin(); c != counts.end(); c++ ){
+
+		std::vector< Numerical > values = (c -> first).values;
+		_writer -> writeSnapshot( time, (c -> first).processID, c -> second, values );
+	}
+}
+
+
+void System::writeSnapshotsBefore( double time ){
+//the system doesn't change between transitions, so every grid point before the next transition sees the current state
+
+	if ( _sampleInterval <= 0.0 ) return;
+
+	double nextSample = _samplesTaken * _sampleInterval;
+	while ( nextSample < time and nextSample <= _maxDuration ){
+
+		writeSnapshot( nextSample );
+		_samplesTaken++;
+		nextSample = _samplesTaken * _sampleInterval;
+	}
+}
+
+
+void System::recordSummariesBefore( double time ){
+//like snapshots, the observables at each time in the observed data are whatever they were after the last transition before it
+
+	if ( not _observedData ) return;
+
+	const std::vector< double > &times = _observedData -> times;
+	const std::vector< unsigned int > &columns = _observedData -> columns;
+	while ( _summaryTimesTaken < times.size() and times[_summaryTimesTaken] < time ){
+
+		for ( auto c = columns.begin(); c < columns.end(); c++ ) _summaries.push_back( _observableCounts[*c] );
+		_summaryTimesTaken++;
+	}
+}
+
+
+/*CHECKPOINTS-------------------------------------------------------------------------------------------------------------------------------------------------------*/
+static void appendToSpool( const std::string &filename, const std::string &buffer, size_t &spooled ){
+
+	if ( buffer.size() == spooled ) return;
+	std::ofstream spool( filename, std::ios::binary | std::ios::app );
+	if ( not spool.is_open() ) throw BadOutputPath();
+	spool.write( buffer.data() + spooled, buffer.size() - spooled );
+	spooled = buffer.size();
+}
+
+
+static void readSpool( const std::string &filename, size_t length, std::string &buffer ){
+//anything past the length in the checkpoint was appended after it and is cut off, so the next checkpoint appends in the right place
+
+	buffer.clear();
+	if ( length == 0 ){
+
+		std::remove( filename.c_str() );
+		return;
+	}
+
+	std::ifstream spool( filename, std::ios::binary );
+	if ( not spool.is_open() ) throw BadCheckpoint( filename + " is missing." );
+	buffer.resize( length );
+	if ( not spool.read( &buffer[0], length ) ) throw BadCheckpoint( filename + " is shorter than its checkpoint says." );
+	spool.close();
+	if ( truncate( filename.c_str(), length ) != 0 ) throw BadCheckpoint( "could not truncate " + filename + "." );
+}
+
+
+void System::saveState( std::string &state ){
+//everything needed to carry on simulating from this point, used for checkpoints and for forking simulations from a burn-in
+//candidate pools aren't written at all - they're rebuilt from the processes and beacon databases when the state is restored
+
+	writeFixed64( state, _totalTime );
+	writeVarint( state, _transitionsTaken );
+	writeVarint( state, _samplesTaken );
+
+	std::stringstream rngState;
+	rngState << _rng;
+	writeString( state, rngState.str() );
+
+	writeVarint( state, _actionCounts.size() );
+	for ( auto c = _actionCounts.begin(); c < _actionCounts.end(); c++ ) writeVarint( state, *c );
+
+	//each process is the block it's up to, which identifies both the process definition and the subtree left to run
+	//process calls have already been evaluated into the parameter values, so they're skipped to avoid evaluating them again
+	writeVarint( state, _currentProcesses.size() );
+	for ( auto sp = _currentProcesses.begin(); sp != _currentProcesses.end(); sp++ ){
+
+		writeVarint( state, resolveProcessCalls( *sp ) -> getID() );
+		writeVarint( state, (*sp) -> clones );
+		writeNumericalMap( state, ((*sp) -> parameterValues).values );
+		writeNumericalMap( state, (*sp) -> localVariables );
+	}
+
+	writeVarint( state, _beacons_Name2Channel.size() );
+	for ( auto chan = _beacons_Name2Channel.begin(); chan != _beacons_Name2Channel.end(); chan++ ){
+
+		writeVarint( state, (chan -> first).size() );
+		for ( auto n = (chan -> first).begin(); n < (chan -> first).end(); n++ ) writeString( state, *n );
+
+		std::vector< std::vector< int > > entries = (chan -> second) -> databaseEntries();
+		writeVarint( state, entries.size() );
+		for ( auto e = entries.begin(); e < entries.end(); e++ ){
+
+			writeVarint( state, e -> size() );
+			for ( auto i = e -> begin(); i < e -> end(); i++ ) writeVarint( state, zigzag( *i ) );
+		}
+	}
+}
+
+
+bool System::restoreState( const std::string &state, size_t &pos ){
+
+	uint64_t v, n;
+	bool ok = readFixed64( state, pos, _totalTime );
+	ok = ok and readVarint( state, pos, v );
+	_transitionsTaken = v;
+	ok = ok and readVarint( state, pos, v );
+	_samplesTaken = v;
 
-			if (val.isInt()) ss << '\t' << *p << '\t' << val.getInt();
-			else ss << '\t' << *p << '\t' << val.getDouble();
+	std::string rngState;
+	ok = ok and readString( state, pos, rngState );
+	std::stringstream rngStream( rngState );
+	rngStream >> _rng;
+
+	ok = ok and readVarint( state, pos, n ) and n == _actionCounts.size();
+	for ( uint64_t i = 0; ok and i < n; i++ ){
+
+		ok = readVarint( state, pos, v );
+		_actionCounts[i] = v;
+	}
+	if ( not ok ) return false;
+
+	//find each block by its ID so that processes can be put back at the point they'd reached
+	std::map< unsigned int, std::pair< Block *, std::string > > id2Block;
+	for ( auto pd = _name2ProcessDef.begin(); pd != _name2ProcessDef.end(); pd++ ){
+
+		std::vector< Block * > nodes = (pd -> second).parseTree.getNodes();
+		for ( auto b = nodes.begin(); b < nodes.end(); b++ ) id2Block[ (*b) -> getID() ] = std::make_pair( *b, pd -> first );
+	}
+
+	ok = readVarint( state, pos, n );
+	for ( uint64_t i = 0; ok and i < n; i++ ){
+
+		uint64_t blockID, clones;
+		ok = readVarint( state, pos, blockID ) and readVarint( state, pos, clones ) and id2Block.count( blockID ) > 0;
+		if ( not ok ) break;
+
+		SystemProcess *sp = new SystemProcess();
+		std::pair< Block *, std::string > &location = id2Block[ blockID ];
+		sp -> parseTree = _name2ProcessDef[ location.second ].parseTree.getSubtree( location.first );
+		sp -> clones = clones;
+		ok = readNumericalMap( state, pos, (sp -> parameterValues).values ) and readNumericalMap( state, pos, sp -> localVariables );
+		_currentProcesses.push_back( sp );
+	}
+
+	ok = ok and readVarint( state, pos, n );
+	for ( uint64_t i = 0; ok and i < n; i++ ){
+
+		uint64_t nameLength, numEntries, arity;
+		std::vector< std::string > channelName( 0 );
+		ok = readVarint( state, pos, nameLength );
+		for ( uint64_t j = 0; ok and j < nameLength; j++ ){
+
+			std::string part;
+			ok = readString( state, pos, part );
+			channelName.push_back( part );
+		}
+
+		std::vector< std::vector< int > > entries;
+		ok = ok and readVarint( state, pos, numEntries );
+		for ( uint64_t j = 0; ok and j < numEntries; j++ ){
+
+			std::vector< int > entry;
+			ok = readVarint( state, pos, arity );
+			for ( uint64_t k = 0; ok and k < arity; k++ ){
+
+				ok = readVarint( state, pos, v );
+				entry.push_back( unzigzag( v ) );
+			}
+			entries.push_back( entry );
 		}
+
+		std::shared_ptr< BeaconChannel > channel( new BeaconChannel( channelName, _globalVars, &_memo ) );
+		channel -> restoreDatabase( entries );
+		_beacons_Name2Channel[ channelName ] = channel;
+	}
+	return ok;
+}
+
+
+void System::writeCheckpoint( void ){
+//output written since the last checkpoint is appended to spool files so that a checkpoint costs the same however long the
+//simulation has been running; the state itself is written to a temporary file and renamed over the last checkpoint so that
+//an interrupted checkpoint never leaves a half-written file behind
+
+	appendToSpool( _checkpointFilename + ".trajectory", _writer -> buffer(), _spooledTrajectory );
+	appendToSpool( _checkpointFilename + ".observables", _observableBuffer, _spooledObservables );
+
+	std::string state = CHECKPOINT_MAGIC;
+	writeVarint( state, CHECKPOINT_FORMAT_VERSION );
+	writeVarint( state, _spooledTrajectory );
+	writeVarint( state, _spooledObservables );
+	_writer -> writeState( state );
+	saveState( state );
+
+	std::string tempFilename = _checkpointFilename + ".tmp";
+	std::ofstream checkpointFile( tempFilename, std::ios::binary );
+	if ( not checkpointFile.is_open() ) throw BadOutputPath();
+	checkpointFile.write( state.data(), state.size() );
+	checkpointFile.close();
+	if ( std::rename( tempFilename.c_str(), _checkpointFilename.c_str() ) != 0 ) throw BadOutputPath();
+}
+
+
+void System::readCheckpoint( void ){
+
+	std::ifstream checkpointFile( _checkpointFilename, std::ios::binary );
+	if ( not checkpointFile.is_open() ) throw BadCheckpoint( "could not open " + _checkpointFilename + "." );
+	std::string state( ( std::istreambuf_iterator< char >( checkpointFile ) ), std::istreambuf_iterator< char >() );
+
+	size_t pos = strlen( CHECKPOINT_MAGIC );
+	uint64_t version;
+	if ( state.compare( 0, pos, CHECKPOINT_MAGIC ) != 0 or not readVarint( state, pos, version ) or version != CHECKPOINT_FORMAT_VERSION ){
+
+		throw BadCheckpoint( _checkpointFilename + " is not a bcs checkpoint from this version." );
 	}
-	ss << std::endl;
+
+	uint64_t trajectoryLength = 0, observablesLength = 0;
+	bool ok = readVarint( state, pos, trajectoryLength ) and readVarint( state, pos, observablesLength );
+	ok = ok and _writer -> readState( state, pos ) and restoreState( state, pos );
+	if ( not ok ) throw BadCheckpoint( _checkpointFilename + " is incomplete." );
+
+	readSpool( _checkpointFilename + ".trajectory", trajectoryLength, _writer -> buffer() );
+	readSpool( _checkpointFilename + ".observables", observablesLength, _observableBuffer );
+	_spooledTrajectory = trajectoryLength;
+	_spooledObservables = observablesLength;
 }
 
 
@@ -191,7 +633,7 @@ void System::sumTransitionRates( SystemProcess *sp,
 
 	if ( current -> identify() == "Action" ){
 
-		Numerical rate = evalRPN_numerical( current -> getRate(), currentParameters, _globalVars, sp -> localVariables );
+		Numerical rate = _memo.rate( current, currentParameters, _globalVars, sp -> localVariables );
 		if ( rate.doubleCast() <= 0 ) throw BadRate( current -> getToken() );
 		std::shared_ptr<Candidate> cand( new Candidate( current, currentParameters, sp -> localVariables, sp, parallelProcesses ) );
 		cand -> rate = rate.doubleCast();
@@ -206,7 +648,7 @@ void System::sumTransitionRates( SystemProcess *sp,
 
 		if ( msb -> isHandshake() ){
 
-			Numerical rate = evalRPN_numerical( msb -> getRate(), currentParameters, _globalVars, sp -> localVariables );
+			Numerical rate = _memo.rate( msb, currentParameters, _globalVars, sp -> localVariables );
 			if ( rate.doubleCast() <= 0 ) throw BadRate( current -> getToken() );
 
 			std::shared_ptr< Candidate > cand( new Candidate( msb, currentParameters, sp -> localVariables, sp, parallelProcesses) );
@@ -226,7 +668,7 @@ void System::sumTransitionRates( SystemProcess *sp,
 				_handshakes_Name2Channel[channelName] -> addSendCandidate(cand);
 			}
 			else{
-				std::shared_ptr< HandshakeChannel > newChannel(new HandshakeChannel(channelName, _globalVars));
+				std::shared_ptr< HandshakeChannel > newChannel(new HandshakeChannel(channelName, _globalVars, &_memo));
 				_handshakes_Name2Channel[channelName] = newChannel;
 				_handshakes_Name2Channel[channelName] -> addSendCandidate(cand);
 			}
@@ -238,7 +680,7 @@ void System::sumTransitionRates( SystemProcess *sp,
 				_beacons_Name2Channel[channelName] -> addCandidate( current, sp, parallelProcesses, currentParameters, _candidatesLeft, _rateSum );
 			}
 			else{
-				std::shared_ptr< BeaconChannel > newChannel( new BeaconChannel(channelName, _globalVars) );
+				std::shared_ptr< BeaconChannel > newChannel( new BeaconChannel(channelName, _globalVars, &_memo) );
 				_beacons_Name2Channel[channelName] = newChannel;
 				_beacons_Name2Channel[channelName] -> addCandidate( current, sp, parallelProcesses, currentParameters, _candidatesLeft, _rateSum );
 			}
@@ -258,7 +700,7 @@ void System::sumTransitionRates( SystemProcess *sp,
 				_handshakes_Name2Channel[channelName] -> addReceiveCandidate(cand);
 			}
 			else{
-				std::shared_ptr< HandshakeChannel > newChannel( new HandshakeChannel(channelName, _globalVars) );
+				std::shared_ptr< HandshakeChannel > newChannel( new HandshakeChannel(channelName, _globalVars, &_memo) );
 				_handshakes_Name2Channel[channelName] = newChannel;
 				_handshakes_Name2Channel[channelName] -> addReceiveCandidate(cand);
 			}
@@ -271,7 +713,7 @@ void System::sumTransitionRates( SystemProcess *sp,
 			}
 			else{
 
-				std::shared_ptr< BeaconChannel > newChannel( new BeaconChannel(channelName, _globalVars) );
+				std::shared_ptr< BeaconChannel > newChannel( new BeaconChannel(channelName, _globalVars, &_memo) );
 				_beacons_Name2Channel[channelName] = newChannel;
 				_beacons_Name2Channel[channelName] -> addCandidate( current, sp, parallelProcesses, currentParameters, _candidatesLeft, _rateSum );
 			}
@@ -280,7 +722,7 @@ void System::sumTransitionRates( SystemProcess *sp,
 	else if ( current -> identify() == "Gate" ){
 
 		GateBlock *gb = static_cast< GateBlock * >( current );
-		bool gateConditionHolds = evalRPN_condition( gb -> getConditionExpression(), currentParameters, _globalVars, sp -> localVariables );
+		bool gateConditionHolds = _memo.condition( gb, currentParameters, _globalVars, sp -> localVariables );
 		if ( gateConditionHolds ){
 
 			std::vector< Block * > children = bt.getChildren(current);
@@ -435,9 +877,12 @@ void System::removeChosenFromSystem( std::shared_ptr<Candidate> candToRemove, bo
 	//reshuffle potential vs active beacon receives, but only do this if database was updated, and only do it on the channel that was updated
 	if (databaseUpdated){
 
+		PhaseTimer timer( _profile, PHASE_BEACONS );
 		_beacons_Name2Channel[candToRemove -> beaconChannelName] -> updateBeaconCandidates(_candidatesLeft,_rateSum);
 	}
 
+	updateObservables( sp, -1 );
+
 #if DEBUG
 std::cout << "   Removing chosen from system " << sp << std::endl;
 std::cout << "   It has clones: " << sp -> clones << std::endl;
@@ -531,6 +976,7 @@ bool System::condenseSystem(SystemProcess *sp){
 
 		SystemProcess *mp = matchingProcesses[0];
 		mp -> clones += 1;
+		updateObservables( mp, 1 );
 
 		//delete from non messaging actions
 		if (_nonMsgCandidates.count(sp) > 0) _nonMsgCandidates.erase( sp );
@@ -562,13 +1008,39 @@ std::cout << "   Current clones of match " << mp -> clones << std::endl;
 
 void System::simulate(void){
 
+	if ( _profile ) _profile -> begin( &_candidatesLeft );
+	sampleMetrics();
+
+	//the system might already satisfy a stop condition before anything happens
+	if ( _stopConditions.size() > 0 and stopConditionHolds() ){
+
+		_stopped = true;
+		_stopTime = _totalTime;
+		recordSummariesBefore( std::numeric_limits<double>::infinity() );
+		if ( _profile ) _profile -> end( _transitionsTaken );
+		return;
+	}
+
 	while ( _candidatesLeft > 0 and _transitionsTaken < _maxTransitions and _totalTime <= _maxDuration ){
 
 		/*draw time of next transition */
-		std::random_device rd;
-		std::mt19937 rnd_gen( rd() );
 		std::exponential_distribution< double > expDist(_rateSum);
-		double exponentialDraw = expDist(rnd_gen);
+		double exponentialDraw = expDist(_rng);
+
+		//a burn-in stops at exactly its end time: the next transition hasn't happened yet, and each fork draws its own
+		if ( _burningIn and _totalTime + exponentialDraw > _burnInEnd ){
+
+			_totalTime = _burnInEnd;
+			if ( _profile ) _profile -> end( _transitionsTaken );
+			return;
+		}
+
+		if ( _sampleInterval > 0.0 ){
+
+			PhaseTimer timer( _profile, PHASE_OUTPUT );
+			writeSnapshotsBefore( _totalTime + exponentialDraw );
+		}
+		recordSummariesBefore( _totalTime + exponentialDraw );
 		_totalTime += exponentialDraw;
 
 #if DEBUG
@@ -580,8 +1052,9 @@ std::cout << "Total time elapsed: " << _totalTime << std::endl;
 #endif
 
 		/*Monte Carlo step to decide next transition */
+		PhaseTimer selectionTimer( _profile, PHASE_SELECTION );
 		std::uniform_real_distribution< double > uniDist(0.0, 1.0);
-		double uniformDraw = uniDist(rnd_gen);
+		double uniformDraw = uniDist(_rng);
 
 		/*go through all the transition candidates and stop when we find the correct one */
 		double runningTotal = 0.0;
@@ -612,7 +1085,7 @@ std::cout << " at rate " << (*tc) -> rate << std::endl;
 					getParallelProcesses( *tc, toAdd );
 					SystemProcess *newSp = updateSpForTransition( *tc );
 					if ( newSp ) toAdd.push_back(newSp);
-					writeTransition( _totalTime, *tc, _outputStream );
+					writeTransition( _totalTime, *tc );
 #if DEBUG
 printTransition(_totalTime, *tc);
 #endif
@@ -658,7 +1131,7 @@ std::cout << " at rate " << beaconCand -> rate << std::endl;
 				}
 
 				if ( newSp ) toAdd.push_back(newSp);
-				writeTransition( _totalTime, beaconCand, _outputStream );
+				writeTransition( _totalTime, beaconCand );
 #if DEBUG
 printTransition(_totalTime, beaconCand);
 #endif
@@ -715,8 +1188,8 @@ std::cout << " at rate " << hsCand -> rate << std::endl;
 					toAdd.push_back(newSp_receive);
 				}
 
-				writeTransition( _totalTime, hsCand -> hsSendCand, _outputStream );
-				writeTransition( _totalTime, hsCand -> hsReceiveCand, _outputStream );
+				writeTransition( _totalTime, hsCand -> hsSendCand );
+				writeTransition( _totalTime, hsCand -> hsReceiveCand );
 #if DEBUG
 printTransition(_totalTime, hsCand -> hsSendCand);
 printTransition(_totalTime, hsCand -> hsReceiveCand);
@@ -732,6 +1205,7 @@ printTransition(_totalTime, hsCand -> hsReceiveCand);
 
 		foundCand:
 		assert( found );
+		selectionTimer.stop();
 		_transitionsTaken++;
 
 #if DEBUG
@@ -762,6 +1236,7 @@ std::cout << "   Re-summing transitions... " << std::endl;
 		std::list< SystemProcess > parallelProcesses;
 		for ( auto s = toAdd.begin(); s != toAdd.end(); s++ ){
 
+			PhaseTimer timer( _profile, PHASE_RATES );
 			sumTransitionRates( *s, (*s) -> parseTree, ((*s) -> parseTree).getRoot(), parallelProcesses, (*s) -> parameterValues );
 		}
 
@@ -773,6 +1248,7 @@ std::cout << "   Re-summing handshakes... " << std::endl;
 		//sum handshake transitions
 		for ( auto chan = _handshakes_Name2Channel.begin(); chan != _handshakes_Name2Channel.end(); chan++ ){
 
+			PhaseTimer timer( _profile, PHASE_HANDSHAKES );
 			int newHandshakesAdded;
 			double rateSumIncrease;
 			std::tie(newHandshakesAdded,rateSumIncrease) = (chan -> second) -> updateHandshakeCandidates();
@@ -787,6 +1263,7 @@ std::cout << "   Condensing system processes... " << std::endl;
 
 		for ( auto s = toAdd.begin(); s != toAdd.end(); ){
 
+			PhaseTimer timer( _profile, PHASE_CONDENSE );
 			bool condensed = condenseSystem(*s);
 			if (condensed){
 				delete *s;
@@ -801,31 +1278,329 @@ std::cout << "Total processes added: " << toAdd.size() << std::endl;
 for (auto a = toAdd.begin(); a != toAdd.end(); a++) std::cout << *a << std::endl;
 #endif
 
+		for ( auto s = toAdd.begin(); s != toAdd.end(); s++ ) updateObservables( *s, (*s) -> clones );
 		_currentProcesses.insert( _currentProcesses.end(), toAdd.begin(), toAdd.end() );
+
+		if ( _observablesChanged and _writeOutput and _sampleInterval <= 0.0 ){
+
+			PhaseTimer timer( _profile, PHASE_OUTPUT );
+			writeObservableLine( _observableBuffer, _totalTime, _observableCounts );
+			_observablesChanged = false;
+		}
+
+		//only re-check the stop conditions if something they depend on has changed
+		if ( _stopConditionsChanged ){
+
+			_stopConditionsChanged = false;
+			if ( _totalTime <= _maxDuration and stopConditionHolds() ){
+
+				_stopped = true;
+				_stopTime = _totalTime;
+				break;
+			}
+		}
+
+		//the end of a transition is the only point where the candidate pools agree with the processes in the system
+		if ( _checkpointEvery > 0 and _transitionsTaken % _checkpointEvery == 0 ) writeCheckpoint();
+		if ( _metricsEvery > 0 and _transitionsTaken % _metricsEvery == 0 ) sampleMetrics();
+	}
+
+	//finish the metrics with the state the simulation ended in
+	if ( _metricsEvery > 0 and _transitionsTaken % _metricsEvery != 0 ) sampleMetrics();
+
+	if ( _profile ) _profile -> end( _transitionsTaken );
+
+	//a burn-in that deadlocked or hit a limit leaves the rest to each fork
+	if ( _burningIn ) return;
+
+	//if the system deadlocked, its state holds for the rest of the simulation
+	if ( not _stopped and _candidatesLeft == 0 and _maxDuration < std::numeric_limits<double>::max() ){
+
+		writeSnapshotsBefore( std::numeric_limits<double>::infinity() );
+	}
+
+	//once a simulation ends, whatever state it ended in is compared against the rest of the observed data
+	recordSummariesBefore( std::numeric_limits<double>::infinity() );
+}
+
+
+void System::sampleMetrics( void ){
+//one line of the engine's internal state: the size of the candidate pools and rate sum, the number of processes and channels,
+//and the beacon databases and receive pools summed over channels
+
+	if ( _metricsEvery <= 0 or _burningIn ) return;
+
+	size_t databaseEntries = 0, largestDatabase = 0, potentialReceives = 0, activeReceives = 0;
+	for ( auto chan = _beacons_Name2Channel.begin(); chan != _beacons_Name2Channel.end(); chan++ ){
+
+		size_t entries = (chan -> second) -> databaseSize();
+		databaseEntries += entries;
+		largestDatabase = std::max( largestDatabase, entries );
+		potentialReceives += (chan -> second) -> potentialReceives();
+		activeReceives += (chan -> second) -> activeReceives();
 	}
+
+	std::stringstream line;
+	line << std::setprecision(10) << _totalTime << '\t' << _transitionsTaken << '\t' << _candidatesLeft << '\t' << _rateSum << '\t' << _currentProcesses.size();
+	line << '\t' << _beacons_Name2Channel.size() << '\t' << _handshakes_Name2Channel.size();
+	line << '\t' << databaseEntries << '\t' << largestDatabase << '\t' << potentialReceives << '\t' << activeReceives << '\n';
+	_metricsBuffer += line.str();
+}
+
+
+void System::burnIn( double until, std::string &state ){
+//simulates up to the given time without writing anything and saves the state it reached for simulations to fork from
+//the time to the next transition is memoryless, so stopping at exactly this time and starting each fork from here
+//gives the same distribution of trajectories as simulating straight through
+
+	bool writeOutput = _writeOutput;
+	_writeOutput = false;
+	_burningIn = true;
+	_burnInEnd = until;
+	simulate();
+	_burningIn = false;
+	_writeOutput = writeOutput;
+
+	saveState( state );
 }
 
 
-void simulateSystem( std::map< std::string, ProcessDefinition > &name2ProcessDef, std::list< SystemProcess > &system, GlobalVariables &globalVars, int numOfSimulations, int threads, std::string outputFilename, int maxTransitions, double maxDuration ){
+static int burnInIndex( int job, const SimulationOptions &options ){
+//the burn-in that a job forks from: replicates at a grid point go round that grid point's burn-ins in turn
+
+	return ( job / options.numOfSimulations ) * options.burnInRuns + ( job % options.numOfSimulations ) % options.burnInRuns;
+}
+
+
+void simulateSystem( std::map< std::string, ProcessDefinition > &name2ProcessDef, std::vector< GridPoint > &grid, std::vector< ObservableDefinition > &observables, std::vector< StopCondition > &stopConditions, SimulationOptions &options ){
+
+	OutputTables tables( name2ProcessDef, options.recordNames, options.ignoreNames );
 
-	std::ofstream outFile( outputFilename );
-	progressBar pb( numOfSimulations );
+	//aggregate and first passage runs only write a summary at the end
+	bool writeTrajectories = not ( options.aggregate or options.firstPassage );
+	bool writeObservables = observables.size() > 0 and writeTrajectories;
+
+	//when resuming, the manifest says which simulations finished and how far the output files had got when they did
+	//anything written after that belongs to a simulation that didn't finish, so it's cut off
+	int numJobs = grid.size() * options.numOfSimulations;
+	std::vector< bool > jobDone( numJobs, false );
 	int numCompleted = 0;
+	std::string manifestFilename = options.checkpointPrefix + ".done";
+	if ( options.resume ){
+
+		std::ifstream manifest( manifestFilename );
+		std::string line;
+		long outputOffset = -1, observablesOffset = -1;
+		while ( std::getline( manifest, line ) ){
+
+			int job;
+			long o1, o2;
+			if ( sscanf( line.c_str(), "%d\t%ld\t%ld", &job, &o1, &o2 ) != 3 ) continue; //the last line may have been cut short
+			if ( job < 0 or job >= numJobs ) throw BadCheckpoint( manifestFilename + " doesn't match the number of simulations." );
+			if ( not jobDone[job] ) numCompleted++;
+			jobDone[job] = true;
+			outputOffset = o1;
+			observablesOffset = o2;
+		}
+		if ( numCompleted > 0 ){
+
+			if ( truncate( options.outputFilename.c_str(), outputOffset ) != 0 ) throw BadCheckpoint( "could not truncate " + options.outputFilename + "." );
+			if ( writeObservables and truncate( options.observablesFilename.c_str(), observablesOffset ) != 0 ) throw BadCheckpoint( "could not truncate " + options.observablesFilename + "." );
+		}
+	}
+	bool appendOutput = numCompleted > 0;
+
+	std::ofstream outFile( options.outputFilename, appendOutput ? std::ios::binary | std::ios::app : std::ios::binary );
+	if ( not outFile.is_open() ) throw BadOutputPath();
+
+	std::string header;
+	if ( options.outputFormat == BINARY_OUTPUT and writeTrajectories ) tables.writeHeader( header );
+	if ( options.compress and writeTrajectories ){
+
+		std::string compressedHeader;
+		writeCompressedHeader( compressedHeader );
+		if ( header.size() > 0 ) appendCompressedBlock( compressedHeader, header.data(), header.size() );
+		header.swap( compressedHeader );
+	}
+	if ( not appendOutput ){
+
+		outFile.write( header.data(), header.size() );
+		if ( options.firstPassage ) outFile << "#time\tstopped" << std::endl;
+	}
+
+	//declared observables get their own time series, with a header naming the columns
+	std::ofstream observablesFile;
+	if ( writeObservables ){
+
+		observablesFile.open( options.observablesFilename, appendOutput ? std::ios::app : std::ios::out );
+		if ( not observablesFile.is_open() ) throw BadOutputPath();
+		if ( not appendOutput ){
+
+			observablesFile << "#time";
+			for ( auto o = observables.begin(); o < observables.end(); o++ ) observablesFile << '\t' << o -> name;
+			observablesFile << std::endl;
+		}
+	}
+
+	std::ofstream metricsFile;
+	if ( options.metricsEvery > 0 ){
+
+		metricsFile.open( options.metricsFilename );
+		if ( not metricsFile.is_open() ) throw BadOutputPath();
+		metricsFile << "#time\ttransitions\tcandidates\trateSum\tprocesses\tbeaconChannels\thandshakeChannels\tdatabaseEntries\tlargestDatabase\tpotentialReceives\tactiveReceives" << std::endl;
+	}
+
+	std::ofstream manifestFile;
+	bool checkpointing = options.checkpointEvery > 0 or options.resume;
+	if ( checkpointing ){
+
+		manifestFile.open( manifestFilename, appendOutput ? std::ios::app : std::ios::out );
+		if ( not manifestFile.is_open() ) throw BadOutputPath();
+	}
+
+	//a job with a checkpoint carries on from it rather than starting again
+	std::vector< bool > jobResumes( numJobs, false );
+	for ( int job = 0; job < numJobs and options.resume; job++ ){
+
+		jobResumes[job] = not jobDone[job] and std::ifstream( options.checkpointPrefix + "." + std::to_string( job ) ).good();
+	}
+
+	//each burn-in is simulated once, and the simulations at its grid point take turns forking from it
+	//burn-ins that no remaining simulation would fork from are skipped
+	int numBurnIns = ( options.burnIn > 0.0 ) ? grid.size() * options.burnInRuns : 0;
+	std::vector< std::string > burnInStates( numBurnIns );
+	std::vector< bool > burnInNeeded( numBurnIns, false );
+	for ( int job = 0; job < numJobs and numBurnIns > 0; job++ ){
+
+		if ( not jobDone[job] and not jobResumes[job] ) burnInNeeded[ burnInIndex( job, options ) ] = true;
+	}
+
+	//an error in one simulation stops any more from starting, and is raised again here once the others have finished
+	std::exception_ptr simulationError;
+	std::atomic< bool > failed( false );
+
+	#pragma omp parallel for schedule(dynamic) shared(grid, tables, observables, stopConditions, burnInStates, burnInNeeded) num_threads( options.threads )
+	for ( int b = 0; b < numBurnIns; b++ ){
+
+		if ( not burnInNeeded[b] or failed ) continue;
+		try{
+
+			System systemLocal( grid[ b / options.burnInRuns ], name2ProcessDef, observables, stopConditions, options, tables );
+			systemLocal.burnIn( options.burnIn, burnInStates[b] );
+		}
+		catch ( ... ){
+
+			#pragma omp critical(simulationError)
+			if ( not simulationError ) simulationError = std::current_exception();
+			failed = true;
+		}
+	}
+
+	//every simulation at every grid point is a separate job so that the whole sweep shares one thread pool
+	progressBar pb( numJobs );
+
+	//one aggregator per thread (and grid point) so that simulations never wait on each other to record observables
+	std::vector< std::vector< EnsembleAggregator > > threadAggregators( grid.size(), std::vector< EnsembleAggregator >( options.threads, EnsembleAggregator( options.observeProcesses.size(), options.histogram ) ) );
+	std::vector< PhaseProfile > threadProfiles( options.threads );
 
 	/*each simulation */
-	#pragma omp parallel for schedule(dynamic) shared(pb, system, globalVars, numCompleted) num_threads( threads )
-	for ( int i = 0; i < numOfSimulations; i++ ){
+	#pragma omp parallel for schedule(dynamic) shared(pb, grid, numCompleted, tables, observables, stopConditions, jobDone, jobResumes, burnInStates, threadProfiles) num_threads( options.threads )
+	for ( int job = 0; job < numJobs; job++ ){
+
+		if ( jobDone[job] or failed ) continue;
+		try{
+
+			GridPoint &point = grid[ job / options.numOfSimulations ];
+			std::string checkpointFilename;
+			if ( checkpointing ) checkpointFilename = options.checkpointPrefix + "." + std::to_string( job );
+			const std::string *burnInState = NULL;
+			if ( numBurnIns > 0 and not jobResumes[job] ) burnInState = &burnInStates[ burnInIndex( job, options ) ];
+			System systemLocal( point, name2ProcessDef, observables, stopConditions, options, tables, checkpointFilename, jobResumes[job], burnInState );
+			if ( options.aggregate ) systemLocal.setAggregator( &threadAggregators[ point.index ][ omp_get_thread_num() ] );
+			if ( options.profile ) systemLocal.setProfile( &threadProfiles[ omp_get_thread_num() ] );
+			systemLocal.simulate();
+
+			//compress on this thread so that the critical section only has to write bytes out
+			if ( options.compress and writeTrajectories ) systemLocal.compressOutput();
+
+			#pragma omp critical 
+			{
+			numCompleted++;
+			pb.displayProgress( numCompleted );
+			if ( writeTrajectories ){
+
+				std::string &trajectory = systemLocal.write();
+				outFile.write( trajectory.data(), trajectory.size() );
+			}
+			else if ( options.firstPassage ){
+
+				//simulations that never met a stop condition are censored at the time they ended
+				std::string label;
+				if ( not point.names.empty() ) appendGridLabel( label, point.index, point.names, point.values );
+				outFile << systemLocal.finishTime() << '\t' << systemLocal.stopped() << label << std::endl;
+			}
+			if ( writeObservables ){
+
+				std::string &series = systemLocal.writeObservables();
+				observablesFile.write( series.data(), series.size() );
+			}
+			if ( options.metricsEvery > 0 ){
+
+				std::string &metrics = systemLocal.writeMetrics();
+				metricsFile.write( metrics.data(), metrics.size() );
+			}
+			if ( checkpointing ){
 
-		System systemLocal( system, name2ProcessDef, maxTransitions, maxDuration, globalVars );
-		systemLocal.simulate();
-		numCompleted++;
+				//the output has to be on disk before the manifest says this simulation is done
+				outFile.flush();
+				long observablesOffset = 0;
+				if ( writeObservables ){
 
-		#pragma omp critical 
-		{
-		pb.displayProgress( numCompleted );
-		outFile << ">=======" << std::endl;
-		outFile << systemLocal.write();
+					observablesFile.flush();
+					observablesOffset = observablesFile.tellp();
+				}
+				manifestFile << job << '\t' << (long) outFile.tellp() << '\t' << observablesOffset << std::endl;
+
+				std::remove( checkpointFilename.c_str() );
+				std::remove( ( checkpointFilename + ".trajectory" ).c_str() );
+				std::remove( ( checkpointFilename + ".observables" ).c_str() );
+			}
+			}
+		}
+		catch ( ... ){
+
+			#pragma omp critical(simulationError)
+			if ( not simulationError ) simulationError = std::current_exception();
+			failed = true;
 		}
 	}
 	std::cout << std::endl;
+	if ( simulationError ) std::rethrow_exception( simulationError );
+
+	if ( options.profile ) writeProfile( threadProfiles, options.profileFilename );
+
+	//once every simulation is done there's nothing left to resume
+	if ( checkpointing ){
+
+		manifestFile.close();
+		std::remove( manifestFilename.c_str() );
+	}
+
+	if ( options.aggregate ){
+
+		threadAggregators[0][0].writeHeader( outFile );
+		for ( auto point = grid.begin(); point < grid.end(); point++ ){
+
+			std::vector< EnsembleAggregator > &aggregators = threadAggregators[ point -> index ];
+			for ( unsigned int t = 1; t < aggregators.size(); t++ ) aggregators[0].merge( aggregators[t] );
+
+			if ( not ( point -> names ).empty() ){
+
+				std::string label = ">=======";
+				appendGridLabel( label, point -> index, point -> names, point -> values );
+				outFile << label << std::endl;
+			}
+			aggregators[0].write( outFile, options.observeProcesses, options.sampleInterval );
+		}
+	}
 }
@@ -15,29 +15,104 @@
 #include <iomanip>
 #include <sstream>
 #include <iterator>
+#include <random>
 #include "error_handling.h"
 #include "handshake.h"
 #include "beacon.h"
+#include "output.h"
+#include "aggregate.h"
+#include "sweep.h"
+#include "abc.h"
+#include "profile.h"
+
+#define CHECKPOINT_MAGIC "BCSK"
+#define CHECKPOINT_FORMAT_VERSION 1
+
+struct SimulationOptions{
+
+	int numOfSimulations = 1;
+	int threads = 1;
+	std::string outputFilename = "simulationOutput";
+	std::string observablesFilename = "simulationOutput.observables.bcs";
+	int maxTransitions = 1000000;
+	double maxDuration = std::numeric_limits<double>::max();
+	OutputFormat outputFormat = TEXT_OUTPUT;
+	bool compress = false;
+	std::vector< std::string > recordNames, ignoreNames;
+	double sampleInterval = 0.0; //if positive, write snapshots of the system on this time grid instead of transitions
+	bool aggregate = false; //summarise observables over all simulations on the sampling grid instead of writing each simulation
+	std::vector< std::string > observeProcesses;
+	HistogramOptions histogram;
+	bool firstPassage = false; //only write the time each simulation met a stop condition
+	bool inference = false; //only keep the summary statistics that ABC compares against observed data
+	int checkpointEvery = 0; //if positive, checkpoint each simulation every this many transitions
+	std::string checkpointPrefix = "simulationOutput.checkpoint";
+	bool resume = false; //pick up from the checkpoints of an interrupted run
+	double burnIn = 0.0; //if positive, simulate up to this time once and fork each simulation from the state it reached
+	int burnInRuns = 1; //number of separate burn-ins that the simulations at each grid point are shared between
+	bool profile = false; //time each phase of the simulation loop and write a report at the end
+	std::string profileFilename = "simulationOutput.profile.json";
+	int metricsEvery = 0; //if positive, sample the engine's internal state every this many transitions
+	std::string metricsFilename = "simulationOutput.metrics.bcs";
+};
 
 class System{
 
 	private: 
 		std::list< SystemProcess * > _currentProcesses;
 		GlobalVariables _globalVars;
-		double _rateSum = 0.0, _totalTime = 0.0, _maxDuration;
+		ExpressionMemo _memo; //rates and gate conditions already evaluated in this simulation
+		double _rateSum = 0.0, _totalTime = 0.0, _maxDuration, _sampleInterval;
 		int _transitionsTaken = 0, _maxTransitions, _candidatesLeft = 0;
+		unsigned long _samplesTaken = 0;
 
 		std::map< SystemProcess * , std::vector< std::shared_ptr<Candidate> > > _nonMsgCandidates;
 		std::map< std::vector<std::string>, std::shared_ptr<BeaconChannel> > _beacons_Name2Channel;
 		std::map< std::vector<std::string>, std::shared_ptr<HandshakeChannel> > _handshakes_Name2Channel;
 
 		std::map< std::string, ProcessDefinition > _name2ProcessDef;
-		std::stringstream _outputStream;
+		std::shared_ptr< TrajectoryWriter > _writer;
+		const OutputTables &_tables;
+		EnsembleAggregator *_aggregator = NULL;
+		std::vector< std::string > _observeProcesses;
+		std::vector< int > _observeIndex; //for each --observe name, the declared observable it refers to or -1 for a process count
+
+		std::vector< ObservableDefinition > _observables;
+		std::vector< long > _observableCounts;
+		bool _observablesChanged = false;
+		std::string _observableBuffer;
+		bool _writeOutput; //false if only summaries of the simulation are needed
+
+		std::vector< StopCondition > _stopConditions;
+		std::vector< std::vector< unsigned int > > _stopActionIDs; //action IDs for the action names in each stop condition
+		std::vector< unsigned long > _actionCounts; //number of times each action has fired, indexed by action ID
+		std::vector< bool > _stopOnAction; //true for actions used in a stop condition
+		bool _stopConditionsChanged = false, _stopped = false;
+		double _stopTime = 0.0;
+
+		const ObservedData *_observedData = NULL;
+		std::vector< double > _summaries; //values of the observed data's columns at each of its times
+		size_t _summaryTimesTaken = 0;
+
+		std::mt19937 _rng;
+		int _checkpointEvery = 0;
+		std::string _checkpointFilename;
+		size_t _spooledTrajectory = 0, _spooledObservables = 0; //bytes of each buffer already appended to the spool files
+		void writeCheckpoint( void );
+		void readCheckpoint( void );
+		void saveState( std::string & );
+		bool restoreState( const std::string &, size_t & );
+		PhaseProfile *_profile = NULL;
+		int _metricsEvery = 0;
+		std::string _metricsBuffer;
+		void sampleMetrics( void );
+		bool _burningIn = false;
+		double _burnInEnd = 0.0;
 
 		void splitOnParallel( SystemProcess *, Block *, std::list< SystemProcess * > & );
 
 	public:
-		System( std::list< SystemProcess > &, std::map< std::string, ProcessDefinition > &, int, double , GlobalVariables & );
+		System( const GridPoint &, std::map< std::string, ProcessDefinition > &, const std::vector< ObservableDefinition > &, const std::vector< StopCondition > &, const SimulationOptions &, const OutputTables &, std::string checkpointFilename = "", bool resume = false, const std::string *burnInState = NULL );
 		~System(){
 
 			for ( auto i = _currentProcesses.begin(); i != _currentProcesses.end(); i++ ){
@@ -45,20 +120,37 @@ class System{
 				delete *i;
 			}
 		}
-		void writeTransition( double , std::shared_ptr<Candidate>, std::stringstream & );
-		std::string writeChannelName( std::vector< std::vector< Token * > > );
+		void writeTransition( double , std::shared_ptr<Candidate> );
 		std::vector< std::string > substituteChannelName( std::vector< std::vector< Token * > >, ParameterValues &, std::map< std::string, Numerical > & );
 		void sumTransitionRates( SystemProcess *, Tree<Block> &, Block *, std::list< SystemProcess >, ParameterValues & );
 		void updateSystem( std::shared_ptr<Candidate>, std::list< SystemProcess * > & );
 		void splitOnParallel(SystemProcess &, Block *, std::list< SystemProcess> & );
 		void simulate( void );
-		std::streambuf *write( void ){ return _outputStream.rdbuf(); }
+		void burnIn( double, std::string & );
+		std::string &write( void ){ return _writer -> buffer(); }
+		void compressOutput( void ){ _writer -> compress(); }
+		std::string &writeObservables( void ){ return _observableBuffer; }
+		std::string &writeMetrics( void ){ return _metricsBuffer; }
+		void setAggregator( EnsembleAggregator *ea ){ _aggregator = ea; }
+		void setProfile( PhaseProfile *pp ){ _profile = pp; }
+		void seed( unsigned long s ){ _rng.seed( s ); }
 		void removeChosenFromSystem( std::shared_ptr<Candidate>, bool );
 		void getParallelProcesses( std::shared_ptr<Candidate>, std::list< SystemProcess * > & );
 		SystemProcess * updateSpForTransition( std::shared_ptr<Candidate> );
 		bool variableIsDefined(std::string, ParameterValues &, std::map< std::string, Numerical > &);
 		void printTransition(double, std::shared_ptr<Candidate>);
 		bool condenseSystem(SystemProcess *);
+		Block *resolveProcessCalls( SystemProcess * );
+		void snapshotIdentity( SystemProcess *, std::string &, std::vector< Numerical > & );
+		void writeSnapshot( double );
+		void writeSnapshotsBefore( double );
+		void updateObservables( SystemProcess *, long );
+		bool stopConditionHolds( void );
+		bool stopped( void ){ return _stopped; }
+		double finishTime( void ){ return _stopped ? _stopTime : std::min( _totalTime, _maxDuration ); }
+		void setObservedData( const ObservedData *od ){ _observedData = od; }
+		void recordSummariesBefore( double );
+		const std::vector< double > &summaries( void ){ return _summaries; }
 };
 
 
@@ -111,6 +203,6 @@ class progressBar{
 };
 
 
-void simulateSystem( std::map< std::string, ProcessDefinition > &, std::list< SystemProcess > &, GlobalVariables &, int, int, std::string, int, double );
+void simulateSystem( std::map< std::string, ProcessDefinition > &, std::vector< GridPoint > &, std::vector< ObservableDefinition > &, std::vector< StopCondition > &, SimulationOptions & );
 
 #endif
@@ -0,0 +1,223 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "sweep.h"
+#include "lexer.h"
+#include "error_handling.h"
+
+
+static bool parseNumber( std::string s, Numerical &n ){
+//ints stay ints so that swept variables have the same type they would have if they were written in the model
+//returns false for anything that isn't a number, including numbers too large for their type, so the caller reports it as a bad sweep
+
+	if ( s.empty() ) return false;
+
+	try{
+
+		size_t start = ( s[0] == '-' ) ? 1 : 0;
+		if ( start < s.size() and s.find_first_not_of( "0123456789", start ) == std::string::npos ){
+
+			n.setInt( std::stoi( s ) );
+			return true;
+		}
+
+		size_t used;
+		double d = std::stod( s, &used );
+		if ( used != s.size() ) return false;
+		n.setDouble( d );
+		return true;
+	}
+	catch ( std::invalid_argument & ){
+
+		return false;
+	}
+	catch ( std::out_of_range & ){
+
+		return false;
+	}
+}
+
+
+void SweepGrid::checkName( std::string &name ){
+
+	for ( auto axis = _axisNames.begin(); axis < _axisNames.end(); axis++ ){
+
+		if ( std::find( axis -> begin(), axis -> end(), name ) != axis -> end() ) throw BadSweep( name + " is swept more than once." );
+	}
+}
+
+
+void SweepGrid::addRange( std::string spec ){
+//adds an axis from a range of the form name=start:stop:step, where stop is included if the range lands on it
+
+	size_t equals = spec.find( '=' );
+	if ( equals == std::string::npos ) throw BadSweep( spec + " should be of the form name=start:stop:step." );
+	std::string name = spec.substr( 0, equals );
+	checkName( name );
+
+	std::vector< std::string > fields;
+	std::stringstream ss( spec.substr( equals + 1 ) );
+	std::string field;
+	while ( std::getline( ss, field, ':' ) ) fields.push_back( field );
+
+	Numerical start, stop, step;
+	if ( fields.size() != 3 or not parseNumber( fields[0], start ) or not parseNumber( fields[1], stop ) or not parseNumber( fields[2], step ) ){
+
+		throw BadSweep( spec + " should be of the form name=start:stop:step." );
+	}
+	if ( step.doubleCast() == 0.0 or ( stop.doubleCast() - start.doubleCast() ) / step.doubleCast() < 0.0 ){
+
+		throw BadSweep( spec + " has a step that never reaches the stop value." );
+	}
+
+	std::vector< std::vector< Numerical > > rows;
+	if ( start.isInt() and stop.isInt() and step.isInt() ){
+
+		for ( int v = start.getInt(); ( step.getInt() > 0 ) ? v <= stop.getInt() : v >= stop.getInt(); v += step.getInt() ){
+
+			Numerical n;
+			n.setInt( v );
+			rows.push_back( std::vector< Numerical >( 1, n ) );
+		}
+	}
+	else{
+
+		//compute each value from the start so that rounding errors don't build up over the range
+		double steps = ( stop.doubleCast() - start.doubleCast() ) / step.doubleCast();
+		unsigned int numValues = (unsigned int) std::floor( steps + 1e-9 ) + 1;
+		for ( unsigned int i = 0; i < numValues; i++ ){
+
+			Numerical n;
+			n.setDouble( start.doubleCast() + i * step.doubleCast() );
+			rows.push_back( std::vector< Numerical >( 1, n ) );
+		}
+	}
+
+	_axisNames.push_back( std::vector< std::string >( 1, name ) );
+	_axisRows.push_back( rows );
+}
+
+
+void SweepGrid::addFile( std::string filename ){
+//adds an axis from a whitespace-delimited table: the first line names the swept variables, and each line after that is one grid point
+//lines starting with # are ignored
+
+	std::ifstream sweepFile( filename );
+	if ( not sweepFile.is_open() ) throw BadSweep( "could not open sweep file " + filename + "." );
+
+	std::vector< std::string > names;
+	std::vector< std::vector< Numerical > > rows;
+	std::string line;
+	unsigned int lineNumber = 0;
+	while ( std::getline( sweepFile, line ) ){
+
+		lineNumber++;
+		if ( line.empty() or line[0] == '#' or line.find_first_not_of( " \t\r" ) == std::string::npos ) continue;
+
+		std::vector< std::string > fields;
+		std::stringstream ss( line );
+		std::string field;
+		while ( ss >> field ) fields.push_back( field );
+
+		if ( names.empty() ){
+
+			for ( auto name = fields.begin(); name < fields.end(); name++ ) checkName( *name );
+			names = fields;
+			continue;
+		}
+
+		if ( fields.size() != names.size() ) throw BadSweep( filename + " line " + std::to_string( lineNumber ) + " does not have a value for each swept variable." );
+		std::vector< Numerical > row;
+		for ( auto f = fields.begin(); f < fields.end(); f++ ){
+
+			Numerical n;
+			if ( not parseNumber( *f, n ) ) throw BadSweep( filename + " line " + std::to_string( lineNumber ) + " has a value that is not a number: " + *f );
+			row.push_back( n );
+		}
+		rows.push_back( row );
+	}
+
+	if ( rows.empty() ) throw BadSweep( filename + " does not have any grid points." );
+	_axisNames.push_back( names );
+	_axisRows.push_back( rows );
+}
+
+
+std::set< std::string > SweepGrid::names( void ) const{
+
+	std::set< std::string > swept;
+	for ( auto axis = _axisNames.begin(); axis < _axisNames.end(); axis++ ) swept.insert( axis -> begin(), axis -> end() );
+	return swept;
+}
+
+
+void bindGridPoint( GridPoint &gp, std::map< std::string, ProcessDefinition > &processName2Definition, std::vector< SystemLineTerm > &tokenisedSystemLine ){
+//sets the grid point's variables in its copy of the global variables, then evaluates the system line under them
+
+	for ( unsigned int i = 0; i < gp.names.size(); i++ ) gp.globalVars.updateValue( gp.names[i], gp.values[i] );
+	gp.system.clear();
+	secondParseSystemLine( tokenisedSystemLine, gp.system, processName2Definition, gp.globalVars );
+}
+
+
+std::vector< GridPoint > SweepGrid::build( std::map< std::string, ProcessDefinition > &processName2Definition, std::vector< SystemLineTerm > &tokenisedSystemLine, std::list< SystemProcess > &system, GlobalVariables &globalVars ) const{
+//makes every grid point, rebinding the swept global variables and re-evaluating the system line under them
+//the process definitions are shared by all grid points, so nothing else is re-parsed
+
+	std::vector< GridPoint > grid;
+
+	//without a sweep, the system line the block parser already evaluated is the only grid point
+	if ( _axisNames.empty() ){
+
+		GridPoint gp;
+		gp.globalVars = globalVars;
+		gp.system = system;
+		grid.push_back( gp );
+		return grid;
+	}
+
+	for ( auto axis = _axisNames.begin(); axis < _axisNames.end(); axis++ ){
+
+		for ( auto name = axis -> begin(); name < axis -> end(); name++ ){
+
+			if ( globalVars.values.count( *name ) == 0 ) throw BadSweep( *name + " is not a global variable in the model." );
+		}
+	}
+
+	size_t numPoints = 1;
+	for ( auto rows = _axisRows.begin(); rows < _axisRows.end(); rows++ ) numPoints *= rows -> size();
+
+	for ( size_t k = 0; k < numPoints; k++ ){
+
+		GridPoint gp;
+		gp.index = k;
+		gp.globalVars = globalVars;
+
+		//the first axis varies slowest
+		size_t stride = numPoints;
+		for ( unsigned int a = 0; a < _axisRows.size(); a++ ){
+
+			stride /= _axisRows[a].size();
+			const std::vector< Numerical > &row = _axisRows[a][ ( k / stride ) % _axisRows[a].size() ];
+			for ( unsigned int i = 0; i < row.size(); i++ ){
+
+				gp.names.push_back( _axisNames[a][i] );
+				gp.values.push_back( row[i] );
+			}
+		}
+
+		bindGridPoint( gp, processName2Definition, tokenisedSystemLine );
+		grid.push_back( gp );
+	}
+	return grid;
+}
@@ -0,0 +1,50 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <vector>
+#include <string>
+#include <list>
+#include <map>
+#include <set>
+#include "blockParser.h"
+
+class GridPoint{
+//one setting of the swept global variables, with the system line evaluated under those values
+//a run without a sweep is a single grid point with nothing swept
+
+	public:
+		unsigned int index = 0;
+		std::vector< std::string > names;
+		std::vector< Numerical > values;
+		GlobalVariables globalVars;
+		std::list< SystemProcess > system;
+};
+
+class SweepGrid{
+//each --sweep range and each --sweep-file table is an axis, and the grid is every combination of one row from each axis
+
+	private:
+		std::vector< std::vector< std::string > > _axisNames;
+		std::vector< std::vector< std::vector< Numerical > > > _axisRows;
+		void checkName( std::string & );
+
+	public:
+		void addRange( std::string );
+		void addFile( std::string );
+		bool empty( void ) const { return _axisNames.empty(); }
+		std::set< std::string > names( void ) const;
+		std::vector< GridPoint > build( std::map< std::string, ProcessDefinition > &, std::vector< SystemLineTerm > &, std::list< SystemProcess > &, GlobalVariables & ) const;
+};
+
+/*function prototypes */
+void bindGridPoint( GridPoint &, std::map< std::string, ProcessDefinition > &, std::vector< SystemLineTerm > & );
+
+#endif
@@ -14,6 +14,9 @@
 #include "../lexer.h"
 #include "../parser.h"
 #include "../simulator.h"
+#include "../model.h"
+#include "../fold.h"
+#include "../memo.h"
 
 static const char *test_help=
 "bcs test executable.\n"
@@ -28,11 +31,7 @@ static const char *test_help=
 struct Arguments {
 
 	std::string targetFilename;
-	std::string outputFilename;
-	int threads;
-	int numOfSimulations;
-	int maxTrans;
-	double maxDuration;
+	SimulationOptions options;
 	bool shouldFail;
 };
 
@@ -54,11 +53,9 @@ Arguments parseTestArguments( int argc, char** argv ){
 	Arguments args;
 
 	/*defaults - we'll override these if the option was specified by the user */
-	args.outputFilename = "test.simulation.bcs";
-	args.threads = 1;
-	args.numOfSimulations = 100;
-	args.maxTrans = 1000000;
-	args.maxDuration = std::numeric_limits<double>::max();
+	args.options.outputFilename = "test.simulation.bcs";
+	args.options.observablesFilename = "test.observables.bcs";
+	args.options.numOfSimulations = 100;
 	args.shouldFail = false;
 
 	/*parse the command line arguments */
@@ -97,17 +94,14 @@ int main( int argc, char** argv ){
 
 	try{
 
-		/*call lexer */
-		std::vector< std::vector< Token * > > tokenisedSource = scanSource( args.targetFilename );
-
-		/*call token parser */
-		auto parsedSource = parseSource( tokenisedSource );
-
-		/*call block parser */
-		auto blockParsed = secondPassParse( std::get<0>(parsedSource), std::get<1>(parsedSource), std::get<2>(parsedSource) );
+		/*parse the model and fold its global variables into its expressions */
+		CompiledModel model = parseModel( args.targetFilename );
+		foldConstants( model, std::set< std::string >() );
+		findExpressionReads( model );
 
 		/*call the simulator */
-		simulateSystem( blockParsed.first, blockParsed.second, std::get<2>(parsedSource), args.numOfSimulations, args.threads, args.outputFilename, args.maxTrans, args.maxDuration );
+		std::vector< GridPoint > grid = SweepGrid().build( model.processDefinitions, model.systemLine, model.system, model.globalVars );
+		simulateSystem( model.processDefinitions, grid, model.observables, model.stopConditions, args.options );
 
 		if (not args.shouldFail) std::cout << "PASS" << std::endl;
 		else std::cout << "FAIL" << std::endl;
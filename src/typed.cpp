@@ -0,0 +1,212 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "typed.h"
+
+
+/*types of values on the stack while a program is compiled */
+enum StaticType { STATIC_INT, STATIC_DOUBLE, STATIC_BOOL };
+
+
+bool TypedProgram::compile( const std::vector< Token * > &rpn, const std::vector< std::string > &reads, unsigned int intReads, bool condition ){
+//type inference over an RPN expression, where bit i of intReads is set if read i is an int
+//returns false for anything the interpreter should evaluate or report instead (undefined variables, malformed expressions, wrong types)
+
+	_code.clear();
+	std::vector< StaticType > types;
+
+	for ( auto t = rpn.begin(); t < rpn.end(); t++ ){
+
+		std::string kind = (*t) -> identify();
+		std::string op = (*t) -> value();
+		unsigned int depth = types.size();
+		TypedInstruction ins;
+		ins.read = 0;
+		ins.constant.d = 0.0;
+
+		if ( kind == "IntLiteral" or kind == "DoubleLiteral" or kind == "Variable" ){
+
+			if ( depth == TYPED_MAX_DEPTH ) return false;
+			ins.slot = depth;
+
+			if ( kind == "IntLiteral" ){
+
+				ins.op = TYPED_INT_CONSTANT;
+				ins.constant.i = atoi( op.c_str() );
+				types.push_back( STATIC_INT );
+			}
+			else if ( kind == "DoubleLiteral" ){
+
+				ins.op = TYPED_DOUBLE_CONSTANT;
+				ins.constant.d = atof( op.c_str() );
+				types.push_back( STATIC_DOUBLE );
+			}
+			else{
+
+				auto r = std::find( reads.begin(), reads.end(), op );
+				if ( r == reads.end() ) return false;
+				ins.read = r - reads.begin();
+				bool isInt = ( intReads >> ins.read ) & 1;
+				ins.op = isInt ? TYPED_INT_READ : TYPED_DOUBLE_READ;
+				types.push_back( isInt ? STATIC_INT : STATIC_DOUBLE );
+			}
+			_code.push_back( ins );
+		}
+		else if ( op == "neg" or op == "abs" or op == "sqrt" ){
+
+			if ( depth < 1 or types.back() == STATIC_BOOL ) return false;
+			bool isInt = types.back() == STATIC_INT;
+			ins.slot = depth - 1;
+			if ( op == "neg" ) ins.op = isInt ? TYPED_INT_NEGATE : TYPED_DOUBLE_NEGATE;
+			else if ( op == "abs" ) ins.op = isInt ? TYPED_INT_ABS : TYPED_DOUBLE_ABS;
+			else ins.op = isInt ? TYPED_INT_SQRT : TYPED_DOUBLE_SQRT;
+			_code.push_back( ins );
+		}
+		else if ( op == "+" or op == "-" or op == "*" or op == "/" or op == "^" or op == "min" or op == "max" or
+		          ( condition and ( op == "==" or op == "!=" or op == ">" or op == "<" or op == ">=" or op == "<=" ) ) ){
+
+			if ( depth < 2 or types[ depth - 2 ] == STATIC_BOOL or types[ depth - 1 ] == STATIC_BOOL ) return false;
+			bool comparison = not ( op == "+" or op == "-" or op == "*" or op == "/" or op == "^" or op == "min" or op == "max" );
+			bool isInt = types[ depth - 2 ] == STATIC_INT and types[ depth - 1 ] == STATIC_INT;
+
+			//the interpreter upcasts both operands if either is a double, and compares everything as doubles
+			if ( comparison or not isInt ){
+
+				if ( types[ depth - 2 ] == STATIC_INT ) _code.push_back( { TYPED_TO_DOUBLE, depth - 2, 0, { 0 } } );
+				if ( types[ depth - 1 ] == STATIC_INT ) _code.push_back( { TYPED_TO_DOUBLE, depth - 1, 0, { 0 } } );
+			}
+
+			ins.slot = depth - 2;
+			if ( op == "+" ) ins.op = isInt ? TYPED_INT_ADD : TYPED_DOUBLE_ADD;
+			else if ( op == "-" ) ins.op = isInt ? TYPED_INT_SUBTRACT : TYPED_DOUBLE_SUBTRACT;
+			else if ( op == "*" ) ins.op = isInt ? TYPED_INT_MULTIPLY : TYPED_DOUBLE_MULTIPLY;
+			else if ( op == "/" ) ins.op = isInt ? TYPED_INT_DIVIDE : TYPED_DOUBLE_DIVIDE;
+			else if ( op == "^" ) ins.op = isInt ? TYPED_INT_POWER : TYPED_DOUBLE_POWER;
+			else if ( op == "min" ) ins.op = isInt ? TYPED_INT_MIN : TYPED_DOUBLE_MIN;
+			else if ( op == "max" ) ins.op = isInt ? TYPED_INT_MAX : TYPED_DOUBLE_MAX;
+			else if ( op == "==" ) ins.op = TYPED_EQUAL;
+			else if ( op == "!=" ) ins.op = TYPED_NOT_EQUAL;
+			else if ( op == ">" ) ins.op = TYPED_GREATER;
+			else if ( op == "<" ) ins.op = TYPED_LESS;
+			else if ( op == ">=" ) ins.op = TYPED_GREATER_EQUAL;
+			else ins.op = TYPED_LESS_EQUAL;
+			_code.push_back( ins );
+
+			types.pop_back();
+			types.back() = comparison ? STATIC_BOOL : ( isInt ? STATIC_INT : STATIC_DOUBLE );
+		}
+		else if ( condition and ( op == "&" or op == "|" ) ){
+
+			if ( depth < 2 or types[ depth - 2 ] != STATIC_BOOL or types[ depth - 1 ] != STATIC_BOOL ) return false;
+			ins.slot = depth - 2;
+			ins.op = ( op == "&" ) ? TYPED_AND : TYPED_OR;
+			_code.push_back( ins );
+			types.pop_back();
+		}
+		else if ( condition and op == "~" ){
+
+			if ( depth < 1 or types.back() != STATIC_BOOL ) return false;
+			ins.slot = depth - 1;
+			ins.op = TYPED_NOT;
+			_code.push_back( ins );
+		}
+		else return false;
+	}
+
+	if ( types.size() != 1 ) return false;
+	if ( condition ) return types.back() == STATIC_BOOL;
+	_intResult = types.back() == STATIC_INT;
+	return types.back() != STATIC_BOOL;
+}
+
+
+static TypedValue run( const std::vector< TypedInstruction > &code, const TypedValue *reads ){
+//every operation is done the way the interpreter does it for operands of that type, so results are the same to the bit
+
+	TypedValue stack[ TYPED_MAX_DEPTH ];
+
+	for ( auto ins = code.begin(); ins < code.end(); ins++ ){
+
+		TypedValue &a = stack[ ins -> slot ];
+		const TypedValue &b = stack[ ins -> slot + 1 ];
+
+		switch ( ins -> op ){
+
+			case TYPED_INT_CONSTANT: a.i = ins -> constant.i; break;
+			case TYPED_DOUBLE_CONSTANT: a.d = ins -> constant.d; break;
+			case TYPED_INT_READ: a.i = reads[ ins -> read ].i; break;
+			case TYPED_DOUBLE_READ: a.d = reads[ ins -> read ].d; break;
+			case TYPED_TO_DOUBLE: a.d = a.i; break;
+
+			case TYPED_INT_ADD: a.i = a.i + b.i; break;
+			case TYPED_INT_SUBTRACT: a.i = a.i - b.i; break;
+			case TYPED_INT_MULTIPLY: a.i = a.i * b.i; break;
+			case TYPED_INT_DIVIDE: a.i = a.i / b.i; break;
+			case TYPED_INT_POWER: a.i = pow( a.i, b.i ); break;
+			case TYPED_INT_MIN: a.i = std::min( a.i, b.i ); break;
+			case TYPED_INT_MAX: a.i = std::max( a.i, b.i ); break;
+			case TYPED_INT_NEGATE: a.i = -a.i; break;
+			case TYPED_INT_ABS: a.i = std::abs( a.i ); break;
+			case TYPED_INT_SQRT: a.i = sqrt( a.i ); break;
+
+			case TYPED_DOUBLE_ADD: a.d = a.d + b.d; break;
+			case TYPED_DOUBLE_SUBTRACT: a.d = a.d - b.d; break;
+			case TYPED_DOUBLE_MULTIPLY: a.d = a.d * b.d; break;
+			case TYPED_DOUBLE_DIVIDE: a.d = a.d / b.d; break;
+			case TYPED_DOUBLE_POWER: a.d = pow( a.d, b.d ); break;
+			case TYPED_DOUBLE_MIN: a.d = std::min( a.d, b.d ); break;
+			case TYPED_DOUBLE_MAX: a.d = std::max( a.d, b.d ); break;
+			case TYPED_DOUBLE_NEGATE: a.d = -a.d; break;
+			case TYPED_DOUBLE_ABS: a.d = std::abs( a.d ); break;
+			case TYPED_DOUBLE_SQRT: a.d = sqrt( a.d ); break;
+
+			case TYPED_EQUAL: a.i = a.d == b.d; break;
+			case TYPED_NOT_EQUAL: a.i = a.d != b.d; break;
+			case TYPED_GREATER: a.i = a.d > b.d; break;
+			case TYPED_LESS: a.i = a.d < b.d; break;
+			case TYPED_GREATER_EQUAL: a.i = a.d >= b.d; break;
+			case TYPED_LESS_EQUAL: a.i = a.d <= b.d; break;
+			case TYPED_AND: a.i = a.i and b.i; break;
+			case TYPED_OR: a.i = a.i or b.i; break;
+			case TYPED_NOT: a.i = not a.i; break;
+		}
+	}
+	return stack[0];
+}
+
+
+Numerical TypedProgram::evaluate( const TypedValue *reads ) const {
+
+	TypedValue v = run( _code, reads );
+	Numerical result;
+	if ( _intResult ) result.setInt( v.i );
+	else result.setDouble( v.d );
+	return result;
+}
+
+
+bool TypedProgram::holds( const TypedValue *reads ) const {
+
+	return run( _code, reads ).i;
+}
+
+
+std::vector< TypedProgram > specialiseExpression( const std::vector< Token * > &rpn, const std::vector< std::string > &reads, bool condition ){
+//a program for every assignment of int and double to the variables an expression reads, indexed by the same bits as intReads
+//empty if the expression can't be compiled, in which case it's always left to the interpreter
+
+	std::vector< TypedProgram > programs( 1u << reads.size() );
+	for ( unsigned int intReads = 0; intReads < programs.size(); intReads++ ){
+
+		if ( not programs[ intReads ].compile( rpn, reads, intReads, condition ) ) return std::vector< TypedProgram >();
+	}
+	return programs;
+}
@@ -0,0 +1,66 @@
+//----------------------------------------------------------
+// Copyright 2017-2020 University of Oxford
+// Written by Michael A. Boemo (mb915@cam.ac.uk)
+// This software is licensed under GPL-2.0.  You should have
+// received a copy of the license with this software.  If
+// not, please Email the author.
+//----------------------------------------------------------
+
+#ifndef TYPED_H
+#define TYPED_H
+
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "numerical.h"
+
+#define TYPED_MAX_DEPTH 32 //expressions that need a deeper stack than this are left to the interpreter
+
+
+/*a value whose type is known from the instruction that reads it */
+union TypedValue{
+
+	int i;
+	double d;
+};
+
+
+/*each operation works on one type only - the program converts ints to doubles where the interpreter would upcast them */
+enum TypedOp { TYPED_INT_CONSTANT, TYPED_DOUBLE_CONSTANT, TYPED_INT_READ, TYPED_DOUBLE_READ, TYPED_TO_DOUBLE,
+               TYPED_INT_ADD, TYPED_INT_SUBTRACT, TYPED_INT_MULTIPLY, TYPED_INT_DIVIDE, TYPED_INT_POWER, TYPED_INT_MIN, TYPED_INT_MAX,
+               TYPED_INT_NEGATE, TYPED_INT_ABS, TYPED_INT_SQRT,
+               TYPED_DOUBLE_ADD, TYPED_DOUBLE_SUBTRACT, TYPED_DOUBLE_MULTIPLY, TYPED_DOUBLE_DIVIDE, TYPED_DOUBLE_POWER, TYPED_DOUBLE_MIN, TYPED_DOUBLE_MAX,
+               TYPED_DOUBLE_NEGATE, TYPED_DOUBLE_ABS, TYPED_DOUBLE_SQRT,
+               TYPED_EQUAL, TYPED_NOT_EQUAL, TYPED_GREATER, TYPED_LESS, TYPED_GREATER_EQUAL, TYPED_LESS_EQUAL, TYPED_AND, TYPED_OR, TYPED_NOT };
+
+
+struct TypedInstruction{
+//slot is where the result goes, and is also the operand of a unary operation or the left operand of a binary one, whose right operand is slot + 1
+
+	TypedOp op;
+	unsigned int slot;
+	unsigned int read; //which variable for TYPED_INT_READ and TYPED_DOUBLE_READ
+	TypedValue constant; //value for TYPED_INT_CONSTANT and TYPED_DOUBLE_CONSTANT
+};
+
+
+class TypedProgram{
+//a rate or gate condition compiled for one assignment of types to the variables it reads, so that the type of every subexpression
+//is known before it's evaluated and none of them have to be checked or converted while it runs
+//conditions leave their truth value in the int of the result
+
+	private:
+		std::vector< TypedInstruction > _code;
+		bool _intResult = false;
+
+	public:
+		bool compile( const std::vector< Token * > &, const std::vector< std::string > &, unsigned int, bool );
+		Numerical evaluate( const TypedValue * ) const;
+		bool holds( const TypedValue * ) const;
+};
+
+
+/*function prototypes */
+std::vector< TypedProgram > specialiseExpression( const std::vector< Token * > &, const std::vector< std::string > &, bool );
+
+#endif